@@ -0,0 +1,19 @@
+#!/bin/bash
+# Cross-validates the accept decisions of the counting kernel (-C) with the
+# host counting filter (-X). No differences are expected, so any difference
+# (or a run that does not report the cross-validation) fails the script.
+#   usage: ./cross_validate.sh <filters_benchmark> [algorithm] [input]
+#   algorithm: kmer-model (default, no device needed) or kmer-fpga
+BENCHMARK=${1:?usage: $0 <filters_benchmark> [algorithm] [input]}
+ALGORITHM=${2:-kmer-model}
+INPUT=${3:-$(dirname "$0")/data/cross_validate.seq}
+
+OUTPUT=$("$BENCHMARK" -a "$ALGORITHM" -i "$INPUT" -C -X 2>&1) || { echo "$OUTPUT"; echo "FAILED: $BENCHMARK exited with an error"; exit 1; }
+RESULT=$(echo "$OUTPUT" | grep "Cross-validation:")
+echo "$RESULT"
+
+if ! echo "$RESULT" | grep -q " 0 only accepted by the device, 0 only accepted by the host"; then
+  echo "FAILED: $ALGORITHM differs from the host counting filter"
+  exit 1
+fi
+echo "OK"
@@ -0,0 +1,217 @@
+/*
+ *  Wavefront Alignments Algorithms
+ *  Copyright (c) 2020 by Santiago Marco-Sola  <santiagomsola@gmail.com>
+ *
+ *  This file is part of Wavefront Alignments Algorithms.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * PROJECT: Wavefront Alignments Algorithms
+ * AUTHOR(S): Santiago Marco-Sola <santiagomsola@gmail.com>
+ * DESCRIPTION: Inter-sequence (batched) BPM
+ */
+
+#include "edit_bpm_batch.h"
+#include "edit_bpm_distance.h"
+#include "../utils/dna_text.h"
+
+/*
+ * Constants
+ */
+#define BPM_ALPHABET_LENGTH   (5)
+#define BPM_BATCH_LANE_CHECK  (8)   // Columns between checks for finished vectors
+#define BPM_BATCH_MAX_LANES   (16)
+
+/*
+ * Character encoding (table version of dna_encode(), for the lanes gather)
+ */
+const uint8_t bpm_batch_encode_table[256] = {
+  /* 0x00 */ 4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,
+  /* 0x10 */ 4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,
+  /* 0x20 */ 4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,
+  /* 0x30 */ 4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,
+  /* 0x40 */ 4,0,4,1,4,4,4,2,4,4,4,4,4,4,4,4,
+  /* 0x50 */ 4,4,4,4,3,4,4,4,4,4,4,4,4,4,4,4,
+  /* 0x60 */ 4,0,4,1,4,4,4,2,4,4,4,4,4,4,4,4,
+  /* 0x70 */ 4,4,4,4,3,4,4,4,4,4,4,4,4,4,4,4,
+  /* 0x80 */ 4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,
+  /* 0x90 */ 4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,
+  /* 0xA0 */ 4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,
+  /* 0xB0 */ 4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,
+  /* 0xC0 */ 4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,
+  /* 0xD0 */ 4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,
+  /* 0xE0 */ 4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,
+  /* 0xF0 */ 4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,
+};
+#define bpm_batch_encode(character) (bpm_batch_encode_table[(uint8_t)(character)])
+
+/*
+ * Kernels (one per vector width)
+ */
+typedef void (*bpm_batch_kernel_f)(
+    bpm_batch_candidate_t** const candidates,
+    const int num_candidates);
+// Baseline (SSE2 on x86-64)
+#define BPM_BATCH_ATTRIBUTES
+#define BPM_BATCH_KERNEL      edit_bpm_batch_kernel_w64x2
+#define BPM_BATCH_WORD        uint64_t
+#define BPM_BATCH_SWORD       int64_t
+#define BPM_BATCH_LANES       2
+#include "edit_bpm_batch_kernel.h"
+#undef BPM_BATCH_KERNEL
+#undef BPM_BATCH_WORD
+#undef BPM_BATCH_SWORD
+#undef BPM_BATCH_LANES
+#define BPM_BATCH_KERNEL      edit_bpm_batch_kernel_w32x4
+#define BPM_BATCH_WORD        uint32_t
+#define BPM_BATCH_SWORD       int32_t
+#define BPM_BATCH_LANES       4
+#include "edit_bpm_batch_kernel.h"
+#undef BPM_BATCH_KERNEL
+#undef BPM_BATCH_WORD
+#undef BPM_BATCH_SWORD
+#undef BPM_BATCH_LANES
+#undef BPM_BATCH_ATTRIBUTES
+#if defined(__x86_64__) || defined(__i386__)
+// AVX2
+#define BPM_BATCH_ATTRIBUTES  __attribute__((target("avx2")))
+#define BPM_BATCH_KERNEL      edit_bpm_batch_kernel_w64x4
+#define BPM_BATCH_WORD        uint64_t
+#define BPM_BATCH_SWORD       int64_t
+#define BPM_BATCH_LANES       4
+#include "edit_bpm_batch_kernel.h"
+#undef BPM_BATCH_KERNEL
+#undef BPM_BATCH_WORD
+#undef BPM_BATCH_SWORD
+#undef BPM_BATCH_LANES
+#define BPM_BATCH_KERNEL      edit_bpm_batch_kernel_w32x8
+#define BPM_BATCH_WORD        uint32_t
+#define BPM_BATCH_SWORD       int32_t
+#define BPM_BATCH_LANES       8
+#include "edit_bpm_batch_kernel.h"
+#undef BPM_BATCH_KERNEL
+#undef BPM_BATCH_WORD
+#undef BPM_BATCH_SWORD
+#undef BPM_BATCH_LANES
+#undef BPM_BATCH_ATTRIBUTES
+// AVX-512
+#define BPM_BATCH_ATTRIBUTES  __attribute__((target("avx512f")))
+#define BPM_BATCH_KERNEL      edit_bpm_batch_kernel_w64x8
+#define BPM_BATCH_WORD        uint64_t
+#define BPM_BATCH_SWORD       int64_t
+#define BPM_BATCH_LANES       8
+#include "edit_bpm_batch_kernel.h"
+#undef BPM_BATCH_KERNEL
+#undef BPM_BATCH_WORD
+#undef BPM_BATCH_SWORD
+#undef BPM_BATCH_LANES
+#define BPM_BATCH_KERNEL      edit_bpm_batch_kernel_w32x16
+#define BPM_BATCH_WORD        uint32_t
+#define BPM_BATCH_SWORD       int32_t
+#define BPM_BATCH_LANES       16
+#include "edit_bpm_batch_kernel.h"
+#undef BPM_BATCH_KERNEL
+#undef BPM_BATCH_WORD
+#undef BPM_BATCH_SWORD
+#undef BPM_BATCH_LANES
+#undef BPM_BATCH_ATTRIBUTES
+#endif
+/*
+ * Dispatch (by the instruction set of the CPU)
+ */
+typedef struct {
+  const char* name;
+  bpm_batch_kernel_f kernel_w64;    // Patterns up to 64 bases
+  int lanes_w64;
+  bpm_batch_kernel_f kernel_w32;    // Patterns up to 32 bases
+  int lanes_w32;
+} bpm_batch_dispatch_t;
+bpm_batch_dispatch_t edit_bpm_batch_dispatch(void) {
+  bpm_batch_dispatch_t dispatch = {
+      "sse2",edit_bpm_batch_kernel_w64x2,2,edit_bpm_batch_kernel_w32x4,4};
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx512f")) {
+    dispatch.name = "avx512f";
+    dispatch.kernel_w64 = edit_bpm_batch_kernel_w64x8;
+    dispatch.lanes_w64 = 8;
+    dispatch.kernel_w32 = edit_bpm_batch_kernel_w32x16;
+    dispatch.lanes_w32 = 16;
+  } else if (__builtin_cpu_supports("avx2")) {
+    dispatch.name = "avx2";
+    dispatch.kernel_w64 = edit_bpm_batch_kernel_w64x4;
+    dispatch.lanes_w64 = 4;
+    dispatch.kernel_w32 = edit_bpm_batch_kernel_w32x8;
+    dispatch.lanes_w32 = 8;
+  }
+#endif
+  return dispatch;
+}
+const char* edit_bpm_batch_instruction_set(void) {
+  return edit_bpm_batch_dispatch().name;
+}
+/*
+ * Scalar (patterns longer than 64 bases)
+ */
+void edit_bpm_batch_compute_scalar(
+    bpm_batch_candidate_t* const candidate,
+    mm_allocator_t* const mm_allocator) {
+  bpm_pattern_t bpm_pattern;
+  edit_bpm_pattern_compile(&bpm_pattern,candidate->pattern,candidate->pattern_length,mm_allocator);
+  candidate->distance = (candidate->max_distance < 0) ?
+      edit_bpm_distance_compute(&bpm_pattern,candidate->text,candidate->text_length) :
+      edit_bpm_distance_compute_cutoff(&bpm_pattern,candidate->text,
+          candidate->text_length,candidate->max_distance,true);
+  edit_bpm_pattern_free(&bpm_pattern,mm_allocator);
+}
+/*
+ * Edit distance computation using BPM (batch)
+ */
+void edit_bpm_distance_batch_compute(
+    bpm_batch_candidate_t* const candidates,
+    const int num_candidates,
+    mm_allocator_t* const mm_allocator) {
+  const bpm_batch_dispatch_t dispatch = edit_bpm_batch_dispatch();
+  // Fill vectors of short (<=32) and long (<=64) patterns
+  bpm_batch_candidate_t* lanes_w32[BPM_BATCH_MAX_LANES];
+  bpm_batch_candidate_t* lanes_w64[BPM_BATCH_MAX_LANES];
+  int num_w32 = 0, num_w64 = 0, i;
+  for (i=0;i<num_candidates;++i) {
+    bpm_batch_candidate_t* const candidate = candidates + i;
+    const int pattern_length = candidate->pattern_length;
+    if (pattern_length > 0 && pattern_length <= UINT32_LENGTH) {
+      lanes_w32[num_w32++] = candidate;
+      if (num_w32 == dispatch.lanes_w32) {
+        dispatch.kernel_w32(lanes_w32,num_w32);
+        num_w32 = 0;
+      }
+    } else if (pattern_length > 0 && pattern_length <= UINT64_LENGTH) {
+      lanes_w64[num_w64++] = candidate;
+      if (num_w64 == dispatch.lanes_w64) {
+        dispatch.kernel_w64(lanes_w64,num_w64);
+        num_w64 = 0;
+      }
+    } else {
+      edit_bpm_batch_compute_scalar(candidate,mm_allocator);
+    }
+  }
+  // Partial vectors (the short patterns also fit the wide lanes)
+  if (num_w32 > 0 && num_w32+num_w64 <= dispatch.lanes_w64) {
+    memcpy(lanes_w64+num_w64,lanes_w32,num_w32*sizeof(bpm_batch_candidate_t*));
+    num_w64 += num_w32;
+  } else if (num_w32 > 0) {
+    dispatch.kernel_w32(lanes_w32,num_w32);
+  }
+  if (num_w64 > 0) dispatch.kernel_w64(lanes_w64,num_w64);
+}
@@ -0,0 +1,64 @@
+/*
+ *  Wavefront Alignments Algorithms
+ *  Copyright (c) 2020 by Santiago Marco-Sola  <santiagomsola@gmail.com>
+ *
+ *  This file is part of Wavefront Alignments Algorithms.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * PROJECT: Wavefront Alignments Algorithms
+ * AUTHOR(S): Santiago Marco-Sola <santiagomsola@gmail.com>
+ * DESCRIPTION: Inter-sequence (batched) BPM. Candidates with patterns of up to
+ *   64 bases are computed several at a time, one candidate per vector lane
+ *   (32-bit lanes if all the patterns of the vector fit in 32 bases). Every
+ *   text character advances all the lanes; lanes whose text is exhausted (or
+ *   that cannot match anymore) are masked out. The distances are the ones of
+ *   edit_bpm_distance_compute() (or edit_bpm_distance_compute_cutoff() with
+ *   quick-abandon if the candidate has a max distance)
+ */
+
+#ifndef EDIT_BPM_BATCH_H_
+#define EDIT_BPM_BATCH_H_
+
+#include "../utils/commons.h"
+#include "../system/mm_allocator.h"
+
+/*
+ * Batch candidate
+ */
+typedef struct {
+  // Input
+  char* pattern;
+  int pattern_length;
+  char* text;
+  int text_length;
+  int max_distance;             // Cut-off (-1 to compute the distance)
+  // Output
+  int distance;                 // INT_MAX if above the max distance
+} bpm_batch_candidate_t;
+
+/*
+ * Edit distance computation using BPM (batch)
+ */
+void edit_bpm_distance_batch_compute(
+    bpm_batch_candidate_t* const candidates,
+    const int num_candidates,
+    mm_allocator_t* const mm_allocator);
+
+/*
+ * Instruction set selected for this CPU
+ */
+const char* edit_bpm_batch_instruction_set(void);
+
+#endif /* EDIT_BPM_BATCH_H_ */
@@ -0,0 +1,162 @@
+/*
+ *  Wavefront Alignments Algorithms
+ *  Copyright (c) 2020 by Santiago Marco-Sola  <santiagomsola@gmail.com>
+ *
+ *  This file is part of Wavefront Alignments Algorithms.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * PROJECT: Wavefront Alignments Algorithms
+ * AUTHOR(S): Santiago Marco-Sola <santiagomsola@gmail.com>
+ * DESCRIPTION: Batched BPM kernel. Instantiated by edit_bpm_batch.cpp for
+ *   every vector width (no include guard), defining
+ *     BPM_BATCH_KERNEL      Function name
+ *     BPM_BATCH_ATTRIBUTES  Target attributes (or empty)
+ *     BPM_BATCH_WORD        Lane type (uint64_t/uint32_t)
+ *     BPM_BATCH_SWORD       Signed lane type (int64_t/int32_t)
+ *     BPM_BATCH_LANES       Lanes per vector
+ */
+
+/*
+ * Vector types
+ */
+#define BPM_BATCH_LANE_LENGTH (8*sizeof(BPM_BATCH_WORD))
+#define BPM_BATCH_CONCAT_(a,b) a##b
+#define BPM_BATCH_CONCAT(a,b) BPM_BATCH_CONCAT_(a,b)
+#define BPM_BATCH_VECTOR  BPM_BATCH_CONCAT(BPM_BATCH_KERNEL,_vector_t)
+#define BPM_BATCH_SVECTOR BPM_BATCH_CONCAT(BPM_BATCH_KERNEL,_svector_t)
+typedef BPM_BATCH_WORD BPM_BATCH_VECTOR
+    __attribute__((vector_size(BPM_BATCH_LANES*sizeof(BPM_BATCH_WORD))));
+typedef BPM_BATCH_SWORD BPM_BATCH_SVECTOR
+    __attribute__((vector_size(BPM_BATCH_LANES*sizeof(BPM_BATCH_SWORD))));
+
+/*
+ * Kernel (@num_candidates <= BPM_BATCH_LANES, patterns of 1..|word| bases)
+ */
+BPM_BATCH_ATTRIBUTES
+void BPM_BATCH_KERNEL(
+    bpm_batch_candidate_t** const candidates,
+    const int num_candidates) {
+  // Lanes setup
+  BPM_BATCH_WORD PEQ[BPM_BATCH_LANES][BPM_ALPHABET_LENGTH];
+  BPM_BATCH_WORD level_mask[BPM_BATCH_LANES];
+  BPM_BATCH_SWORD score[BPM_BATCH_LANES], max_distance[BPM_BATCH_LANES];
+  BPM_BATCH_SWORD text_length[BPM_BATCH_LANES], min_score[BPM_BATCH_LANES];
+  char* text[BPM_BATCH_LANES];
+  int lane, max_text_length = 0;
+  for (lane=0;lane<BPM_BATCH_LANES;++lane) {
+    if (lane >= num_candidates) { // Empty lane
+      memset(PEQ[lane],0,sizeof(PEQ[lane]));
+      level_mask[lane] = 1;
+      score[lane] = 1;
+      max_distance[lane] = 0;
+      text_length[lane] = 0;
+      min_score[lane] = INT_MAX;
+      text[lane] = NULL;
+      continue;
+    }
+    bpm_batch_candidate_t* const candidate = candidates[lane];
+    const int pattern_length = candidate->pattern_length;
+    // Pattern equalities (padding bits match any character)
+    int i, c;
+    for (c=0;c<BPM_ALPHABET_LENGTH;++c) {
+      PEQ[lane][c] = (pattern_length < (int)BPM_BATCH_LANE_LENGTH) ?
+          ~(BPM_BATCH_WORD)0 << pattern_length : 0;
+    }
+    for (i=0;i<pattern_length;++i) {
+      const uint8_t enc_char = dna_encode(candidate->pattern[i]);
+      if (enc_char==ENC_DNA_CHAR_N) continue; // N's Inequality
+      PEQ[lane][enc_char] |= (BPM_BATCH_WORD)1 << i;
+    }
+    level_mask[lane] = (BPM_BATCH_WORD)1 << (pattern_length-1);
+    score[lane] = pattern_length;
+    // Max distance (the score never exceeds the pattern length)
+    max_distance[lane] = (candidate->max_distance < 0) ? pattern_length :
+        MIN(candidate->max_distance,pattern_length-1);
+    text[lane] = candidate->text;
+    text_length[lane] = candidate->text_length;
+    min_score[lane] = INT_MAX;
+    max_text_length = MAX(max_text_length,candidate->text_length);
+  }
+  // Load vectors
+  BPM_BATCH_VECTOR Pv, Mv, mask;
+  BPM_BATCH_SVECTOR score_v, max_distance_v, text_length_v, min_score_v, alive;
+  memset(&Pv,0xFF,sizeof(Pv));
+  memset(&Mv,0,sizeof(Mv));
+  memset(&alive,0xFF,sizeof(alive));
+  memcpy(&mask,level_mask,sizeof(mask));
+  memcpy(&score_v,score,sizeof(score_v));
+  memcpy(&max_distance_v,max_distance,sizeof(max_distance_v));
+  memcpy(&text_length_v,text_length,sizeof(text_length_v));
+  memcpy(&min_score_v,min_score,sizeof(min_score_v));
+  // Advance all lanes in the DP-bit_encoded matrix
+  int text_position;
+  for (text_position=0;text_position<max_text_length;++text_position) {
+    // Gather the equalities of the next characters
+    BPM_BATCH_WORD Eq_lanes[BPM_BATCH_LANES];
+    for (lane=0;lane<BPM_BATCH_LANES;++lane) {
+      Eq_lanes[lane] = (text_position < text_length[lane]) ?
+          PEQ[lane][bpm_batch_encode(text[lane][text_position])] : 0;
+    }
+    BPM_BATCH_VECTOR Eq;
+    memcpy(&Eq,Eq_lanes,sizeof(Eq));
+    // Active lanes (text left and still able to match)
+    const BPM_BATCH_SVECTOR active = (text_length_v > text_position) & alive;
+    const BPM_BATCH_VECTOR active_mask = (BPM_BATCH_VECTOR)active;
+    // Compute block (as BPM_ADVANCE_BLOCK, without Hin)
+    const BPM_BATCH_VECTOR Xv = Eq | Mv;
+    const BPM_BATCH_VECTOR Xh = (((Eq & Pv) + Pv) ^ Pv) | Eq;
+    BPM_BATCH_VECTOR Ph = Mv | ~(Xh | Pv);
+    BPM_BATCH_VECTOR Mh = Pv & Xh;
+    const BPM_BATCH_SVECTOR PHout = (BPM_BATCH_SVECTOR)((Ph & mask) != 0); // -1 if set
+    const BPM_BATCH_SVECTOR MHout = (BPM_BATCH_SVECTOR)((Mh & mask) != 0);
+    Ph <<= 1;
+    Mh <<= 1;
+    const BPM_BATCH_VECTOR Pv_next = Mh | ~(Xv | Ph);
+    const BPM_BATCH_VECTOR Mv_next = Ph & Xv;
+    Pv = (Pv_next & active_mask) | (Pv & ~active_mask);
+    Mv = (Mv_next & active_mask) | (Mv & ~active_mask);
+    score_v += (MHout - PHout) & active;
+    // Check match
+    const BPM_BATCH_SVECTOR match =
+        active & (BPM_BATCH_SVECTOR)(score_v <= max_distance_v) & (BPM_BATCH_SVECTOR)(score_v < min_score_v);
+    min_score_v = (score_v & match) | (min_score_v & ~match);
+    // Quick abandon (bounded by best case scenario)
+    const BPM_BATCH_SVECTOR text_left = text_length_v - text_position;
+    const BPM_BATCH_SVECTOR abandon = active &
+        (BPM_BATCH_SVECTOR)(min_score_v == INT_MAX) &
+        (BPM_BATCH_SVECTOR)(score_v > text_left + max_distance_v);
+    alive &= ~abandon;
+    // Stop once all the lanes are done
+    if ((text_position % BPM_BATCH_LANE_CHECK) == BPM_BATCH_LANE_CHECK-1) {
+      const BPM_BATCH_SVECTOR pending = (text_length_v > (text_position+1)) & alive;
+      BPM_BATCH_SWORD pending_lanes[BPM_BATCH_LANES];
+      memcpy(pending_lanes,&pending,sizeof(pending));
+      BPM_BATCH_SWORD any_pending = 0;
+      for (lane=0;lane<BPM_BATCH_LANES;++lane) any_pending |= pending_lanes[lane];
+      if (!any_pending) break;
+    }
+  }
+  // Return results
+  memcpy(min_score,&min_score_v,sizeof(min_score_v));
+  for (lane=0;lane<num_candidates;++lane) {
+    candidates[lane]->distance = min_score[lane];
+  }
+}
+
+#undef BPM_BATCH_LANE_LENGTH
+#undef BPM_BATCH_VECTOR
+#undef BPM_BATCH_SVECTOR
+#undef BPM_BATCH_CONCAT
+#undef BPM_BATCH_CONCAT_
@@ -40,6 +40,11 @@
 #define BPM_PATTERN_PEQ_IDX(word_pos,encoded_character)   ((word_pos*BPM_ALPHABET_LENGTH)+(encoded_character))
 #define BPM_PATTERN_BDP_IDX(position,num_words,word_pos)  ((position)*(num_words)+(word_pos))
 
+/*
+ * Packed sequences (2-bit, 4 bases per byte with the first base in the most significant bits)
+ */
+#define BPM_PACKED_BASE(packed,position)  (((packed)[(position)>>2] >> (6-2*((position)&3))) & 3)
+
 /*
  * Advance block functions (Improved)
  *   const @vector Eq,mask;
@@ -68,26 +73,32 @@
 /*
  * Setup
  */
-void edit_bpm_pattern_compile(
+void edit_bpm_pattern_allocate(
     bpm_pattern_t* const bpm_pattern,
-    char* const pattern,
     const int pattern_length,
+    const bool reuse,
     mm_allocator_t* const mm_allocator) {
   // Calculate dimensions
   const uint64_t pattern_num_words64 = DIV_CEIL(pattern_length,BPM_W64_LENGTH);
-  const uint64_t PEQ_length = pattern_num_words64*BPM_W64_LENGTH;
   const uint64_t pattern_mod = pattern_length%BPM_W64_LENGTH;
   // Init fields
-  bpm_pattern->pattern = pattern;
+  bpm_pattern->pattern = NULL;
   bpm_pattern->pattern_length = pattern_length;
   bpm_pattern->pattern_num_words64 = pattern_num_words64;
   bpm_pattern->pattern_mod = pattern_mod;
-  // Allocate memory
+  // Allocate memory (or reuse it, if large enough)
   const uint64_t aux_vector_size = pattern_num_words64*BPM_W64_SIZE;
   const uint64_t PEQ_size = BPM_ALPHABET_LENGTH*aux_vector_size;
   const uint64_t score_size = pattern_num_words64*UINT64_SIZE;
-  const uint64_t total_memory = PEQ_size + 3*aux_vector_size + 2*score_size + (pattern_num_words64+1)*UINT64_SIZE;
-  void* memory = mm_allocator_malloc(mm_allocator,total_memory);
+  void* memory;
+  if (reuse && pattern_num_words64 <= bpm_pattern->pattern_num_words64_allocated) {
+    memory = bpm_pattern->PEQ;
+  } else {
+    if (reuse) mm_allocator_free(mm_allocator,bpm_pattern->PEQ);
+    const uint64_t total_memory = PEQ_size + 3*aux_vector_size + 2*score_size + (pattern_num_words64+1)*UINT64_SIZE;
+    memory = mm_allocator_malloc(mm_allocator,total_memory);
+    bpm_pattern->pattern_num_words64_allocated = pattern_num_words64;
+  }
   bpm_pattern->PEQ = (uint64_t*) memory; 
   memory += PEQ_size;
   bpm_pattern->P = (uint64_t*)memory; 
@@ -101,17 +112,19 @@ void edit_bpm_pattern_compile(
   bpm_pattern->init_score =(int64_t*) memory;
   memory += score_size;
   bpm_pattern->pattern_left = (uint64_t*) memory;
-  // Init PEQ
+  // Clear PEQ
   memset(bpm_pattern->PEQ,0,PEQ_size);
+}
+void edit_bpm_pattern_init(
+    bpm_pattern_t* const bpm_pattern) {
+  // Parameters
+  const uint64_t pattern_length = bpm_pattern->pattern_length;
+  const uint64_t pattern_num_words64 = bpm_pattern->pattern_num_words64;
+  const uint64_t pattern_mod = bpm_pattern->pattern_mod;
+  const uint64_t PEQ_length = pattern_num_words64*BPM_W64_LENGTH;
+  // Init PEQ padding
   uint64_t i;
-  for (i=0;i<pattern_length;++i) {
-    const uint8_t enc_char = dna_encode(pattern[i]);
-    if (enc_char==ENC_DNA_CHAR_N) continue; // N's Inequality
-    const uint64_t block = i/BPM_W64_LENGTH;
-    const uint64_t mask = 1ull<<(i%BPM_W64_LENGTH);
-    bpm_pattern->PEQ[BPM_PATTERN_PEQ_IDX(block,enc_char)] |= mask;
-  }
-  for (;i<PEQ_length;++i) { // Padding
+  for (i=pattern_length;i<PEQ_length;++i) {
     const uint64_t block = i/BPM_W64_LENGTH;
     const uint64_t mask = 1ull<<(i%BPM_W64_LENGTH);
     uint64_t j;
@@ -122,7 +135,7 @@ void edit_bpm_pattern_compile(
   // Init auxiliary data
   uint64_t pattern_left = pattern_length;
   const uint64_t top = pattern_num_words64-1;
-  memset(bpm_pattern->level_mask,0,aux_vector_size);
+  memset(bpm_pattern->level_mask,0,pattern_num_words64*BPM_W64_SIZE);
   for (i=0;i<top;++i) {
     bpm_pattern->level_mask[i] = BPM_W64_MASK;
     bpm_pattern->init_score[i] = BPM_W64_LENGTH;
@@ -142,6 +155,81 @@ void edit_bpm_pattern_compile(
     bpm_pattern->init_score[top] = BPM_W64_LENGTH;
   }
 }
+void edit_bpm_pattern_init_peq(
+    bpm_pattern_t* const bpm_pattern,
+    char* const pattern) {
+  const uint64_t pattern_length = bpm_pattern->pattern_length;
+  uint64_t i;
+  for (i=0;i<pattern_length;++i) {
+    const uint8_t enc_char = dna_encode(pattern[i]);
+    if (enc_char==ENC_DNA_CHAR_N) continue; // N's Inequality
+    const uint64_t block = i/BPM_W64_LENGTH;
+    const uint64_t mask = 1ull<<(i%BPM_W64_LENGTH);
+    bpm_pattern->PEQ[BPM_PATTERN_PEQ_IDX(block,enc_char)] |= mask;
+  }
+  bpm_pattern->pattern = pattern;
+}
+void edit_bpm_pattern_init_peq_packed(
+    bpm_pattern_t* const bpm_pattern,
+    const uint8_t* const pattern,
+    const uint32_t* const n_runs,
+    const uint64_t num_n_runs) {
+  const uint64_t pattern_length = bpm_pattern->pattern_length;
+  uint64_t i, run;
+  for (i=0;i<pattern_length;++i) {
+    const uint64_t block = i/BPM_W64_LENGTH;
+    const uint64_t mask = 1ull<<(i%BPM_W64_LENGTH);
+    bpm_pattern->PEQ[BPM_PATTERN_PEQ_IDX(block,BPM_PACKED_BASE(pattern,i))] |= mask;
+  }
+  for (run=0;run<num_n_runs;++run) { // N's Inequality (packed as A)
+    const uint64_t run_end = n_runs[2*run] + n_runs[2*run+1];
+    for (i=n_runs[2*run];i<run_end;++i) {
+      const uint64_t block = i/BPM_W64_LENGTH;
+      const uint64_t mask = 1ull<<(i%BPM_W64_LENGTH);
+      bpm_pattern->PEQ[BPM_PATTERN_PEQ_IDX(block,ENC_DNA_CHAR_A)] &= ~mask;
+    }
+  }
+}
+void edit_bpm_pattern_compile(
+    bpm_pattern_t* const bpm_pattern,
+    char* const pattern,
+    const int pattern_length,
+    mm_allocator_t* const mm_allocator) {
+  edit_bpm_pattern_allocate(bpm_pattern,pattern_length,false,mm_allocator);
+  edit_bpm_pattern_init_peq(bpm_pattern,pattern);
+  edit_bpm_pattern_init(bpm_pattern);
+}
+void edit_bpm_pattern_compile_packed(
+    bpm_pattern_t* const bpm_pattern,
+    const uint8_t* const pattern,
+    const int pattern_length,
+    const uint32_t* const n_runs,
+    const uint64_t num_n_runs,
+    mm_allocator_t* const mm_allocator) {
+  edit_bpm_pattern_allocate(bpm_pattern,pattern_length,false,mm_allocator);
+  edit_bpm_pattern_init_peq_packed(bpm_pattern,pattern,n_runs,num_n_runs);
+  edit_bpm_pattern_init(bpm_pattern);
+}
+void edit_bpm_pattern_recompile(
+    bpm_pattern_t* const bpm_pattern,
+    char* const pattern,
+    const int pattern_length,
+    mm_allocator_t* const mm_allocator) {
+  edit_bpm_pattern_allocate(bpm_pattern,pattern_length,true,mm_allocator);
+  edit_bpm_pattern_init_peq(bpm_pattern,pattern);
+  edit_bpm_pattern_init(bpm_pattern);
+}
+void edit_bpm_pattern_recompile_packed(
+    bpm_pattern_t* const bpm_pattern,
+    const uint8_t* const pattern,
+    const int pattern_length,
+    const uint32_t* const n_runs,
+    const uint64_t num_n_runs,
+    mm_allocator_t* const mm_allocator) {
+  edit_bpm_pattern_allocate(bpm_pattern,pattern_length,true,mm_allocator);
+  edit_bpm_pattern_init_peq_packed(bpm_pattern,pattern,n_runs,num_n_runs);
+  edit_bpm_pattern_init(bpm_pattern);
+}
 void edit_bpm_pattern_free(
     bpm_pattern_t* const bpm_pattern,
     mm_allocator_t* const mm_allocator) {
@@ -230,12 +318,34 @@ int8_t bpm_advance_block(
   return hout;
 }
 /*
- * BPM Distance Compute
+ * BPM Distance Compute (text of characters)
  */
-int edit_bpm_distance_compute(
+#define BPM_KERNEL(name)             name
+#define BPM_TEXT_T                   char* const
+#define BPM_TEXT_ENC(text,position)  dna_encode(text[position])
+#include "edit_bpm_distance_kernel.h"
+#undef BPM_KERNEL
+#undef BPM_TEXT_T
+#undef BPM_TEXT_ENC
+/*
+ * BPM Distance Compute (2-bit packed text)
+ */
+#define BPM_KERNEL(name)             name##_packed
+#define BPM_TEXT_T                   const uint8_t* const
+#define BPM_TEXT_ENC(text,position)  BPM_PACKED_BASE(text,position)
+#include "edit_bpm_distance_kernel.h"
+#undef BPM_KERNEL
+#undef BPM_TEXT_T
+#undef BPM_TEXT_ENC
+/*
+ * BPM Alignment (keeps the Pv/Mv bit-vectors of every column)
+ */
+void edit_bpm_alignment_compute_matrix(
+    bpm_alignment_t* const bpm_alignment,
     bpm_pattern_t* const bpm_pattern,
     char* const text,
-    const int text_length) {
+    const int text_length,
+    mm_allocator_t* const mm_allocator) {
   // Pattern variables
   const uint64_t* PEQ = bpm_pattern->PEQ;
   const uint64_t num_words64 = bpm_pattern->pattern_num_words64;
@@ -244,118 +354,146 @@ int edit_bpm_distance_compute(
   const uint64_t* const level_mask = bpm_pattern->level_mask;
   int64_t* const score = bpm_pattern->score;
   const int64_t* const init_score = bpm_pattern->init_score;
+  // Allocate bit-DP (column 0 is the initial one) and hits
+  const uint64_t bdp_size = (text_length+1)*num_words64;
+  uint64_t* const Pv = mm_allocator_calloc(mm_allocator,bdp_size,uint64_t,false);
+  uint64_t* const Mv = mm_allocator_calloc(mm_allocator,bdp_size,uint64_t,false);
+  int* const end_positions = mm_allocator_calloc(mm_allocator,MAX(text_length,1),int,false);
+  int num_end_positions = 0;
   // Initialize search
   int min_score = INT_MAX;
   bpm_reset_search(num_words64,P,M,score,init_score);
-  // Advance in DP-bit_encoded matrix
+  memcpy(Pv,P,num_words64*BPM_W64_SIZE);
+  memcpy(Mv,M,num_words64*BPM_W64_SIZE);
+  // Advance in DP-bit_encoded matrix (storing every column)
   uint64_t text_position;
   for (text_position=0;text_position<text_length;++text_position) {
     // Fetch next character
     const uint8_t enc_char = dna_encode(text[text_position]);
     // Advance all blocks
+    uint64_t* const Pv_column = Pv + BPM_PATTERN_BDP_IDX(text_position+1,num_words64,0);
+    uint64_t* const Mv_column = Mv + BPM_PATTERN_BDP_IDX(text_position+1,num_words64,0);
     int8_t carry;
     uint64_t i;
     for (i=0,carry=0;i<num_words64;++i) {
-      uint64_t* const Py = P+i;
-      uint64_t* const My = M+i;
-      carry = bpm_advance_block(PEQ[BPM_PATTERN_PEQ_IDX(i,enc_char)],level_mask[i],*Py,*My,carry+1,Py,My);
+      carry = bpm_advance_block(PEQ[BPM_PATTERN_PEQ_IDX(i,enc_char)],level_mask[i],P[i],M[i],carry+1,P+i,M+i);
       score[i] += carry;
+      Pv_column[i] = P[i];
+      Mv_column[i] = M[i];
     }
-    // Check match
-    if (score[num_words64-1] < min_score) {
-      min_score = score[num_words64-1];
+    // Check match (keep every end position of the best hits)
+    const int64_t column_score = score[num_words64-1];
+    if (column_score < min_score) {
+      min_score = column_score;
+      num_end_positions = 0;
+    }
+    if (column_score == min_score) {
+      end_positions[num_end_positions++] = text_position+1;
     }
   }
-  // Return results
-  return min_score;
+  // Set results
+  bpm_alignment->Pv = Pv;
+  bpm_alignment->Mv = Mv;
+  bpm_alignment->distance = min_score;
+  bpm_alignment->end_positions = end_positions;
+  bpm_alignment->num_end_positions = num_end_positions;
 }
-int edit_bpm_distance_compute_cutoff(
+void edit_bpm_alignment_traceback(
+    bpm_alignment_t* const bpm_alignment,
     bpm_pattern_t* const bpm_pattern,
     char* const text,
-    const int text_length,
-    int max_distance,
-    const bool quick_abandon) {
-  // Pattern variables
-  const uint64_t* PEQ = bpm_pattern->PEQ;
+    const int text_end,
+    mm_allocator_t* const mm_allocator) {
+  // Parameters
+  const uint64_t* const PEQ = bpm_pattern->PEQ;
   const uint64_t num_words64 = bpm_pattern->pattern_num_words64;
-  uint64_t* const P = bpm_pattern->P;
-  uint64_t* const M = bpm_pattern->M;
-  const uint64_t* const level_mask = bpm_pattern->level_mask;
-  int64_t* const score = bpm_pattern->score;
-  const int64_t* const init_score = bpm_pattern->init_score;
-  const uint64_t* const pattern_left = bpm_pattern->pattern_left;
-  // Initialize search
-  if (max_distance >= bpm_pattern->pattern_length) {
-    max_distance = bpm_pattern->pattern_length-1; // Correct max-distance
-  }
-  const uint64_t max_distance__1 = max_distance+1;
-  const uint8_t top = num_words64-1;
-  uint8_t top_level;
-  int min_score = INT_MAX;
-  bpm_reset_search_cutoff(&top_level,P,M,score,init_score,max_distance);
-  // Advance in DP-bit_encoded matrix
-  uint64_t text_position, text_left=text_length;
-  for (text_position=0;text_position<text_length;++text_position,--text_left) {
-    // Fetch next character
-    const uint8_t enc_char = dna_encode(text[text_position]);
-    // Advance all blocks
-    uint64_t i,PHin=0,MHin=0,PHout,MHout;
-    for (i=0;i<top_level;++i) {
-      uint64_t Pv = P[i];
-      uint64_t Mv = M[i];
-      const uint64_t mask = level_mask[i];
-      const uint64_t Eq = PEQ[BPM_PATTERN_PEQ_IDX(i,enc_char)];
-      /* Compute Block */
-      BPM_ADVANCE_BLOCK(Eq,mask,Pv,Mv,PHin,MHin,PHout,MHout);
-      /* Save Block Pv,Mv */
-      P[i]=Pv;
-      M[i]=Mv;
-      /* Adjust score and swap propagate Hv */
-      score[i] += PHout-MHout;
-      PHin=PHout;
-      MHin=MHout;
-    }
-    // Cut-off
-    const uint8_t last = top_level-1;
-    if (score[last]<=max_distance__1 && last<top) {
-      const uint64_t last_score = score[last]+(MHin-PHin);
-      const uint64_t Peq = PEQ[BPM_PATTERN_PEQ_IDX(top_level,enc_char)];
-      if (last_score<=max_distance && (MHin || (Peq & 1))) {
-        // Init block V
-        uint64_t Pv = BPM_W64_ONES;
-        uint64_t Mv = 0;
-        const uint64_t mask = level_mask[top_level];
-        /* Compute Block */
-        BPM_ADVANCE_BLOCK(Peq,mask,Pv,Mv,PHin,MHin,PHout,MHout);
-        /* Save Block Pv,Mv */
-        P[top_level]=Pv;
-        M[top_level]=Mv;
-        /* Set score & increment the top level block */
-        score[top_level] = last_score + init_score[top_level] + (PHout-MHout);
-        ++top_level;
-      } else {
-        while (score[top_level-1] > (max_distance+init_score[top_level-1])) {
-          --top_level;
-        }
-      }
+  const uint64_t* const Pv = bpm_alignment->Pv;
+  const uint64_t* const Mv = bpm_alignment->Mv;
+  const int pattern_length = bpm_pattern->pattern_length;
+  // Allocate operations (written backwards, from the end of the buffer)
+  const int max_operations = pattern_length+text_end;
+  char* const operations = mm_allocator_calloc(mm_allocator,max_operations+1,char,false);
+  int op_position = max_operations;
+  operations[op_position] = '\0';
+  // Traceback (from the last row to the first one, where the text is ends-free)
+  int h = text_end, v = pattern_length-1;
+  while (v >= 0 && h > 0) {
+    const uint64_t block = v/BPM_W64_LENGTH;
+    const uint64_t bdp_idx = BPM_PATTERN_BDP_IDX(h,num_words64,block);
+    const uint64_t mask = 1ull<<(v%BPM_W64_LENGTH);
+    if (Pv[bdp_idx] & mask) {
+      // Vertical +1 (the pattern character is deleted)
+      operations[--op_position] = 'D';
+      --v;
+    } else if (Mv[bdp_idx-num_words64] & mask) {
+      // Vertical -1 on the previous column (the text character is inserted)
+      operations[--op_position] = 'I';
+      --h;
     } else {
-      while (score[top_level-1] > (max_distance+init_score[top_level-1])) {
-        --top_level;
-      }
-    }
-    // Check match
-    const int64_t current_score = score[top_level-1];
-    if (top_level==num_words64 && current_score<=max_distance) {
-      if (current_score < min_score) min_score = current_score;
-    } else if (quick_abandon) {
-      // Quick abandon, if it doesn't match (bounded by best case scenario)
-      if (min_score==INT_MAX && current_score+pattern_left[top_level] > text_left+max_distance) return INT_MAX;
+      // Diagonal (equality as seen by the PEQ, so N's mismatch)
+      const uint8_t enc_char = dna_encode(text[h-1]);
+      operations[--op_position] = (PEQ[BPM_PATTERN_PEQ_IDX(block,enc_char)] & mask) ? 'M' : 'X';
+      --h; --v;
     }
   }
-  // Return results
-  return min_score;
+  while (v >= 0) {
+    operations[--op_position] = 'D';
+    --v;
+  }
+  // Set alignment
+  bpm_alignment->text_begin = h;
+  bpm_alignment->text_end = text_end;
+  bpm_alignment->operations = operations;
+  bpm_alignment->operations_begin = op_position;
+  bpm_alignment->num_operations = max_operations-op_position;
+}
+void edit_bpm_alignment_compute(
+    bpm_alignment_t* const bpm_alignment,
+    bpm_pattern_t* const bpm_pattern,
+    char* const text,
+    const int text_length,
+    const bool traceback,
+    mm_allocator_t* const mm_allocator) {
+  // Compute bit-DP and best hits
+  edit_bpm_alignment_compute_matrix(bpm_alignment,bpm_pattern,text,text_length,mm_allocator);
+  // Traceback (first best hit)
+  bpm_alignment->operations = NULL;
+  bpm_alignment->operations_begin = 0;
+  bpm_alignment->num_operations = 0;
+  bpm_alignment->text_begin = 0;
+  bpm_alignment->text_end = 0;
+  if (traceback && bpm_alignment->num_end_positions > 0) {
+    edit_bpm_alignment_traceback(bpm_alignment,bpm_pattern,
+        text,bpm_alignment->end_positions[0],mm_allocator);
+  }
+}
+void edit_bpm_alignment_free(
+    bpm_alignment_t* const bpm_alignment,
+    mm_allocator_t* const mm_allocator) {
+  if (bpm_alignment->operations != NULL) {
+    mm_allocator_free(mm_allocator,bpm_alignment->operations);
+  }
+  mm_allocator_free(mm_allocator,bpm_alignment->end_positions);
+  mm_allocator_free(mm_allocator,bpm_alignment->Mv);
+  mm_allocator_free(mm_allocator,bpm_alignment->Pv);
+}
+int edit_bpm_alignment_sprint_cigar(
+    bpm_alignment_t* const bpm_alignment,
+    char* const buffer) {
+  const char* const operations = bpm_alignment->operations + bpm_alignment->operations_begin;
+  const int num_operations = bpm_alignment->num_operations;
+  int i = 0, length = 0;
+  while (i < num_operations) {
+    // Run-length encode
+    const char operation = operations[i];
+    int run_length = 1;
+    while (i+run_length < num_operations && operations[i+run_length] == operation) ++run_length;
+    length += sprintf(buffer+length,"%d%c",run_length,operation);
+    i += run_length;
+  }
+  buffer[length] = '\0';
+  return length;
 }
-
 
 
 
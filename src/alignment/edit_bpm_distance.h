@@ -46,8 +46,28 @@ typedef struct {
   int64_t* score;
   int64_t* init_score;
   uint64_t* pattern_left;
+  uint64_t pattern_num_words64_allocated; // Capacity (reused on recompilation)
 } bpm_pattern_t;
 
+/*
+ * BPM Alignment
+ */
+typedef struct {
+  /* Bit-DP (Pv/Mv of the text columns [0,text_length]; 64x smaller than the DP) */
+  uint64_t* Pv;
+  uint64_t* Mv;
+  /* Best hits */
+  int distance;                 // Edit distance
+  int* end_positions;           // Text end (exclusive) of every hit at @distance
+  int num_end_positions;
+  /* Alignment of the first best hit (traceback) */
+  int text_begin;
+  int text_end;
+  char* operations;             // {M,X,I,D} (I: text only, D: pattern only)
+  int operations_begin;         // First operation (written backwards)
+  int num_operations;
+} bpm_alignment_t;
+
 /*
  * Setup
  */
@@ -56,6 +76,25 @@ void edit_bpm_pattern_compile(
     char* const pattern,
     const int pattern_length,
     mm_allocator_t* const mm_allocator);
+void edit_bpm_pattern_compile_packed(
+    bpm_pattern_t* const bpm_pattern,
+    const uint8_t* const pattern,
+    const int pattern_length,
+    const uint32_t* const n_runs,
+    const uint64_t num_n_runs,
+    mm_allocator_t* const mm_allocator);
+void edit_bpm_pattern_recompile(
+    bpm_pattern_t* const bpm_pattern,
+    char* const pattern,
+    const int pattern_length,
+    mm_allocator_t* const mm_allocator);
+void edit_bpm_pattern_recompile_packed(
+    bpm_pattern_t* const bpm_pattern,
+    const uint8_t* const pattern,
+    const int pattern_length,
+    const uint32_t* const n_runs,
+    const uint64_t num_n_runs,
+    mm_allocator_t* const mm_allocator);
 void edit_bpm_pattern_free(
     bpm_pattern_t* const bpm_pattern,
     mm_allocator_t* const mm_allocator);
@@ -73,5 +112,49 @@ int edit_bpm_distance_compute_cutoff(
     const int text_length,
     int max_distance,
     const bool quick_abandon);
+int edit_bpm_distance_compute_banded(
+    bpm_pattern_t* const bpm_pattern,
+    char* const text,
+    const int text_length,
+    const int bandwidth);
+
+/*
+ * Edit distance computation using BPM (2-bit packed text, 4 bases per byte
+ * with the first base in the most significant bits; without uncalled bases)
+ */
+int edit_bpm_distance_compute_packed(
+    bpm_pattern_t* const bpm_pattern,
+    const uint8_t* const text,
+    const int text_length);
+int edit_bpm_distance_compute_cutoff_packed(
+    bpm_pattern_t* const bpm_pattern,
+    const uint8_t* const text,
+    const int text_length,
+    int max_distance,
+    const bool quick_abandon);
+int edit_bpm_distance_compute_banded_packed(
+    bpm_pattern_t* const bpm_pattern,
+    const uint8_t* const text,
+    const int text_length,
+    const int bandwidth);
+
+/*
+ * Alignment using BPM (end positions of the best hits and, optionally,
+ * the alignment of the first one by traceback of the bit-DP; allocated
+ * from @mm_allocator until edit_bpm_alignment_free())
+ */
+void edit_bpm_alignment_compute(
+    bpm_alignment_t* const bpm_alignment,
+    bpm_pattern_t* const bpm_pattern,
+    char* const text,
+    const int text_length,
+    const bool traceback,
+    mm_allocator_t* const mm_allocator);
+void edit_bpm_alignment_free(
+    bpm_alignment_t* const bpm_alignment,
+    mm_allocator_t* const mm_allocator);
+int edit_bpm_alignment_sprint_cigar(
+    bpm_alignment_t* const bpm_alignment,
+    char* const buffer); // At least 2*num_operations+1 characters
 
 #endif /* EDIT_BPM_H_ */
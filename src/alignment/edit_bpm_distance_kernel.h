@@ -0,0 +1,359 @@
+/*
+ *  Wavefront Alignments Algorithms
+ *  Copyright (c) 2020 by Santiago Marco-Sola  <santiagomsola@gmail.com>
+ *
+ *  This file is part of Wavefront Alignments Algorithms.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * PROJECT: Wavefront Alignments Algorithms
+ * AUTHOR(S): Santiago Marco-Sola <santiagomsola@gmail.com>
+ * DESCRIPTION: BPM distance kernels. Instantiated by edit_bpm_distance.cpp
+ *   for every text representation (no include guard), defining
+ *     BPM_KERNEL(name)            Function name
+ *     BPM_TEXT_T                  Text type
+ *     BPM_TEXT_ENC(text,position) Encoded character at @position
+ */
+
+/*
+ * BPM Distance Compute (specialized for 1 and 2 words; the state is
+ * kept in registers, so only PEQ is read from memory)
+ */
+int BPM_KERNEL(edit_bpm_distance_compute_w1)(
+    bpm_pattern_t* const bpm_pattern,
+    BPM_TEXT_T text,
+    const int text_length) {
+  const uint64_t* const PEQ = bpm_pattern->PEQ;
+  const uint64_t mask = bpm_pattern->level_mask[0];
+  uint64_t Pv = BPM_W64_ONES, Mv = 0, PHout, MHout;
+  int64_t score = bpm_pattern->init_score[0];
+  int min_score = INT_MAX;
+  int text_position;
+  for (text_position=0;text_position<text_length;++text_position) {
+    const uint64_t Eq = PEQ[BPM_PATTERN_PEQ_IDX(0,BPM_TEXT_ENC(text,text_position))];
+    BPM_ADVANCE_BLOCK(Eq,mask,Pv,Mv,0,0,PHout,MHout);
+    score += PHout-MHout;
+    if (score < min_score) min_score = score;
+  }
+  return min_score;
+}
+int BPM_KERNEL(edit_bpm_distance_compute_w2)(
+    bpm_pattern_t* const bpm_pattern,
+    BPM_TEXT_T text,
+    const int text_length) {
+  const uint64_t* const PEQ = bpm_pattern->PEQ;
+  const uint64_t mask0 = bpm_pattern->level_mask[0];
+  const uint64_t mask1 = bpm_pattern->level_mask[1];
+  uint64_t Pv0 = BPM_W64_ONES, Mv0 = 0, Pv1 = BPM_W64_ONES, Mv1 = 0;
+  uint64_t PHout0, MHout0, PHout1, MHout1;
+  int64_t score0 = bpm_pattern->init_score[0];
+  int64_t score1 = score0 + bpm_pattern->init_score[1];
+  int min_score = INT_MAX;
+  int text_position;
+  for (text_position=0;text_position<text_length;++text_position) {
+    const uint8_t enc_char = BPM_TEXT_ENC(text,text_position);
+    const uint64_t Eq0 = PEQ[BPM_PATTERN_PEQ_IDX(0,enc_char)];
+    const uint64_t Eq1 = PEQ[BPM_PATTERN_PEQ_IDX(1,enc_char)];
+    { BPM_ADVANCE_BLOCK(Eq0,mask0,Pv0,Mv0,0,0,PHout0,MHout0); }
+    { BPM_ADVANCE_BLOCK(Eq1,mask1,Pv1,Mv1,PHout0,MHout0,PHout1,MHout1); }
+    score0 += PHout0-MHout0;
+    score1 += PHout1-MHout1;
+    if (score1 < min_score) min_score = score1;
+  }
+  return min_score;
+}
+int BPM_KERNEL(edit_bpm_distance_compute_cutoff_w1)(
+    bpm_pattern_t* const bpm_pattern,
+    BPM_TEXT_T text,
+    const int text_length,
+    const int max_distance,
+    const bool quick_abandon) {
+  const uint64_t* const PEQ = bpm_pattern->PEQ;
+  const uint64_t mask = bpm_pattern->level_mask[0];
+  uint64_t Pv = BPM_W64_ONES, Mv = 0, PHout, MHout;
+  int64_t score = bpm_pattern->init_score[0];
+  int min_score = INT_MAX;
+  int text_position, text_left=text_length;
+  for (text_position=0;text_position<text_length;++text_position,--text_left) {
+    const uint64_t Eq = PEQ[BPM_PATTERN_PEQ_IDX(0,BPM_TEXT_ENC(text,text_position))];
+    BPM_ADVANCE_BLOCK(Eq,mask,Pv,Mv,0,0,PHout,MHout);
+    score += PHout-MHout;
+    // Check match (the single block is never cut-off)
+    if (score<=max_distance) {
+      if (score < min_score) min_score = score;
+    } else if (quick_abandon) {
+      if (min_score==INT_MAX && score > text_left+max_distance) return INT_MAX;
+    }
+  }
+  return min_score;
+}
+int BPM_KERNEL(edit_bpm_distance_compute_cutoff_w2)(
+    bpm_pattern_t* const bpm_pattern,
+    BPM_TEXT_T text,
+    const int text_length,
+    const int max_distance,
+    const bool quick_abandon) {
+  const uint64_t* const PEQ = bpm_pattern->PEQ;
+  const uint64_t mask0 = bpm_pattern->level_mask[0];
+  const uint64_t mask1 = bpm_pattern->level_mask[1];
+  const int64_t init_score0 = bpm_pattern->init_score[0];
+  const int64_t init_score1 = bpm_pattern->init_score[1];
+  const int64_t pattern_left1 = bpm_pattern->pattern_left[1];
+  uint64_t Pv0 = BPM_W64_ONES, Mv0 = 0, Pv1 = BPM_W64_ONES, Mv1 = 0;
+  uint64_t PHout0, MHout0, PHout1, MHout1;
+  int64_t score0 = init_score0, score1 = 0;
+  // Second block only if the max distance reaches it (see bpm_reset_search_cutoff)
+  bool top_level2 = (max_distance > (int)BPM_W64_LENGTH);
+  if (top_level2) score1 = score0 + init_score1;
+  int min_score = INT_MAX;
+  int text_position, text_left=text_length;
+  for (text_position=0;text_position<text_length;++text_position,--text_left) {
+    const uint8_t enc_char = BPM_TEXT_ENC(text,text_position);
+    const uint64_t Eq0 = PEQ[BPM_PATTERN_PEQ_IDX(0,enc_char)];
+    const uint64_t Eq1 = PEQ[BPM_PATTERN_PEQ_IDX(1,enc_char)];
+    BPM_ADVANCE_BLOCK(Eq0,mask0,Pv0,Mv0,0,0,PHout0,MHout0);
+    score0 += PHout0-MHout0;
+    if (top_level2) {
+      BPM_ADVANCE_BLOCK(Eq1,mask1,Pv1,Mv1,PHout0,MHout0,PHout1,MHout1);
+      score1 += PHout1-MHout1;
+      // Cut-off
+      if (score1 > max_distance+init_score1) top_level2 = false;
+    } else {
+      // Cut-off (try to activate the second block)
+      const int64_t last_score = score0+(MHout0-PHout0);
+      if (score0<=max_distance+1 && last_score<=max_distance && (MHout0 || (Eq1 & 1))) {
+        Pv1 = BPM_W64_ONES;
+        Mv1 = 0;
+        BPM_ADVANCE_BLOCK(Eq1,mask1,Pv1,Mv1,PHout0,MHout0,PHout1,MHout1);
+        score1 = last_score + init_score1 + (PHout1-MHout1);
+        top_level2 = true;
+      }
+    }
+    // Check match
+    if (top_level2 && score1<=max_distance) {
+      if (score1 < min_score) min_score = score1;
+    } else if (quick_abandon) {
+      const int64_t current_score = (top_level2) ? score1 : score0+pattern_left1;
+      if (min_score==INT_MAX && current_score > text_left+max_distance) return INT_MAX;
+    }
+  }
+  return min_score;
+}
+/*
+ * BPM Distance Compute
+ */
+int BPM_KERNEL(edit_bpm_distance_compute)(
+    bpm_pattern_t* const bpm_pattern,
+    BPM_TEXT_T text,
+    const int text_length) {
+  // Pattern variables
+  const uint64_t* PEQ = bpm_pattern->PEQ;
+  const uint64_t num_words64 = bpm_pattern->pattern_num_words64;
+  uint64_t* const P = bpm_pattern->P;
+  uint64_t* const M = bpm_pattern->M;
+  const uint64_t* const level_mask = bpm_pattern->level_mask;
+  int64_t* const score = bpm_pattern->score;
+  const int64_t* const init_score = bpm_pattern->init_score;
+  // Specialized paths
+  if (num_words64 == 1) return BPM_KERNEL(edit_bpm_distance_compute_w1)(bpm_pattern,text,text_length);
+  if (num_words64 == 2) return BPM_KERNEL(edit_bpm_distance_compute_w2)(bpm_pattern,text,text_length);
+  // Initialize search
+  int min_score = INT_MAX;
+  bpm_reset_search(num_words64,P,M,score,init_score);
+  // Advance in DP-bit_encoded matrix
+  uint64_t text_position;
+  for (text_position=0;text_position<text_length;++text_position) {
+    // Fetch next character
+    const uint8_t enc_char = BPM_TEXT_ENC(text,text_position);
+    // Advance all blocks
+    int8_t carry;
+    uint64_t i;
+    for (i=0,carry=0;i<num_words64;++i) {
+      uint64_t* const Py = P+i;
+      uint64_t* const My = M+i;
+      carry = bpm_advance_block(PEQ[BPM_PATTERN_PEQ_IDX(i,enc_char)],level_mask[i],*Py,*My,carry+1,Py,My);
+      score[i] += carry;
+    }
+    // Check match
+    if (score[num_words64-1] < min_score) {
+      min_score = score[num_words64-1];
+    }
+  }
+  // Return results
+  return min_score;
+}
+int BPM_KERNEL(edit_bpm_distance_compute_cutoff)(
+    bpm_pattern_t* const bpm_pattern,
+    BPM_TEXT_T text,
+    const int text_length,
+    int max_distance,
+    const bool quick_abandon) {
+  // Pattern variables
+  const uint64_t* PEQ = bpm_pattern->PEQ;
+  const uint64_t num_words64 = bpm_pattern->pattern_num_words64;
+  uint64_t* const P = bpm_pattern->P;
+  uint64_t* const M = bpm_pattern->M;
+  const uint64_t* const level_mask = bpm_pattern->level_mask;
+  int64_t* const score = bpm_pattern->score;
+  const int64_t* const init_score = bpm_pattern->init_score;
+  const uint64_t* const pattern_left = bpm_pattern->pattern_left;
+  // Initialize search
+  if (max_distance >= bpm_pattern->pattern_length) {
+    max_distance = bpm_pattern->pattern_length-1; // Correct max-distance
+  }
+  if (num_words64 == 1) {
+    return BPM_KERNEL(edit_bpm_distance_compute_cutoff_w1)(bpm_pattern,text,text_length,max_distance,quick_abandon);
+  }
+  if (num_words64 == 2) {
+    return BPM_KERNEL(edit_bpm_distance_compute_cutoff_w2)(bpm_pattern,text,text_length,max_distance,quick_abandon);
+  }
+  const uint64_t max_distance__1 = max_distance+1;
+  const uint8_t top = num_words64-1;
+  uint8_t top_level;
+  int min_score = INT_MAX;
+  bpm_reset_search_cutoff(&top_level,P,M,score,init_score,max_distance);
+  // Advance in DP-bit_encoded matrix
+  uint64_t text_position, text_left=text_length;
+  for (text_position=0;text_position<text_length;++text_position,--text_left) {
+    // Fetch next character
+    const uint8_t enc_char = BPM_TEXT_ENC(text,text_position);
+    // Advance all blocks
+    uint64_t i,PHin=0,MHin=0,PHout,MHout;
+    for (i=0;i<top_level;++i) {
+      uint64_t Pv = P[i];
+      uint64_t Mv = M[i];
+      const uint64_t mask = level_mask[i];
+      const uint64_t Eq = PEQ[BPM_PATTERN_PEQ_IDX(i,enc_char)];
+      /* Compute Block */
+      BPM_ADVANCE_BLOCK(Eq,mask,Pv,Mv,PHin,MHin,PHout,MHout);
+      /* Save Block Pv,Mv */
+      P[i]=Pv;
+      M[i]=Mv;
+      /* Adjust score and swap propagate Hv */
+      score[i] += PHout-MHout;
+      PHin=PHout;
+      MHin=MHout;
+    }
+    // Cut-off
+    const uint8_t last = top_level-1;
+    if (score[last]<=max_distance__1 && last<top) {
+      const uint64_t last_score = score[last]+(MHin-PHin);
+      const uint64_t Peq = PEQ[BPM_PATTERN_PEQ_IDX(top_level,enc_char)];
+      if (last_score<=max_distance && (MHin || (Peq & 1))) {
+        // Init block V
+        uint64_t Pv = BPM_W64_ONES;
+        uint64_t Mv = 0;
+        const uint64_t mask = level_mask[top_level];
+        /* Compute Block */
+        BPM_ADVANCE_BLOCK(Peq,mask,Pv,Mv,PHin,MHin,PHout,MHout);
+        /* Save Block Pv,Mv */
+        P[top_level]=Pv;
+        M[top_level]=Mv;
+        /* Set score & increment the top level block */
+        score[top_level] = last_score + init_score[top_level] + (PHout-MHout);
+        ++top_level;
+      } else {
+        while (score[top_level-1] > (max_distance+init_score[top_level-1])) {
+          --top_level;
+        }
+      }
+    } else {
+      while (score[top_level-1] > (max_distance+init_score[top_level-1])) {
+        --top_level;
+      }
+    }
+    // Check match
+    const int64_t current_score = score[top_level-1];
+    if (top_level==num_words64 && current_score<=max_distance) {
+      if (current_score < min_score) min_score = current_score;
+    } else if (quick_abandon) {
+      // Quick abandon, if it doesn't match (bounded by best case scenario)
+      if (min_score==INT_MAX && current_score+pattern_left[top_level] > text_left+max_distance) return INT_MAX;
+    }
+  }
+  // Return results
+  return min_score;
+}
+/*
+ * BPM Distance Compute (banded)
+ *   Only the blocks that overlap the diagonal band are computed (the band of
+ *   edit_dp_distance_banded). Blocks entering the band start from the
+ *   boundary of the previous block (as the cut-off activation), and blocks
+ *   leaving it feed the next one with +1 horizontal deltas. Thus, every value
+ *   is the cost of an alignment (never below the edit distance), and the
+ *   distance is exact if it is within the bandwidth
+ */
+int BPM_KERNEL(edit_bpm_distance_compute_banded)(
+    bpm_pattern_t* const bpm_pattern,
+    BPM_TEXT_T text,
+    const int text_length,
+    const int bandwidth) {
+  // Pattern variables
+  const uint64_t* PEQ = bpm_pattern->PEQ;
+  const int64_t pattern_length = bpm_pattern->pattern_length;
+  const int64_t num_words64 = bpm_pattern->pattern_num_words64;
+  uint64_t* const P = bpm_pattern->P;
+  uint64_t* const M = bpm_pattern->M;
+  const uint64_t* const level_mask = bpm_pattern->level_mask;
+  int64_t* const score = bpm_pattern->score;
+  const int64_t* const init_score = bpm_pattern->init_score;
+  // Compute band limits (account for mandatory indels)
+  int64_t text_band = bandwidth + ((text_length>pattern_length) ? (text_length-pattern_length) : 0);
+  if (text_band > text_length) text_band = text_length;
+  int64_t pattern_band = bandwidth + ((pattern_length>text_length) ? (pattern_length-text_length) : 0);
+  if (pattern_band > pattern_length) pattern_band = pattern_length;
+  // Initialize search (blocks covering the band of the first column)
+  int64_t lo_block = 0;
+  int64_t hi_block = MIN(pattern_band,pattern_length-1)/BPM_W64_LENGTH;
+  bpm_reset_search(hi_block+1,P,M,score,init_score);
+  int min_score = INT_MAX;
+  // Advance in DP-bit_encoded matrix
+  int64_t text_position;
+  for (text_position=0;text_position<text_length;++text_position) {
+    // Band rows of the column [lo_row,hi_row] (0-based)
+    const int64_t lo_row = text_position - text_band;
+    const int64_t hi_row = MIN(text_position+pattern_band,pattern_length-1);
+    if (lo_row >= pattern_length) break; // Band past the pattern
+    if (lo_row > 0) lo_block = lo_row/BPM_W64_LENGTH;
+    // Enter the next block into the band (from the previous column)
+    if (hi_row/BPM_W64_LENGTH > hi_block) {
+      ++hi_block;
+      P[hi_block] = BPM_W64_ONES;
+      M[hi_block] = 0;
+      score[hi_block] = score[hi_block-1] + init_score[hi_block];
+    }
+    // Fetch next character
+    const uint8_t enc_char = BPM_TEXT_ENC(text,text_position);
+    // Advance the blocks of the band (blocks above feed +1 deltas)
+    uint64_t PHin = (lo_block>0) ? 1 : 0, MHin = 0, PHout, MHout;
+    int64_t i;
+    for (i=lo_block;i<=hi_block;++i) {
+      uint64_t Pv = P[i];
+      uint64_t Mv = M[i];
+      const uint64_t Eq = PEQ[BPM_PATTERN_PEQ_IDX(i,enc_char)];
+      BPM_ADVANCE_BLOCK(Eq,level_mask[i],Pv,Mv,PHin,MHin,PHout,MHout);
+      P[i] = Pv;
+      M[i] = Mv;
+      score[i] += PHout-MHout;
+      PHin = PHout;
+      MHin = MHout;
+    }
+    // Check match
+    if (hi_block == num_words64-1 && score[hi_block] < min_score) {
+      min_score = score[hi_block];
+    }
+  }
+  // Return results
+  return min_score;
+}
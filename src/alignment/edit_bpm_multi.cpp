@@ -0,0 +1,253 @@
+/*
+ *  Wavefront Alignments Algorithms
+ *  Copyright (c) 2020 by Santiago Marco-Sola  <santiagomsola@gmail.com>
+ *
+ *  This file is part of Wavefront Alignments Algorithms.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * PROJECT: Wavefront Alignments Algorithms
+ * AUTHOR(S): Santiago Marco-Sola <santiagomsola@gmail.com>
+ * DESCRIPTION: Multi-pattern BPM (pattern packing)
+ */
+
+#include "edit_bpm_multi.h"
+#include "../utils/dna_text.h"
+
+/*
+ * Constants
+ */
+#define BPM_W64_LENGTH       UINT64_LENGTH
+#define BPM_W64_SIZE         UINT64_SIZE
+#define BPM_W64_ONES         UINT64_MAX
+#define BPM_ALPHABET_LENGTH  (5)
+
+/*
+ * Pattern Accessors
+ */
+#define BPM_PATTERN_PEQ_IDX(word_pos,encoded_character)   ((word_pos*BPM_ALPHABET_LENGTH)+(encoded_character))
+
+/*
+ * Setup
+ */
+void edit_bpm_multi_pattern_allocate(
+    bpm_multi_pattern_t* const bpm_multi_pattern,
+    const int* const pattern_lengths,
+    const int num_patterns,
+    const bool reuse,
+    mm_allocator_t* const mm_allocator) {
+  // Calculate dimensions
+  uint64_t total_length = 0;
+  int i;
+  for (i=0;i<num_patterns;++i) total_length += pattern_lengths[i];
+  const uint64_t num_words64 = DIV_CEIL(total_length,BPM_W64_LENGTH);
+  bpm_multi_pattern->num_words64 = num_words64;
+  bpm_multi_pattern->num_patterns = num_patterns;
+  // Allocate memory (or reuse it, if large enough)
+  const uint64_t aux_vector_size = num_words64*BPM_W64_SIZE;
+  const uint64_t PEQ_size = BPM_ALPHABET_LENGTH*aux_vector_size;
+  void* memory;
+  if (reuse &&
+      num_words64 <= bpm_multi_pattern->num_words64_allocated &&
+      num_patterns <= bpm_multi_pattern->num_patterns_allocated) {
+    memory = bpm_multi_pattern->PEQ;
+  } else {
+    if (reuse) mm_allocator_free(mm_allocator,bpm_multi_pattern->PEQ);
+    const uint64_t words_allocated = MAX(num_words64,bpm_multi_pattern->num_words64_allocated);
+    const int patterns_allocated = MAX(num_patterns,bpm_multi_pattern->num_patterns_allocated);
+    const uint64_t total_memory =
+        (BPM_ALPHABET_LENGTH+4)*words_allocated*BPM_W64_SIZE +
+        patterns_allocated*(sizeof(int64_t)+sizeof(int)+sizeof(uint8_t)) +
+        words_allocated*sizeof(int);
+    memory = mm_allocator_malloc(mm_allocator,total_memory);
+    bpm_multi_pattern->num_words64_allocated = words_allocated;
+    bpm_multi_pattern->num_patterns_allocated = patterns_allocated;
+  }
+  const uint64_t words_allocated = bpm_multi_pattern->num_words64_allocated;
+  const int patterns_allocated = bpm_multi_pattern->num_patterns_allocated;
+  bpm_multi_pattern->PEQ = (uint64_t*)memory;
+  memory += BPM_ALPHABET_LENGTH*words_allocated*BPM_W64_SIZE;
+  bpm_multi_pattern->first_mask = (uint64_t*)memory;
+  memory += words_allocated*BPM_W64_SIZE;
+  bpm_multi_pattern->last_mask = (uint64_t*)memory;
+  memory += words_allocated*BPM_W64_SIZE;
+  bpm_multi_pattern->P = (uint64_t*)memory;
+  memory += words_allocated*BPM_W64_SIZE;
+  bpm_multi_pattern->M = (uint64_t*)memory;
+  memory += words_allocated*BPM_W64_SIZE;
+  bpm_multi_pattern->score = (int64_t*)memory;
+  memory += patterns_allocated*sizeof(int64_t);
+  bpm_multi_pattern->pattern_length = (int*)memory;
+  memory += patterns_allocated*sizeof(int);
+  bpm_multi_pattern->word_patterns_end = (int*)memory;
+  memory += words_allocated*sizeof(int);
+  bpm_multi_pattern->pattern_last_bit = (uint8_t*)memory;
+  // Clear PEQ and masks
+  memset(bpm_multi_pattern->PEQ,0,PEQ_size);
+  memset(bpm_multi_pattern->first_mask,0,aux_vector_size);
+  memset(bpm_multi_pattern->last_mask,0,aux_vector_size);
+}
+void edit_bpm_multi_pattern_init(
+    bpm_multi_pattern_t* const bpm_multi_pattern,
+    char** const patterns,
+    const int* const pattern_lengths) {
+  // Parameters
+  const int num_patterns = bpm_multi_pattern->num_patterns;
+  uint64_t* const PEQ = bpm_multi_pattern->PEQ;
+  // Pack the patterns
+  uint64_t position = 0;
+  int pattern, i;
+  for (pattern=0;pattern<num_patterns;++pattern) {
+    char* const pattern_chars = patterns[pattern];
+    const int pattern_length = pattern_lengths[pattern];
+    for (i=0;i<pattern_length;++i,++position) {
+      const uint8_t enc_char = dna_encode(pattern_chars[i]);
+      if (enc_char==ENC_DNA_CHAR_N) continue; // N's Inequality
+      const uint64_t block = position/BPM_W64_LENGTH;
+      const uint64_t mask = 1ull<<(position%BPM_W64_LENGTH);
+      PEQ[BPM_PATTERN_PEQ_IDX(block,enc_char)] |= mask;
+    }
+    // Boundaries
+    const uint64_t first = position-pattern_length, last = position-1;
+    bpm_multi_pattern->first_mask[first/BPM_W64_LENGTH] |= 1ull<<(first%BPM_W64_LENGTH);
+    bpm_multi_pattern->last_mask[last/BPM_W64_LENGTH] |= 1ull<<(last%BPM_W64_LENGTH);
+    bpm_multi_pattern->pattern_length[pattern] = pattern_length;
+    bpm_multi_pattern->pattern_last_bit[pattern] = last%BPM_W64_LENGTH;
+  }
+  // Patterns ending in every word
+  const uint64_t num_words64 = bpm_multi_pattern->num_words64;
+  uint64_t block;
+  for (block=0,pattern=0,position=0;block<num_words64;++block) {
+    while (pattern < num_patterns && position+pattern_lengths[pattern] <= (block+1)*BPM_W64_LENGTH) {
+      position += pattern_lengths[pattern++];
+    }
+    bpm_multi_pattern->word_patterns_end[block] = pattern;
+  }
+}
+void edit_bpm_multi_pattern_compile(
+    bpm_multi_pattern_t* const bpm_multi_pattern,
+    char** const patterns,
+    const int* const pattern_lengths,
+    const int num_patterns,
+    mm_allocator_t* const mm_allocator) {
+  bpm_multi_pattern->num_words64_allocated = 0;
+  bpm_multi_pattern->num_patterns_allocated = 0;
+  edit_bpm_multi_pattern_allocate(bpm_multi_pattern,pattern_lengths,num_patterns,false,mm_allocator);
+  edit_bpm_multi_pattern_init(bpm_multi_pattern,patterns,pattern_lengths);
+}
+void edit_bpm_multi_pattern_recompile(
+    bpm_multi_pattern_t* const bpm_multi_pattern,
+    char** const patterns,
+    const int* const pattern_lengths,
+    const int num_patterns,
+    mm_allocator_t* const mm_allocator) {
+  edit_bpm_multi_pattern_allocate(bpm_multi_pattern,pattern_lengths,num_patterns,true,mm_allocator);
+  edit_bpm_multi_pattern_init(bpm_multi_pattern,patterns,pattern_lengths);
+}
+void edit_bpm_multi_pattern_free(
+    bpm_multi_pattern_t* const bpm_multi_pattern,
+    mm_allocator_t* const mm_allocator) {
+  mm_allocator_free(mm_allocator,bpm_multi_pattern->PEQ);
+}
+/*
+ * Advance block (cutting the carry and the Hout at the pattern boundaries)
+ *   const @vector Eq,first,last;
+ *   BPM_MULTI_ADVANCE_BLOCK_HOUT computes the Hout (Ph,Mh) and the scores of
+ *   the patterns ending in the block; the Hout of the last bit can be taken
+ *   then (the Hin of the next block). BPM_MULTI_ADVANCE_BLOCK_VOUT returns (Pv,Mv)
+ */
+#define BPM_MULTI_ADVANCE_BLOCK_HOUT(Eq,first,last,Pv,Mv,MHin,pattern,patterns_end) \
+  /* Computes modulator vector {Xv,Xh} (no carry out of the last base of a pattern) */ \
+  const uint64_t Xv = Eq | Mv; \
+  const uint64_t _Eq = Eq | (MHin & ~first); /* No Hin at the first base of a pattern */ \
+  const uint64_t X = _Eq & Pv; \
+  const uint64_t sum = ((X & ~last) + (Pv & ~last)) ^ ((X ^ Pv) & last); \
+  const uint64_t Xh = (sum ^ Pv) | _Eq; \
+  /* Calculate Hout */ \
+  uint64_t Ph = Mv | ~(Xh | Pv); \
+  uint64_t Mh = Pv & Xh; \
+  /* Account Hout of the patterns ending in this block */ \
+  for (;pattern<patterns_end;++pattern) { \
+    const int bit = pattern_last_bit[pattern]; \
+    score[pattern] += (int64_t)((Ph >> bit) & 1) - (int64_t)((Mh >> bit) & 1); \
+    if (score[pattern] < distances[pattern]) distances[pattern] = score[pattern]; \
+  }
+#define BPM_MULTI_ADVANCE_BLOCK_VOUT(first,Pv,Mv,PHin,MHin) \
+  /* Hout become the Hin of the next cell (not across patterns) */ \
+  Ph = ((Ph << 1) | PHin) & ~first; \
+  Mh = ((Mh << 1) | MHin) & ~first; \
+  /* Finally, generate the Vout */ \
+  Pv = Mh | ~(Xv | Ph); \
+  Mv = Ph & Xv
+/*
+ * BPM Distance Compute (all the patterns)
+ */
+void edit_bpm_multi_distance_compute(
+    bpm_multi_pattern_t* const bpm_multi_pattern,
+    char* const text,
+    const int text_length,
+    int* const distances) {
+  // Parameters
+  const uint64_t* const PEQ = bpm_multi_pattern->PEQ;
+  const uint64_t* const first_mask = bpm_multi_pattern->first_mask;
+  const uint64_t* const last_mask = bpm_multi_pattern->last_mask;
+  const uint8_t* const pattern_last_bit = bpm_multi_pattern->pattern_last_bit;
+  const int* const word_patterns_end = bpm_multi_pattern->word_patterns_end;
+  const uint64_t num_words64 = bpm_multi_pattern->num_words64;
+  const int num_patterns = bpm_multi_pattern->num_patterns;
+  uint64_t* const P = bpm_multi_pattern->P;
+  uint64_t* const M = bpm_multi_pattern->M;
+  int64_t* const score = bpm_multi_pattern->score;
+  // Reset search
+  uint64_t block;
+  int pattern;
+  for (block=0;block<num_words64;++block) {
+    P[block] = BPM_W64_ONES;
+    M[block] = 0;
+  }
+  for (pattern=0;pattern<num_patterns;++pattern) {
+    score[pattern] = bpm_multi_pattern->pattern_length[pattern];
+    distances[pattern] = INT_MAX;
+  }
+  // Advance in DP-bit_encoded matrix
+  int text_position;
+  if (num_words64 == 1) { // State kept in registers
+    const uint64_t first = first_mask[0], last = last_mask[0];
+    uint64_t Pv = BPM_W64_ONES, Mv = 0;
+    for (text_position=0;text_position<text_length;++text_position) {
+      const uint64_t Eq = PEQ[BPM_PATTERN_PEQ_IDX(0,dna_encode(text[text_position]))];
+      pattern = 0;
+      BPM_MULTI_ADVANCE_BLOCK_HOUT(Eq,first,last,Pv,Mv,0,pattern,num_patterns);
+      BPM_MULTI_ADVANCE_BLOCK_VOUT(first,Pv,Mv,0,0);
+    }
+    return;
+  }
+  for (text_position=0;text_position<text_length;++text_position) {
+    const uint8_t enc_char = dna_encode(text[text_position]);
+    uint64_t PHin = 0, MHin = 0;
+    for (block=0,pattern=0;block<num_words64;++block) {
+      const uint64_t Eq = PEQ[BPM_PATTERN_PEQ_IDX(block,enc_char)];
+      const uint64_t first = first_mask[block];
+      uint64_t Pv = P[block], Mv = M[block];
+      BPM_MULTI_ADVANCE_BLOCK_HOUT(Eq,first,last_mask[block],Pv,Mv,MHin,pattern,word_patterns_end[block]);
+      const uint64_t PHout = Ph >> (BPM_W64_LENGTH-1);
+      const uint64_t MHout = Mh >> (BPM_W64_LENGTH-1);
+      BPM_MULTI_ADVANCE_BLOCK_VOUT(first,Pv,Mv,PHin,MHin);
+      P[block] = Pv;
+      M[block] = Mv;
+      PHin = PHout;
+      MHin = MHout;
+    }
+  }
+}
@@ -0,0 +1,86 @@
+/*
+ *  Wavefront Alignments Algorithms
+ *  Copyright (c) 2020 by Santiago Marco-Sola  <santiagomsola@gmail.com>
+ *
+ *  This file is part of Wavefront Alignments Algorithms.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * PROJECT: Wavefront Alignments Algorithms
+ * AUTHOR(S): Santiago Marco-Sola <santiagomsola@gmail.com>
+ * DESCRIPTION: Multi-pattern BPM (pattern packing). Several patterns are
+ *   concatenated into the bits of shared 64-bit words (a pattern can span
+ *   words) and a text is scanned once to compute the distance of every
+ *   pattern. The carry of the addition and the shifted Hout are cut at the
+ *   pattern boundaries, so every pattern is computed as on its own (the
+ *   distances are the ones of edit_bpm_distance_compute())
+ */
+
+#ifndef EDIT_BPM_MULTI_H_
+#define EDIT_BPM_MULTI_H_
+
+#include "../utils/commons.h"
+#include "../system/mm_allocator.h"
+
+/*
+ * BPM Multi-Pattern
+ */
+typedef struct {
+  /* Packed patterns (bases of all the patterns, one after the other) */
+  uint64_t* PEQ;                // Pattern equalities (Bit vector for Myers-DP)
+  uint64_t* first_mask;         // First base of every pattern (no Hin)
+  uint64_t* last_mask;          // Last base of every pattern (no carry out; Hout)
+  uint64_t num_words64;         // ceil(Sum of the lengths / |w|)
+  /* Patterns */
+  int num_patterns;
+  int* pattern_length;
+  uint8_t* pattern_last_bit;    // Position of the last base in its word
+  int* word_patterns_end;       // Patterns ending up to every word
+  /* BPM Auxiliary data */
+  uint64_t* P;
+  uint64_t* M;
+  int64_t* score;
+  uint64_t num_words64_allocated; // Capacity (reused on recompilation)
+  int num_patterns_allocated;
+} bpm_multi_pattern_t;
+
+/*
+ * Setup (patterns of 1 base at least)
+ */
+void edit_bpm_multi_pattern_compile(
+    bpm_multi_pattern_t* const bpm_multi_pattern,
+    char** const patterns,
+    const int* const pattern_lengths,
+    const int num_patterns,
+    mm_allocator_t* const mm_allocator);
+void edit_bpm_multi_pattern_recompile(
+    bpm_multi_pattern_t* const bpm_multi_pattern,
+    char** const patterns,
+    const int* const pattern_lengths,
+    const int num_patterns,
+    mm_allocator_t* const mm_allocator);
+void edit_bpm_multi_pattern_free(
+    bpm_multi_pattern_t* const bpm_multi_pattern,
+    mm_allocator_t* const mm_allocator);
+
+/*
+ * Edit distance computation using BPM (one distance per pattern)
+ */
+void edit_bpm_multi_distance_compute(
+    bpm_multi_pattern_t* const bpm_multi_pattern,
+    char* const text,
+    const int text_length,
+    int* const distances);
+
+#endif /* EDIT_BPM_MULTI_H_ */
@@ -32,17 +32,67 @@ void edit_column_allocate(
     const int pattern_length,
     const int text_length,
     mm_allocator_t* const mm_allocator) {
-  // Allocate DP table
-  edit_column->num_rows = pattern_length + 1;
-  const int num_columns = text_length + 1;
-  edit_column->num_columns = num_columns;
-  edit_column->column_curr = mm_allocator_calloc(mm_allocator,pattern_length+1,int,false);
-  edit_column->column_prev = mm_allocator_calloc(mm_allocator,pattern_length+1,int,false);
+  edit_column_init(edit_column);
+  edit_column_resize(edit_column,pattern_length,text_length,mm_allocator);
 }
 void edit_column_free(
     edit_column_t* const edit_column,
     mm_allocator_t* const mm_allocator) {
-  mm_allocator_free(mm_allocator,edit_column->column_curr);
-  mm_allocator_free(mm_allocator,edit_column->column_prev);
+  if (edit_column->memory != NULL) {
+    mm_allocator_free(mm_allocator,edit_column->memory);
+  }
+  edit_column_init(edit_column);
+}
+/*
+ * Workspace
+ */
+void edit_column_init(
+    edit_column_t* const edit_column) {
+  edit_column->num_rows = 0;
+  edit_column->num_columns = 0;
+  edit_column->column_curr = NULL;
+  edit_column->column_prev = NULL;
+  edit_column->column16_curr = NULL;
+  edit_column->column16_prev = NULL;
+  edit_column->memory = NULL;
+  edit_column->memory_allocated = 0;
+}
+void* edit_column_reserve(
+    edit_column_t* const edit_column,
+    const uint64_t size,
+    mm_allocator_t* const mm_allocator) {
+  // Grow (the contents are not kept)
+  if (size > edit_column->memory_allocated) {
+    if (edit_column->memory != NULL) {
+      mm_allocator_free(mm_allocator,edit_column->memory);
+    }
+    edit_column->memory_allocated = MAX(size,edit_column->memory_allocated+edit_column->memory_allocated/2);
+    edit_column->memory = mm_allocator_malloc(mm_allocator,edit_column->memory_allocated);
+  }
+  return edit_column->memory;
+}
+void edit_column_resize(
+    edit_column_t* const edit_column,
+    const int pattern_length,
+    const int text_length,
+    mm_allocator_t* const mm_allocator) {
+  // Dimensions
+  const int num_rows = pattern_length + 1;
+  edit_column->num_rows = num_rows;
+  edit_column->num_columns = text_length + 1;
+  // Allocate DP columns (by cell size)
+  if (pattern_length <= EDIT_COLUMN_MAX_LENGTH_16) {
+    int16_t* const memory = (int16_t*) edit_column_reserve(edit_column,2*num_rows*sizeof(int16_t),mm_allocator);
+    edit_column->column16_curr = memory;
+    edit_column->column16_prev = memory + num_rows;
+    edit_column->column_curr = NULL;
+    edit_column->column_prev = NULL;
+  } else {
+    int* const memory = (int*) edit_column_reserve(edit_column,2*num_rows*sizeof(int),mm_allocator);
+    edit_column->column_curr = memory;
+    edit_column->column_prev = memory + num_rows;
+    edit_column->column16_curr = NULL;
+    edit_column->column16_prev = NULL;
+  }
 }
 
@@ -19,7 +19,9 @@
  *
  * PROJECT: Wavefront Alignments Algorithms
  * AUTHOR(S): Santiago Marco-Sola <santiagomsola@gmail.com>
- * DESCRIPTION: Dynamic-programming alignment table
+ * DESCRIPTION: Dynamic-programming alignment table. Its memory can be kept
+ *   across alignments (workspace) and only grows. Cells are of 16 bits when the
+ *   scores fit them (patterns up to EDIT_COLUMN_MAX_LENGTH_16), else of 32 bits
  */
 
 #ifndef EDIT_COLUMN_H_
@@ -32,6 +34,7 @@
  * Constants
  */
 #define SCORE_MAX (10000000)
+#define EDIT_COLUMN_MAX_LENGTH_16 (INT16_MAX-1) // Scores below the out-of-band INT16_MAX
 
 /*
  * DP Table
@@ -40,9 +43,15 @@ typedef struct {
   // Dimensions
   int num_rows;
   int num_columns;
-  // DP Columns (current and previous)
+  // DP Columns (current and previous; cells of 32 bits)
   int* column_curr;
   int* column_prev;
+  // DP Columns (current and previous; cells of 16 bits, NULL if not used)
+  int16_t* column16_curr;
+  int16_t* column16_prev;
+  // Memory
+  void* memory;
+  uint64_t memory_allocated;
 } edit_column_t;
 
 /*
@@ -57,4 +66,19 @@ void edit_column_free(
     edit_column_t* const edit_column,
     mm_allocator_t* const mm_allocator);
 
+/*
+ * Workspace (edit_column_init() once, then resized for every alignment)
+ */
+void edit_column_init(
+    edit_column_t* const edit_column);
+void edit_column_resize(
+    edit_column_t* const edit_column,
+    const int pattern_length,
+    const int text_length,
+    mm_allocator_t* const mm_allocator);
+void* edit_column_reserve(
+    edit_column_t* const edit_column,
+    const uint64_t size,
+    mm_allocator_t* const mm_allocator);
+
 #endif /* EDIT_COLUMN_H_ */
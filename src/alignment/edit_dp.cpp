@@ -24,6 +24,26 @@
 
 #include "edit_dp.h"
 
+/*
+ * DP kernels (cells of 32 bits)
+ */
+#define EDIT_DP_KERNEL(name)  name##_c32
+#define EDIT_DP_CELL_T        int
+#define EDIT_DP_CELL(value)   (value)
+#include "edit_dp_kernel.h"
+#undef EDIT_DP_KERNEL
+#undef EDIT_DP_CELL_T
+#undef EDIT_DP_CELL
+/*
+ * DP kernels (cells of 16 bits; out-of-band scores saturate at INT16_MAX)
+ */
+#define EDIT_DP_KERNEL(name)  name##_c16
+#define EDIT_DP_CELL_T        int16_t
+#define EDIT_DP_CELL(value)   MIN(value,INT16_MAX)
+#include "edit_dp_kernel.h"
+#undef EDIT_DP_KERNEL
+#undef EDIT_DP_CELL_T
+#undef EDIT_DP_CELL
 /*
  * Edit distance computation [Ends-free] [DP-Columns]
  */
@@ -33,29 +53,13 @@ int edit_dp_distance(
     const int pattern_length,
     const char* const text,
     const int text_length) {
-  // Parameters
-  int* column_curr = edit_column->column_curr;
-  int* column_prev = edit_column->column_prev;
-  int h, v, min_distance = INT_MAX;
-  // Initialize
-  column_curr[0] = 0; // [Ends-free]
-  for (v=0;v<=pattern_length;++v) column_prev[v] = v;
-  // Compute DP
-  for (h=1;h<=text_length;++h) {
-    for (v=1;v<=pattern_length;++v) {
-      int min = column_prev[v-1] + (text[h-1]!=pattern[v-1]);
-      min = MIN(min,column_prev[v]+1); // Ins
-      min = MIN(min,column_curr[v-1]+1); // Del
-      column_curr[v] = min;
-    }
-    // Check min distance
-    const int new_min_distance = column_curr[pattern_length];
-    if (new_min_distance < min_distance) min_distance = new_min_distance;
-    // Swap
-    SWAP(column_curr,column_prev);
+  if (edit_column->column16_curr != NULL) {
+    return edit_dp_distance_c16(edit_column->column16_curr,edit_column->column16_prev,
+        pattern,pattern_length,text,text_length);
+  } else {
+    return edit_dp_distance_c32(edit_column->column_curr,edit_column->column_prev,
+        pattern,pattern_length,text,text_length);
   }
-  // Return distance
-  return min_distance;
 }
 /*
  * Edit distance computation using raw DP-Table (banded)
@@ -67,46 +71,29 @@ int edit_dp_distance_banded(
     const char* const text,
     const int text_length,
     const int bandwidth) {
-  // Parameters
-  int* column_curr = edit_column->column_curr;
-  int* column_prev = edit_column->column_prev;
-  int h, v, min_distance = INT_MAX;
-  // Compute band limits (account for mandatory indels)
-  int text_band_init = bandwidth + ((text_length>pattern_length) ? (text_length-pattern_length) : 0);
-  if (text_band_init > text_length) text_band_init = text_length;
-  int pattern_band_init = bandwidth + ((pattern_length>text_length) ? (pattern_length-text_length) : 0);
-  if (pattern_band_init > pattern_length) pattern_band_init = pattern_length;
-  // Initialize [Text Ends-free]
-  column_curr[0] = 0;
-  for (v=0;v<=pattern_band_init;++v) column_prev[v] = v;
-  // Compute DP
-  int lo_band = 1;
-  int hi_band = pattern_band_init;
-  for (h=1;h<=text_length;++h) {
-    // Compute band limits
-    if (h > text_band_init) {
-      column_curr[lo_band] = INT16_MAX; // Init corner case
-      ++lo_band;
-    }
-    if (hi_band < pattern_length) {
-      ++hi_band;
-      column_prev[hi_band] = INT16_MAX; // Init corner case
-    }
-    // Compute column
-    for (v=lo_band;v<=hi_band;++v) {
-      int min = column_prev[v-1] + (text[h-1]!=pattern[v-1]);
-      min = MIN(min,column_prev[v]+1); // Ins
-      min = MIN(min,column_curr[v-1]+1); // Del
-      column_curr[v] = min;
-    }
-    // Check min distance
-    if (hi_band == pattern_length) {
-      const int new_min_distance = column_curr[pattern_length];
-      if (new_min_distance < min_distance) min_distance = new_min_distance;
-    }
-    // Swap
-    SWAP(column_curr,column_prev);
+  if (edit_column->column16_curr != NULL) {
+    return edit_dp_distance_banded_c16(edit_column->column16_curr,edit_column->column16_prev,
+        pattern,pattern_length,text,text_length,bandwidth);
+  } else {
+    return edit_dp_distance_banded_c32(edit_column->column_curr,edit_column->column_prev,
+        pattern,pattern_length,text,text_length,bandwidth);
+  }
+}
+/*
+ * Edit distance computation [Ends-free] [DP-Columns] [Cut-off]
+ */
+int edit_dp_distance_cutoff(
+    edit_column_t* const edit_column,
+    const char* const pattern,
+    const int pattern_length,
+    const char* const text,
+    const int text_length,
+    const int max_distance) {
+  if (edit_column->column16_curr != NULL) {
+    return edit_dp_distance_cutoff_c16(edit_column->column16_curr,edit_column->column16_prev,
+        pattern,pattern_length,text,text_length,max_distance);
+  } else {
+    return edit_dp_distance_cutoff_c32(edit_column->column_curr,edit_column->column_prev,
+        pattern,pattern_length,text,text_length,max_distance);
   }
-  // Return distance
-  return min_distance;
 }
@@ -47,5 +47,16 @@ int edit_dp_distance_banded(
     const char* const text,
     const int text_length,
     const int bandwidth);
+/*
+ * Edit distance computation [Ends-free] [DP-Columns] [Cut-off]
+ *   Returns INT_MAX if the distance is above @max_distance
+ */
+int edit_dp_distance_cutoff(
+    edit_column_t* const edit_column,
+    const char* const pattern,
+    const int pattern_length,
+    const char* const text,
+    const int text_length,
+    const int max_distance);
 
 #endif /* EDIT_DP_H_ */
@@ -0,0 +1,173 @@
+/*
+ *  Wavefront Alignments Algorithms
+ *  Copyright (c) 2020 by Santiago Marco-Sola  <santiagomsola@gmail.com>
+ *
+ *  This file is part of Wavefront Alignments Algorithms.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * PROJECT: Wavefront Alignments Algorithms
+ * AUTHOR(S): Santiago Marco-Sola <santiagomsola@gmail.com>
+ * DESCRIPTION: DP kernels. Instantiated by edit_dp.cpp for every cell size
+ *   (no include guard), defining
+ *     EDIT_DP_KERNEL(name)        Function name
+ *     EDIT_DP_CELL_T              Cell type
+ *     EDIT_DP_CELL(value)         Value stored in a cell
+ */
+
+/*
+ * Edit distance computation [Ends-free] [DP-Columns]
+ */
+int EDIT_DP_KERNEL(edit_dp_distance)(
+    EDIT_DP_CELL_T* column_curr,
+    EDIT_DP_CELL_T* column_prev,
+    const char* const pattern,
+    const int pattern_length,
+    const char* const text,
+    const int text_length) {
+  int h, v, min_distance = INT_MAX;
+  // Initialize
+  column_curr[0] = 0; // [Ends-free]
+  for (v=0;v<=pattern_length;++v) column_prev[v] = v;
+  // Compute DP
+  for (h=1;h<=text_length;++h) {
+    int above = column_curr[0]; // Carried in a register (of any cell size)
+    for (v=1;v<=pattern_length;++v) {
+      int min = column_prev[v-1] + (text[h-1]!=pattern[v-1]);
+      min = MIN(min,column_prev[v]+1); // Ins
+      above = MIN(min,above+1); // Del
+      column_curr[v] = above;
+    }
+    // Check min distance
+    const int new_min_distance = column_curr[pattern_length];
+    if (new_min_distance < min_distance) min_distance = new_min_distance;
+    // Swap
+    SWAP(column_curr,column_prev);
+  }
+  // Return distance
+  return min_distance;
+}
+/*
+ * Edit distance computation using raw DP-Table (banded)
+ */
+int EDIT_DP_KERNEL(edit_dp_distance_banded)(
+    EDIT_DP_CELL_T* column_curr,
+    EDIT_DP_CELL_T* column_prev,
+    const char* const pattern,
+    const int pattern_length,
+    const char* const text,
+    const int text_length,
+    const int bandwidth) {
+  int h, v, min_distance = INT_MAX;
+  // Compute band limits (account for mandatory indels)
+  int text_band_init = bandwidth + ((text_length>pattern_length) ? (text_length-pattern_length) : 0);
+  if (text_band_init > text_length) text_band_init = text_length;
+  int pattern_band_init = bandwidth + ((pattern_length>text_length) ? (pattern_length-text_length) : 0);
+  if (pattern_band_init > pattern_length) pattern_band_init = pattern_length;
+  // Initialize [Text Ends-free]
+  column_curr[0] = 0;
+  for (v=0;v<=pattern_band_init;++v) column_prev[v] = v;
+  // Compute DP
+  int lo_band = 1;
+  int hi_band = pattern_band_init;
+  for (h=1;h<=text_length;++h) {
+    // Compute band limits
+    if (h > text_band_init) {
+      column_curr[lo_band] = INT16_MAX; // Init corner case
+      ++lo_band;
+    }
+    if (hi_band < pattern_length) {
+      ++hi_band;
+      column_prev[hi_band] = INT16_MAX; // Init corner case
+    }
+    // Compute column
+    int above = column_curr[lo_band-1]; // Carried in a register (of any cell size)
+    for (v=lo_band;v<=hi_band;++v) {
+      int min = column_prev[v-1] + (text[h-1]!=pattern[v-1]);
+      min = MIN(min,column_prev[v]+1); // Ins
+      above = EDIT_DP_CELL(MIN(min,above+1)); // Del
+      column_curr[v] = above;
+    }
+    // Check min distance
+    if (hi_band == pattern_length) {
+      const int new_min_distance = column_curr[pattern_length];
+      if (new_min_distance < min_distance) min_distance = new_min_distance;
+    }
+    // Swap
+    SWAP(column_curr,column_prev);
+  }
+  // Return distance
+  return min_distance;
+}
+/*
+ * Edit distance computation [Ends-free] [DP-Columns] [Cut-off]
+ *   Only the rows that can still end within max_distance are computed: up
+ *   to one past the last active row (Ukkonen's cut-off), and from the first
+ *   row that can reach the last one with the text left. Stops once no cell
+ *   of the column can improve the best score found
+ */
+int EDIT_DP_KERNEL(edit_dp_distance_cutoff)(
+    EDIT_DP_CELL_T* column_curr,
+    EDIT_DP_CELL_T* column_prev,
+    const char* const pattern,
+    const int pattern_length,
+    const char* const text,
+    const int text_length,
+    const int max_distance) {
+  int h, v, min_distance = INT_MAX;
+  // Initialize
+  int last_active = MIN(max_distance,pattern_length);
+  for (v=0;v<=last_active;++v) column_prev[v] = v;
+  column_curr[0] = 0; // [Ends-free]
+  // Compute DP
+  for (h=1;h<=text_length;++h) {
+    // Compute rows (the cells out of them are above max_distance)
+    const int text_left = text_length-h;
+    const int lo_row = MAX(1,pattern_length-text_left-max_distance);
+    const int hi_row = MIN(last_active+1,pattern_length);
+    if (last_active < pattern_length) column_prev[last_active+1] = max_distance+1;
+    // Compute column
+    int above = (lo_row == 1) ? column_curr[0] : max_distance+1;
+    for (v=lo_row;v<=hi_row;++v) {
+      int min = column_prev[v-1] + (text[h-1]!=pattern[v-1]);
+      min = MIN(min,column_prev[v]+1); // Ins
+      above = MIN(min,above+1); // Del
+      column_curr[v] = above;
+    }
+    // Update the last active row
+    last_active = hi_row;
+    while (last_active >= lo_row && column_curr[last_active] > max_distance) --last_active;
+    if (last_active < lo_row) {
+      if (lo_row > 1) break; // No active cell (nor new starts) left
+      last_active = 0;
+    }
+    // Check min distance
+    if (last_active == pattern_length) {
+      const int new_min_distance = column_curr[pattern_length];
+      if (new_min_distance < min_distance) min_distance = new_min_distance;
+      if (min_distance == 0) break;
+    }
+    // Early termination (the last row is at least pattern_length-v-text_left away)
+    const int max_score = MIN(max_distance,min_distance-1);
+    if (pattern_length-text_left > max_score) {
+      int min_bound = (lo_row == 1) ? 0 : max_distance+1; // Row 0 (new starts)
+      for (v=lo_row;v<=last_active;++v) min_bound = MIN(min_bound,column_curr[v]-v);
+      if (min_bound+pattern_length-text_left > max_score) break;
+    }
+    // Swap
+    SWAP(column_curr,column_prev);
+  }
+  // Return distance
+  return (min_distance <= max_distance) ? min_distance : INT_MAX;
+}
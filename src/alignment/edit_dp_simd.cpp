@@ -0,0 +1,214 @@
+/*
+ *  Wavefront Alignments Algorithms
+ *  Copyright (c) 2020 by Santiago Marco-Sola  <santiagomsola@gmail.com>
+ *
+ *  This file is part of Wavefront Alignments Algorithms.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * PROJECT: Wavefront Alignments Algorithms
+ * AUTHOR(S): Santiago Marco-Sola <santiagomsola@gmail.com>
+ * DESCRIPTION: Edit distance computation [Ends-free] vectorized along the
+ *   anti-diagonals of the DP
+ */
+
+#include "edit_dp_simd.h"
+#include "edit_dp.h"
+
+/*
+ * Constants
+ */
+#define EDIT_DP_SIMD_MAX_LANES (64)
+
+/*
+ * Kernels (one per vector width and lane type)
+ */
+typedef int (*edit_dp_simd_kernel_f)(
+    const void* const pattern,
+    const void* const text,
+    const int pattern_length,
+    const int text_length,
+    const int text_band,
+    const int pattern_band,
+    void* const diagonals,
+    const int diagonal_length);
+// Baseline (SSE2 on x86-64)
+#define EDIT_DP_SIMD_ATTRIBUTES
+#define EDIT_DP_SIMD_KERNEL   edit_dp_simd_kernel_u8x16
+#define EDIT_DP_SIMD_CELL     uint8_t
+#define EDIT_DP_SIMD_LANES    16
+#include "edit_dp_simd_kernel.h"
+#undef EDIT_DP_SIMD_KERNEL
+#undef EDIT_DP_SIMD_CELL
+#undef EDIT_DP_SIMD_LANES
+#define EDIT_DP_SIMD_KERNEL   edit_dp_simd_kernel_u16x8
+#define EDIT_DP_SIMD_CELL     uint16_t
+#define EDIT_DP_SIMD_LANES    8
+#include "edit_dp_simd_kernel.h"
+#undef EDIT_DP_SIMD_KERNEL
+#undef EDIT_DP_SIMD_CELL
+#undef EDIT_DP_SIMD_LANES
+#undef EDIT_DP_SIMD_ATTRIBUTES
+#if defined(__x86_64__) || defined(__i386__)
+// AVX2
+#define EDIT_DP_SIMD_ATTRIBUTES  __attribute__((target("avx2")))
+#define EDIT_DP_SIMD_KERNEL   edit_dp_simd_kernel_u8x32
+#define EDIT_DP_SIMD_CELL     uint8_t
+#define EDIT_DP_SIMD_LANES    32
+#include "edit_dp_simd_kernel.h"
+#undef EDIT_DP_SIMD_KERNEL
+#undef EDIT_DP_SIMD_CELL
+#undef EDIT_DP_SIMD_LANES
+#define EDIT_DP_SIMD_KERNEL   edit_dp_simd_kernel_u16x16
+#define EDIT_DP_SIMD_CELL     uint16_t
+#define EDIT_DP_SIMD_LANES    16
+#include "edit_dp_simd_kernel.h"
+#undef EDIT_DP_SIMD_KERNEL
+#undef EDIT_DP_SIMD_CELL
+#undef EDIT_DP_SIMD_LANES
+#undef EDIT_DP_SIMD_ATTRIBUTES
+// AVX-512
+#define EDIT_DP_SIMD_ATTRIBUTES  __attribute__((target("avx512bw")))
+#define EDIT_DP_SIMD_KERNEL   edit_dp_simd_kernel_u8x64
+#define EDIT_DP_SIMD_CELL     uint8_t
+#define EDIT_DP_SIMD_LANES    64
+#include "edit_dp_simd_kernel.h"
+#undef EDIT_DP_SIMD_KERNEL
+#undef EDIT_DP_SIMD_CELL
+#undef EDIT_DP_SIMD_LANES
+#define EDIT_DP_SIMD_KERNEL   edit_dp_simd_kernel_u16x32
+#define EDIT_DP_SIMD_CELL     uint16_t
+#define EDIT_DP_SIMD_LANES    32
+#include "edit_dp_simd_kernel.h"
+#undef EDIT_DP_SIMD_KERNEL
+#undef EDIT_DP_SIMD_CELL
+#undef EDIT_DP_SIMD_LANES
+#undef EDIT_DP_SIMD_ATTRIBUTES
+#endif
+/*
+ * Dispatch (by the instruction set of the CPU)
+ */
+typedef struct {
+  const char* name;
+  edit_dp_simd_kernel_f kernel_u8;    // Patterns up to EDIT_DP_SIMD_MAX_LENGTH_8
+  edit_dp_simd_kernel_f kernel_u16;   // Patterns up to EDIT_DP_SIMD_MAX_LENGTH_16
+} edit_dp_simd_dispatch_t;
+edit_dp_simd_dispatch_t edit_dp_simd_dispatch(void) {
+  edit_dp_simd_dispatch_t dispatch = {
+      "sse2",edit_dp_simd_kernel_u8x16,edit_dp_simd_kernel_u16x8};
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx512bw")) {
+    dispatch.name = "avx512bw";
+    dispatch.kernel_u8 = edit_dp_simd_kernel_u8x64;
+    dispatch.kernel_u16 = edit_dp_simd_kernel_u16x32;
+  } else if (__builtin_cpu_supports("avx2")) {
+    dispatch.name = "avx2";
+    dispatch.kernel_u8 = edit_dp_simd_kernel_u8x32;
+    dispatch.kernel_u16 = edit_dp_simd_kernel_u16x16;
+  }
+#endif
+  return dispatch;
+}
+const char* edit_dp_simd_instruction_set(void) {
+  return edit_dp_simd_dispatch().name;
+}
+/*
+ * Edit distance computation (diagonals h-v in [-pattern_band,text_band-1])
+ */
+int edit_dp_distance_simd_compute(
+    edit_column_t* const edit_column,
+    const char* const pattern,
+    const int pattern_length,
+    const char* const text,
+    const int text_length,
+    const int text_band,
+    const int pattern_band,
+    mm_allocator_t* const mm_allocator) {
+  // Trivial cases (as the scalar DP)
+  if (text_length == 0) return INT_MAX;
+  if (pattern_length == 0) return 0;
+  // Select lanes
+  const edit_dp_simd_dispatch_t dispatch = edit_dp_simd_dispatch();
+  const bool lanes_u8 = (pattern_length <= EDIT_DP_SIMD_MAX_LENGTH_8);
+  const int cell_size = lanes_u8 ? sizeof(uint8_t) : sizeof(uint16_t);
+  // Allocate (padded, vectors may load/store past the end)
+  const int diagonal_length = pattern_length + 1 + EDIT_DP_SIMD_MAX_LANES;
+  const int pattern_cells = pattern_length + 1 + EDIT_DP_SIMD_MAX_LANES;
+  const int text_cells = text_length + EDIT_DP_SIMD_MAX_LANES;
+  const uint64_t total_cells = 3*diagonal_length + pattern_cells + text_cells;
+  void* const memory = edit_column_reserve(edit_column,total_cells*cell_size,mm_allocator);
+  memset(memory,0,total_cells*cell_size);
+  void* const diagonals = memory;
+  void* const pattern_lanes = memory + 3*diagonal_length*cell_size;
+  void* const text_lanes = pattern_lanes + pattern_cells*cell_size;
+  // Widen the sequences (pattern from position 1, text reversed)
+  int i;
+  if (lanes_u8) {
+    for (i=0;i<pattern_length;++i) ((uint8_t*)pattern_lanes)[i+1] = pattern[i];
+    for (i=0;i<text_length;++i) ((uint8_t*)text_lanes)[i] = text[text_length-1-i];
+  } else {
+    for (i=0;i<pattern_length;++i) ((uint16_t*)pattern_lanes)[i+1] = (uint8_t)pattern[i];
+    for (i=0;i<text_length;++i) ((uint16_t*)text_lanes)[i] = (uint8_t)text[text_length-1-i];
+  }
+  // Compute
+  const edit_dp_simd_kernel_f kernel = lanes_u8 ? dispatch.kernel_u8 : dispatch.kernel_u16;
+  const int distance = kernel(pattern_lanes,text_lanes,
+      pattern_length,text_length,text_band,pattern_band,diagonals,diagonal_length);
+  return distance;
+}
+int edit_dp_distance_simd(
+    edit_column_t* const edit_column,
+    const char* const pattern,
+    const int pattern_length,
+    const char* const text,
+    const int text_length,
+    mm_allocator_t* const mm_allocator) {
+  // Long patterns (scores don't fit the lanes)
+  if (pattern_length > EDIT_DP_SIMD_MAX_LENGTH_16) {
+    edit_column_resize(edit_column,pattern_length,text_length,mm_allocator);
+    return edit_dp_distance(edit_column,pattern,pattern_length,text,text_length);
+  }
+  // Compute (the band covers the whole DP)
+  return edit_dp_distance_simd_compute(edit_column,pattern,pattern_length,
+      text,text_length,text_length,pattern_length,mm_allocator);
+}
+int edit_dp_distance_banded_simd(
+    edit_column_t* const edit_column,
+    const char* const pattern,
+    const int pattern_length,
+    const char* const text,
+    const int text_length,
+    const int bandwidth,
+    mm_allocator_t* const mm_allocator) {
+  // Long patterns (scores don't fit the lanes)
+  if (pattern_length > EDIT_DP_SIMD_MAX_LENGTH_16) {
+    edit_column_resize(edit_column,pattern_length,text_length,mm_allocator);
+    return edit_dp_distance_banded(edit_column,
+        pattern,pattern_length,text,text_length,bandwidth);
+  }
+  // Compute band limits (account for mandatory indels)
+  int text_band = bandwidth + ((text_length>pattern_length) ? (text_length-pattern_length) : 0);
+  if (text_band > text_length) text_band = text_length;
+  int pattern_band = bandwidth + ((pattern_length>text_length) ? (pattern_length-text_length) : 0);
+  if (pattern_band > pattern_length) pattern_band = pattern_length;
+  // Compute
+  const int distance = edit_dp_distance_simd_compute(edit_column,pattern,pattern_length,
+      text,text_length,text_band,pattern_band,mm_allocator);
+  // Empty band in the last row (reported with the out-of-band score, as the scalar DP)
+  if (distance == INT_MAX && text_length > 0 && pattern_length <= pattern_band+text_length) {
+    return INT16_MAX;
+  }
+  return distance;
+}
@@ -0,0 +1,71 @@
+/*
+ *  Wavefront Alignments Algorithms
+ *  Copyright (c) 2020 by Santiago Marco-Sola  <santiagomsola@gmail.com>
+ *
+ *  This file is part of Wavefront Alignments Algorithms.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * PROJECT: Wavefront Alignments Algorithms
+ * AUTHOR(S): Santiago Marco-Sola <santiagomsola@gmail.com>
+ * DESCRIPTION: Edit distance computation [Ends-free] vectorized along the
+ *   anti-diagonals of the DP (the cells of an anti-diagonal are independent).
+ *   Scores never exceed the pattern length, so lanes of 8 bits (patterns up to
+ *   EDIT_DP_SIMD_MAX_LENGTH_8) or 16 bits (up to EDIT_DP_SIMD_MAX_LENGTH_16)
+ *   hold them; longer patterns fall back to the scalar DP. Same results as
+ *   edit_dp_distance() and edit_dp_distance_banded(). The buffers come from
+ *   the memory of @edit_column (a workspace, see edit_column_resize())
+ */
+
+#ifndef EDIT_DP_SIMD_H_
+#define EDIT_DP_SIMD_H_
+
+#include "../utils/commons.h"
+#include "../system/mm_allocator.h"
+#include "../alignment/edit_column.h"
+
+/*
+ * Constants
+ */
+#define EDIT_DP_SIMD_MAX_LENGTH_8   (UINT8_MAX-2)
+#define EDIT_DP_SIMD_MAX_LENGTH_16  (UINT16_MAX-2)
+
+/*
+ * Edit distance computation [Ends-free] [DP-Anti-diagonals]
+ */
+int edit_dp_distance_simd(
+    edit_column_t* const edit_column,
+    const char* const pattern,
+    const int pattern_length,
+    const char* const text,
+    const int text_length,
+    mm_allocator_t* const mm_allocator);
+/*
+ * Edit distance computation [Ends-free] [DP-Anti-diagonals] [Banded]
+ */
+int edit_dp_distance_banded_simd(
+    edit_column_t* const edit_column,
+    const char* const pattern,
+    const int pattern_length,
+    const char* const text,
+    const int text_length,
+    const int bandwidth,
+    mm_allocator_t* const mm_allocator);
+
+/*
+ * Instruction set used (e.g. "avx2")
+ */
+const char* edit_dp_simd_instruction_set(void);
+
+#endif /* EDIT_DP_SIMD_H_ */
@@ -0,0 +1,121 @@
+/*
+ *  Wavefront Alignments Algorithms
+ *  Copyright (c) 2020 by Santiago Marco-Sola  <santiagomsola@gmail.com>
+ *
+ *  This file is part of Wavefront Alignments Algorithms.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * PROJECT: Wavefront Alignments Algorithms
+ * AUTHOR(S): Santiago Marco-Sola <santiagomsola@gmail.com>
+ * DESCRIPTION: Anti-diagonal edit DP kernel. Instantiated by edit_dp_simd.cpp
+ *   for every vector width (no include guard), defining
+ *     EDIT_DP_SIMD_KERNEL      Function name
+ *     EDIT_DP_SIMD_ATTRIBUTES  Target attributes (or empty)
+ *     EDIT_DP_SIMD_CELL        Lane type (uint8_t/uint16_t)
+ *     EDIT_DP_SIMD_LANES       Lanes per vector
+ */
+
+/*
+ * Vector types
+ */
+#define EDIT_DP_SIMD_CONCAT_(a,b) a##b
+#define EDIT_DP_SIMD_CONCAT(a,b) EDIT_DP_SIMD_CONCAT_(a,b)
+#define EDIT_DP_SIMD_VECTOR EDIT_DP_SIMD_CONCAT(EDIT_DP_SIMD_KERNEL,_vector_t)
+typedef EDIT_DP_SIMD_CELL EDIT_DP_SIMD_VECTOR
+    __attribute__((vector_size(EDIT_DP_SIMD_LANES*sizeof(EDIT_DP_SIMD_CELL))));
+
+/*
+ * Kernel
+ *   Cells of the anti-diagonal d (v+h=d) only depend on the anti-diagonals
+ *   d-1 and d-2, which are kept indexed by the pattern position v. The text
+ *   is given reversed, so the characters of an anti-diagonal are contiguous.
+ *   Only the diagonals h-v in [-pattern_band,text_band-1] are computed (the
+ *   band of edit_dp_distance_banded), out of them cells are pattern_length+1
+ */
+EDIT_DP_SIMD_ATTRIBUTES
+int EDIT_DP_SIMD_KERNEL(
+    const void* const pattern_lanes,   // pattern[v] = P[v-1]
+    const void* const text_lanes,      // text[i] = T[text_length-1-i]
+    const int pattern_length,
+    const int text_length,
+    const int text_band,
+    const int pattern_band,
+    void* const diagonals_lanes,
+    const int diagonal_length) {
+  // Parameters
+  const EDIT_DP_SIMD_CELL* const pattern = (const EDIT_DP_SIMD_CELL*)pattern_lanes;
+  const EDIT_DP_SIMD_CELL* const text = (const EDIT_DP_SIMD_CELL*)text_lanes;
+  EDIT_DP_SIMD_CELL* const diagonals = (EDIT_DP_SIMD_CELL*)diagonals_lanes;
+  const EDIT_DP_SIMD_CELL inf = pattern_length+1; // Above any score in the band
+  EDIT_DP_SIMD_CELL* diagonal_2 = diagonals;                     // d-2
+  EDIT_DP_SIMD_CELL* diagonal_1 = diagonals + diagonal_length;   // d-1
+  EDIT_DP_SIMD_CELL* diagonal_0 = diagonals + 2*diagonal_length; // d
+  EDIT_DP_SIMD_VECTOR ones;
+  EDIT_DP_SIMD_CELL ones_lanes[EDIT_DP_SIMD_LANES];
+  int v, d, min_distance = INT_MAX;
+  for (v=0;v<EDIT_DP_SIMD_LANES;++v) ones_lanes[v] = 1;
+  memcpy(&ones,ones_lanes,sizeof(ones));
+  // Initialize (anti-diagonal 0)
+  diagonal_0[0] = 0;
+  // Compute DP (by anti-diagonals)
+  const int num_diagonals = pattern_length + text_length;
+  for (d=1;d<=num_diagonals;++d) {
+    // Rotate
+    EDIT_DP_SIMD_CELL* const diagonal_3 = diagonal_2;
+    diagonal_2 = diagonal_1;
+    diagonal_1 = diagonal_0;
+    diagonal_0 = diagonal_3;
+    // Limits (pattern, text and band)
+    int v_min = MAX(1,d-text_length);
+    v_min = MAX(v_min,(d-text_band+2)/2);
+    int v_max = MIN(pattern_length,d-1);
+    v_max = MIN(v_max,(d+pattern_band)/2);
+    // Compute anti-diagonal (lanes beyond v_max are never read)
+    const EDIT_DP_SIMD_CELL* const text_diagonal = text + (text_length-d);
+    for (v=v_min;v<=v_max;v+=EDIT_DP_SIMD_LANES) {
+      EDIT_DP_SIMD_VECTOR sub, del, ins, p, t;
+      memcpy(&sub,diagonal_2+(v-1),sizeof(sub)); // (v-1,h-1)
+      memcpy(&del,diagonal_1+(v-1),sizeof(del)); // (v-1,h)
+      memcpy(&ins,diagonal_1+v,sizeof(ins));     // (v,h-1)
+      memcpy(&p,pattern+v,sizeof(p));
+      memcpy(&t,text_diagonal+v,sizeof(t));
+      sub += (EDIT_DP_SIMD_VECTOR)(p != t) & ones;
+      del = (del < ins) ? del : ins;
+      del += ones;
+      sub = (sub < del) ? sub : del;
+      memcpy(diagonal_0+v,&sub,sizeof(sub));
+    }
+    // Borders of the anti-diagonal (row 0, column 0, or out of the band)
+    if (v_min-1 >= 0) {
+      const int h = d-(v_min-1);
+      diagonal_0[v_min-1] = (v_min-1 == 0 && h <= text_band) ? 0 : inf;
+    }
+    if (v_max+1 <= pattern_length) {
+      const int h = d-(v_max+1);
+      diagonal_0[v_max+1] = (h == 0 && v_max+1 <= pattern_band) ? v_max+1 : inf;
+    }
+    // Check min distance
+    if (v_max == pattern_length && v_min <= v_max) {
+      const int distance = diagonal_0[pattern_length];
+      if (distance < min_distance) min_distance = distance;
+    }
+  }
+  // Return distance
+  return min_distance;
+}
+
+#undef EDIT_DP_SIMD_VECTOR
+#undef EDIT_DP_SIMD_CONCAT
+#undef EDIT_DP_SIMD_CONCAT_
@@ -0,0 +1,133 @@
+/*
+ *  Wavefront Alignments Algorithms
+ *  Copyright (c) 2020 by Santiago Marco-Sola  <santiagomsola@gmail.com>
+ *
+ *  This file is part of Wavefront Alignments Algorithms.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * PROJECT: Wavefront Alignments Algorithms
+ * AUTHOR(S): Santiago Marco-Sola <santiagomsola@gmail.com>
+ * DESCRIPTION: Wavefront alignment (WFA) for Levenshtein distance (edit)
+ */
+
+#include "edit_wfa.h"
+
+/*
+ * Constants
+ */
+#define EDIT_WFA_OFFSET_NULL (INT_MIN/2) // Unreachable (stays negative after +1)
+
+/*
+ * Setup
+ */
+void edit_wfa_allocate(
+    edit_wfa_t* const edit_wfa,
+    const int pattern_length,
+    const int text_length,
+    mm_allocator_t* const mm_allocator) {
+  // Dimensions
+  edit_wfa->pattern_length = pattern_length;
+  edit_wfa->text_length = text_length;
+  // Diagonals [-pattern_length-1,text_length+1] (sentinels included)
+  const int num_diagonals = pattern_length+text_length+3;
+  edit_wfa->offsets_prev = mm_allocator_calloc(mm_allocator,num_diagonals,int,false) + (pattern_length+1);
+  edit_wfa->offsets_curr = mm_allocator_calloc(mm_allocator,num_diagonals,int,false) + (pattern_length+1);
+}
+void edit_wfa_free(
+    edit_wfa_t* const edit_wfa,
+    mm_allocator_t* const mm_allocator) {
+  mm_allocator_free(mm_allocator,edit_wfa->offsets_curr-(edit_wfa->pattern_length+1));
+  mm_allocator_free(mm_allocator,edit_wfa->offsets_prev-(edit_wfa->pattern_length+1));
+}
+/*
+ * Extend along the matches of the diagonal (returns the new text offset)
+ */
+static inline int edit_wfa_extend(
+    const char* const pattern,
+    const int pattern_length,
+    const char* const text,
+    const int text_length,
+    int v,
+    int h) {
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+  // Compare 8 characters at a time (the first mismatch is the lowest byte set)
+  while (v+8 <= pattern_length && h+8 <= text_length) {
+    uint64_t pattern_block, text_block;
+    memcpy(&pattern_block,pattern+v,8);
+    memcpy(&text_block,text+h,8);
+    const uint64_t mismatches = pattern_block ^ text_block;
+    if (mismatches) return h + (__builtin_ctzll(mismatches)>>3);
+    v += 8; h += 8;
+  }
+#endif
+  while (v < pattern_length && h < text_length && pattern[v] == text[h]) {
+    ++v; ++h;
+  }
+  return h;
+}
+/*
+ * Edit distance computation [Ends-free] [Wavefronts]
+ */
+int edit_wfa_distance(
+    edit_wfa_t* const edit_wfa,
+    const char* const pattern,
+    const int pattern_length,
+    const char* const text,
+    const int text_length,
+    const int max_distance) {
+  // Corner cases (as the DP, the pattern aligns against one text character at least)
+  if (text_length == 0) return INT_MAX;
+  if (pattern_length == 0) return 0;
+  // Parameters
+  int* offsets_curr = edit_wfa->offsets_curr;
+  int* offsets_prev = edit_wfa->offsets_prev;
+  const int max_score = (max_distance < 0 || max_distance > pattern_length) ? pattern_length : max_distance;
+  int k, score;
+  // Score 0 [Ends-free] (every text position starts a diagonal)
+  int lo = 0, hi = text_length;
+  for (k=lo;k<=hi;++k) {
+    const int h = edit_wfa_extend(pattern,pattern_length,text,text_length,0,k);
+    if (h-k == pattern_length) return 0;
+    offsets_curr[k] = h;
+  }
+  // Compute wavefronts
+  for (score=1;score<=max_score;++score) {
+    SWAP(offsets_curr,offsets_prev);
+    // Compute limits (diagonals lie within [-pattern_length,text_length])
+    const int lo_next = MAX(lo-1,-pattern_length);
+    const int hi_next = MIN(hi+1,text_length);
+    for (k=lo_next-1;k<lo;++k) offsets_prev[k] = EDIT_WFA_OFFSET_NULL;
+    for (k=hi+1;k<=hi_next+1;++k) offsets_prev[k] = EDIT_WFA_OFFSET_NULL;
+    // Compute next wavefront
+    for (k=lo_next;k<=hi_next;++k) {
+      // Insertion and mismatch advance the text (not past its end)
+      const int ins = (offsets_prev[k-1] < text_length) ? offsets_prev[k-1]+1 : EDIT_WFA_OFFSET_NULL;
+      const int misms = (offsets_prev[k] < text_length) ? offsets_prev[k]+1 : EDIT_WFA_OFFSET_NULL;
+      const int del = offsets_prev[k+1];
+      int h = MAX(MAX(ins,misms),del);
+      if (h >= 0) {
+        h = edit_wfa_extend(pattern,pattern_length,text,text_length,h-k,h);
+        if (h-k == pattern_length) return score;
+      } else {
+        h = EDIT_WFA_OFFSET_NULL;
+      }
+      offsets_curr[k] = h;
+    }
+    lo = lo_next;
+    hi = hi_next;
+  }
+  // Above the cut-off
+  return INT_MAX;
+}
@@ -0,0 +1,72 @@
+/*
+ *  Wavefront Alignments Algorithms
+ *  Copyright (c) 2020 by Santiago Marco-Sola  <santiagomsola@gmail.com>
+ *
+ *  This file is part of Wavefront Alignments Algorithms.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * PROJECT: Wavefront Alignments Algorithms
+ * AUTHOR(S): Santiago Marco-Sola <santiagomsola@gmail.com>
+ * DESCRIPTION: Wavefront alignment (WFA) for Levenshtein distance (edit).
+ *   The wavefront of score s holds, per diagonal (k = h - v), the furthest
+ *   text offset reachable with s edits. The text is ends-free, so the
+ *   wavefront of score 0 starts on every diagonal, and the alignment ends as
+ *   soon as a diagonal consumes the whole pattern. Time is O(n*s) and memory
+ *   O(n+m) (only the last wavefront is kept). Same results as edit_dp_distance()
+ */
+
+#ifndef EDIT_WFA_H_
+#define EDIT_WFA_H_
+
+#include "../utils/commons.h"
+#include "../system/mm_allocator.h"
+
+/*
+ * Wavefronts (offsets per diagonal)
+ */
+typedef struct {
+  // Dimensions
+  int pattern_length;
+  int text_length;
+  // Wavefronts (previous and current score)
+  int* offsets_prev;
+  int* offsets_curr;
+} edit_wfa_t;
+
+/*
+ * Setup
+ */
+void edit_wfa_allocate(
+    edit_wfa_t* const edit_wfa,
+    const int pattern_length,
+    const int text_length,
+    mm_allocator_t* const mm_allocator);
+void edit_wfa_free(
+    edit_wfa_t* const edit_wfa,
+    mm_allocator_t* const mm_allocator);
+
+/*
+ * Edit distance computation [Ends-free] [Wavefronts]
+ *   Returns INT_MAX if the distance is above @max_distance (or -1 for no cut-off)
+ */
+int edit_wfa_distance(
+    edit_wfa_t* const edit_wfa,
+    const char* const pattern,
+    const int pattern_length,
+    const char* const text,
+    const int text_length,
+    const int max_distance);
+
+#endif /* EDIT_WFA_H_ */
@@ -23,7 +23,11 @@
 
 #include "benchmark_edit_alg.h"
 #include "../alignment/edit_bpm_distance.h"
+#include "../alignment/edit_bpm_multi.h"
 #include "../alignment/edit_dp.h"
+#include "../alignment/edit_dp_simd.h"
+#include "../alignment/edit_wfa.h"
+#include "../utils/dna_text.h"
 
 #include <string>
 
@@ -32,16 +36,30 @@ using namespace std;
 /*
  * Check
  */
+#define BENCHMARK_CHECK_CUTOFF_MAX_LENGTH 32 // Shorter patterns are faster with the cut-off DP
+int benchmark_check_distance(
+    filter_input_t* const filter_input,
+    const char* const pattern,
+    const int pattern_length,
+    const char* const text,
+    const int text_length) {
+  // Only the accept/reject decision is needed (any distance above max_error will do)
+  edit_column_t* const edit_column = &filter_input->workspace.edit_column;
+  if (pattern_length <= BENCHMARK_CHECK_CUTOFF_MAX_LENGTH ||
+      pattern_length > EDIT_DP_SIMD_MAX_LENGTH_16) {
+    edit_column_resize(edit_column,pattern_length,text_length,filter_input->mm_allocator);
+    return edit_dp_distance_cutoff(edit_column,
+        pattern,pattern_length,text,text_length,filter_input->max_error);
+  }
+  return edit_dp_distance_simd(edit_column,
+      pattern,pattern_length,text,text_length,filter_input->mm_allocator);
+}
 void benchmark_check(
     filter_input_t* const filter_input,
     const bool accepted) {
-  // Parameters
-  edit_column_t edit_column;
   // Compute Edit Distance
-  edit_column_allocate(
-      &edit_column,filter_input->pattern_length,
-      filter_input->text_length,filter_input->mm_allocator);
-  const int edit_distance = edit_dp_distance(&edit_column,
+  timer_start(&filter_input->timer_check);
+  const int edit_distance = benchmark_check_distance(filter_input,
       filter_input->pattern,filter_input->pattern_length,
       filter_input->text,filter_input->text_length);
   // Check result
@@ -59,8 +77,7 @@ void benchmark_check(
       ++(filter_input->candidates_tn);
     }
   }
-  // Free
-  edit_column_free(&edit_column,filter_input->mm_allocator);
+  timer_stop(&filter_input->timer_check);
 }
 
 /*
@@ -71,12 +88,9 @@ void my_benchmark_check(filter_input_t* const filter_input,
 	string text, 
 const bool accepted)
 {
-  // Parameters
-  edit_column_t edit_column;
+  timer_start(&filter_input->timer_check);
   // Compute Edit Distance
-  edit_column_allocate(&edit_column, pattern.size(), text.size(),filter_input->mm_allocator);
-
-  const int edit_distance = edit_dp_distance(&edit_column,
+  const int edit_distance = benchmark_check_distance(filter_input,
       pattern.c_str(), pattern.size(),
       text.c_str(),text.size());
 
@@ -97,8 +111,7 @@ const bool accepted)
       ++(filter_input->candidates_tn);
     }
   }
-  // Free
-  edit_column_free(&edit_column,filter_input->mm_allocator);
+  timer_stop(&filter_input->timer_check);
 }
 
 
@@ -113,68 +126,284 @@ void benchmark_check_edit_distance(
 void benchmark_edit_dp(
     filter_input_t* const filter_input,
     const int bandwidth) {
-  // Parameters
-  edit_column_t edit_column;
-  // Allocate
-  edit_column_allocate(
-      &edit_column,filter_input->pattern_length,
+  // Parameters (DP columns of the workspace)
+  edit_column_t* const edit_column = &filter_input->workspace.edit_column;
+  edit_column_resize(edit_column,filter_input->pattern_length,
       filter_input->text_length,filter_input->mm_allocator);
   // Align
   int edit_distance;
   if (bandwidth == -1) {
     timer_start(&filter_input->timer);
-    edit_distance = edit_dp_distance(&edit_column,
+    edit_distance = edit_dp_distance(edit_column,
         filter_input->pattern,filter_input->pattern_length,
         filter_input->text,filter_input->text_length);
     timer_stop(&filter_input->timer);
   } else {
+    // Banded (vectorized along the anti-diagonals)
     timer_start(&filter_input->timer);
-    edit_distance = edit_dp_distance_banded(&edit_column,
+    edit_distance = edit_dp_distance_banded_simd(edit_column,
         filter_input->pattern,filter_input->pattern_length,
-        filter_input->text,filter_input->text_length,bandwidth);
+        filter_input->text,filter_input->text_length,bandwidth,filter_input->mm_allocator);
     timer_stop(&filter_input->timer);
+    // Check against the scalar banded DP
+    if (filter_input->check) {
+      timer_start(&filter_input->timer_check);
+      const int scalar_distance = edit_dp_distance_banded(edit_column,
+          filter_input->pattern,filter_input->pattern_length,
+          filter_input->text,filter_input->text_length,bandwidth);
+      timer_stop(&filter_input->timer_check);
+      if (scalar_distance != edit_distance) {
+        fprintf(stderr,"Banded DP mismatch (sequence %d: vectorized %d, scalar %d)\n",
+            filter_input->sequence_id,edit_distance,scalar_distance);
+        exit(1);
+      }
+    }
   }
   // Check result
+  filter_input->bound = edit_distance;
+  filter_input->accepted = (edit_distance <= filter_input->max_error);
   ++(filter_input->candidates_total);
-  if (edit_distance <= filter_input->max_error) {
+  if (filter_input->accepted) {
     ++(filter_input->candidates_tp);
   } else {
     ++(filter_input->candidates_tn);
   }
+}
+/*
+ * BPM pattern of the candidate. Compiled once per read (the candidates
+ * of a read come in a row), reusing the memory of the previous one
+ */
+bpm_pattern_t* benchmark_edit_bpm_pattern(
+    filter_input_t* const filter_input) {
+  // Parameters
+  filter_workspace_t* const workspace = &filter_input->workspace;
+  const candidate_packed_record_t* const packed_record = filter_input->packed_record;
+  const int pattern_length = filter_input->pattern_length;
+  // Key of the pattern (characters, or packed bases and runs)
+  const uint8_t* key = (const uint8_t*)filter_input->pattern;
+  uint64_t key_length = pattern_length, runs_length = 0;
+  if (packed_record != NULL) {
+    key = candidate_packed_record_pattern(packed_record);
+    key_length = candidate_packed_size(pattern_length);
+    runs_length = packed_record->pattern_n_runs*sizeof(candidate_packed_run_t);
+  }
+  // Same pattern as the last candidate
+  bpm_pattern_t* const bpm_pattern = &workspace->bpm_pattern;
+  if (workspace->bpm_pattern_compiled &&
+      bpm_pattern->pattern_length == pattern_length &&
+      workspace->bpm_pattern_key_length == key_length+runs_length &&
+      memcmp(workspace->bpm_pattern_key,key,key_length) == 0 &&
+      (runs_length == 0 || memcmp(workspace->bpm_pattern_key+key_length,
+          candidate_packed_record_pattern_runs(packed_record),runs_length) == 0)) {
+    return bpm_pattern;
+  }
+  // Store the key
+  if (workspace->bpm_pattern_key_allocated < key_length+runs_length) {
+    workspace->bpm_pattern_key_allocated = 2*(key_length+runs_length);
+    workspace->bpm_pattern_key = (uint8_t*) realloc(
+        workspace->bpm_pattern_key,workspace->bpm_pattern_key_allocated);
+  }
+  memcpy(workspace->bpm_pattern_key,key,key_length);
+  if (runs_length > 0) {
+    memcpy(workspace->bpm_pattern_key+key_length,
+        candidate_packed_record_pattern_runs(packed_record),runs_length);
+  }
+  workspace->bpm_pattern_key_length = key_length+runs_length;
+  // Compile
+  if (packed_record != NULL) {
+    const uint32_t* const n_runs = (const uint32_t*)candidate_packed_record_pattern_runs(packed_record);
+    if (workspace->bpm_pattern_compiled) {
+      edit_bpm_pattern_recompile_packed(bpm_pattern,key,pattern_length,
+          n_runs,packed_record->pattern_n_runs,filter_input->mm_allocator);
+    } else {
+      edit_bpm_pattern_compile_packed(bpm_pattern,key,pattern_length,
+          n_runs,packed_record->pattern_n_runs,filter_input->mm_allocator);
+    }
+  } else {
+    char* const pattern = (char*)workspace->bpm_pattern_key; // Kept (the input is a view)
+    if (workspace->bpm_pattern_compiled) {
+      edit_bpm_pattern_recompile(bpm_pattern,pattern,pattern_length,filter_input->mm_allocator);
+    } else {
+      edit_bpm_pattern_compile(bpm_pattern,pattern,pattern_length,filter_input->mm_allocator);
+    }
+  }
+  workspace->bpm_pattern_compiled = true;
+  return bpm_pattern;
+}
+/*
+ * Characters of a packed text (decoded into the workspace)
+ */
+char* benchmark_edit_decode_text(
+    filter_input_t* const filter_input) {
+  filter_workspace_t* const workspace = &filter_input->workspace;
+  const candidate_packed_record_t* const packed_record = filter_input->packed_record;
+  if (workspace->text_allocated <= packed_record->text_length) {
+    workspace->text_allocated = 2*packed_record->text_length+1;
+    workspace->text = (char*) realloc(workspace->text,workspace->text_allocated);
+  }
+  candidate_packed_record_decode_text(packed_record,workspace->text);
+  workspace->text[packed_record->text_length] = '\0';
+  return workspace->text;
+}
+int benchmark_edit_bpm_alignment(
+    filter_input_t* const filter_input,
+    bpm_pattern_t* const bpm_pattern,
+    char* const text) {
+  // Align (keeping the bit-DP for the traceback)
+  bpm_alignment_t bpm_alignment;
+  timer_start(&filter_input->timer);
+  edit_bpm_alignment_compute(&bpm_alignment,bpm_pattern,
+      text,filter_input->text_length,true,filter_input->mm_allocator);
+  timer_stop(&filter_input->timer);
+  // Best hit (the CIGAR is kept in the workspace)
+  filter_workspace_t* const workspace = &filter_input->workspace;
+  const uint64_t cigar_size = 2*bpm_alignment.num_operations+1;
+  if (workspace->cigar_allocated < cigar_size) {
+    workspace->cigar_allocated = 2*cigar_size;
+    workspace->cigar = (char*) realloc(workspace->cigar,workspace->cigar_allocated);
+  }
+  filter_input->text_begin = bpm_alignment.text_begin;
+  filter_input->text_end = bpm_alignment.text_end;
+  filter_input->cigar = workspace->cigar;
+  filter_input->cigar_length = edit_bpm_alignment_sprint_cigar(&bpm_alignment,workspace->cigar);
   // Free
-  edit_column_free(&edit_column,filter_input->mm_allocator);
+  const int edit_distance = bpm_alignment.distance;
+  edit_bpm_alignment_free(&bpm_alignment,filter_input->mm_allocator);
+  return edit_distance;
 }
 void benchmark_edit_bpm(
     filter_input_t* const filter_input,
     const int bandwidth) {
-  // Allocate
-  bpm_pattern_t bpm_pattern;
-  edit_bpm_pattern_compile(
-      &bpm_pattern,filter_input->pattern,
-      filter_input->pattern_length,filter_input->mm_allocator);
-  // Align
+  // Pattern
+  bpm_pattern_t* const bpm_pattern = benchmark_edit_bpm_pattern(filter_input);
+  // Text (packed texts are read as they are, unless they have uncalled bases)
+  const candidate_packed_record_t* const packed_record = filter_input->packed_record;
+  const uint8_t* packed_text = NULL;
+  char* text = filter_input->text;
+  if (packed_record != NULL) {
+    if (packed_record->text_n_runs == 0) {
+      packed_text = candidate_packed_record_text(packed_record);
+    } else if (text == NULL) {
+      text = benchmark_edit_decode_text(filter_input);
+    }
+  }
+  // Align (the alignment of the best hit is computed on the whole text)
   int edit_distance;
-  if (bandwidth == -1) {
+  if (filter_input->alignment) {
+    if (text == NULL) text = benchmark_edit_decode_text(filter_input);
+    edit_distance = benchmark_edit_bpm_alignment(filter_input,bpm_pattern,text);
+  } else if (bandwidth == -1) {
     timer_start(&filter_input->timer);
-    edit_distance = edit_bpm_distance_compute(
-        &bpm_pattern,filter_input->text,filter_input->text_length);
+    edit_distance = (packed_text != NULL) ?
+        edit_bpm_distance_compute_packed(bpm_pattern,packed_text,filter_input->text_length) :
+        edit_bpm_distance_compute(bpm_pattern,text,filter_input->text_length);
     timer_stop(&filter_input->timer);
   } else {
     timer_start(&filter_input->timer);
-    edit_distance = edit_bpm_distance_compute_cutoff(
-          &bpm_pattern,filter_input->text,
-          filter_input->text_length,bandwidth,true);
+    edit_distance = (packed_text != NULL) ?
+        edit_bpm_distance_compute_banded_packed(bpm_pattern,packed_text,filter_input->text_length,bandwidth) :
+        edit_bpm_distance_compute_banded(bpm_pattern,text,filter_input->text_length,bandwidth);
     timer_stop(&filter_input->timer);
   }
   // Check result
+  filter_input->bound = edit_distance;
+  filter_input->accepted = (edit_distance <= filter_input->max_error);
+  ++(filter_input->candidates_total);
+  if (filter_input->accepted) {
+    ++(filter_input->candidates_tp);
+  } else {
+    ++(filter_input->candidates_tn);
+  }
+}
+void benchmark_edit_wfa(
+    filter_input_t* const filter_input) {
+  // Parameters
+  edit_wfa_t edit_wfa;
+  // Allocate
+  edit_wfa_allocate(
+      &edit_wfa,filter_input->pattern_length,
+      filter_input->text_length,filter_input->mm_allocator);
+  // Align (cut-off at the maximum error)
+  timer_start(&filter_input->timer);
+  const int edit_distance = edit_wfa_distance(&edit_wfa,
+      filter_input->pattern,filter_input->pattern_length,
+      filter_input->text,filter_input->text_length,
+      filter_input->max_error);
+  timer_stop(&filter_input->timer);
+  // Check result
+  filter_input->bound = edit_distance;
+  filter_input->accepted = (edit_distance <= filter_input->max_error);
   ++(filter_input->candidates_total);
-  if (edit_distance <= filter_input->max_error) {
+  if (filter_input->accepted) {
     ++(filter_input->candidates_tp);
   } else {
     ++(filter_input->candidates_tn);
   }
   // Free
-  edit_bpm_pattern_free(&bpm_pattern,filter_input->mm_allocator);
+  edit_wfa_free(&edit_wfa,filter_input->mm_allocator);
+}
+void benchmark_edit_bpm_tiled(
+    filter_input_t* const filter_input) {
+  // Parameters
+  filter_workspace_t* const workspace = &filter_input->workspace;
+  const int pattern_length = filter_input->pattern_length;
+  // Patterns with uncalled bases are filtered with the DP (a BPM tile never
+  // matches an N, while the edit distance counts N==N as a match)
+  const candidate_packed_record_t* const packed_record = filter_input->packed_record;
+  const bool pattern_has_n = (packed_record != NULL) ?
+      (packed_record->pattern_n_runs > 0) :
+      (memchr(filter_input->pattern,DNA_CHAR_N,pattern_length) != NULL);
+  if (pattern_has_n) {
+    timer_start(&filter_input->timer);
+    const int edit_distance = benchmark_check_distance(filter_input,
+        filter_input->pattern,pattern_length,filter_input->text,filter_input->text_length);
+    timer_stop(&filter_input->timer);
+    filter_input->bound = edit_distance;
+    filter_input->accepted = (edit_distance <= filter_input->max_error);
+    if (filter_input->check) {
+      benchmark_check(filter_input,filter_input->accepted);
+    }
+    return;
+  }
+  // Tiles (max_error+1; the edit distance is at least the sum of their distances)
+  const int num_tiles = MIN(filter_input->max_error+1,pattern_length);
+  if (workspace->tiles_allocated < num_tiles) {
+    workspace->tiles_allocated = 2*num_tiles;
+    workspace->tiles = (char**) realloc(workspace->tiles,workspace->tiles_allocated*sizeof(char*));
+    workspace->tile_lengths = (int*) realloc(workspace->tile_lengths,workspace->tiles_allocated*sizeof(int));
+    workspace->tile_distances = (int*) realloc(workspace->tile_distances,workspace->tiles_allocated*sizeof(int));
+  }
+  int i;
+  for (i=0;i<num_tiles;++i) {
+    const int tile_begin = (int)(((int64_t)i*pattern_length)/num_tiles);
+    const int tile_end = (int)(((int64_t)(i+1)*pattern_length)/num_tiles);
+    workspace->tiles[i] = filter_input->pattern + tile_begin;
+    workspace->tile_lengths[i] = tile_end - tile_begin;
+  }
+  // Compile (all the tiles packed together)
+  bpm_multi_pattern_t* const bpm_multi_pattern = &workspace->bpm_multi_pattern;
+  if (workspace->bpm_multi_pattern_compiled) {
+    edit_bpm_multi_pattern_recompile(bpm_multi_pattern,
+        workspace->tiles,workspace->tile_lengths,num_tiles,filter_input->mm_allocator);
+  } else {
+    edit_bpm_multi_pattern_compile(bpm_multi_pattern,
+        workspace->tiles,workspace->tile_lengths,num_tiles,filter_input->mm_allocator);
+    workspace->bpm_multi_pattern_compiled = true;
+  }
+  // Filter (one scan of the text for all the tiles)
+  timer_start(&filter_input->timer);
+  edit_bpm_multi_distance_compute(bpm_multi_pattern,
+      filter_input->text,filter_input->text_length,workspace->tile_distances);
+  int bound = 0;
+  for (i=0;i<num_tiles && bound!=INT_MAX;++i) {
+    const int tile_distance = workspace->tile_distances[i];
+    bound = (tile_distance == INT_MAX) ? INT_MAX : bound + tile_distance;
+  }
+  timer_stop(&filter_input->timer);
+  filter_input->bound = bound;
+  filter_input->accepted = (bound <= filter_input->max_error);
+  // Check result
+  if (filter_input->check) {
+    benchmark_check(filter_input,filter_input->accepted);
+  }
 }
-
-
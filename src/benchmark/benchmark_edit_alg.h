@@ -46,5 +46,9 @@ void benchmark_edit_dp(
 void benchmark_edit_bpm(
     filter_input_t* const filter_input,
     const int bandwidth);
+void benchmark_edit_wfa(
+    filter_input_t* const filter_input);
+void benchmark_edit_bpm_tiled(
+    filter_input_t* const filter_input);
 
 #endif /* BENCHMARK_EDIT_ALG_H_ */
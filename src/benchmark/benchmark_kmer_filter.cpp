@@ -40,9 +40,20 @@ void benchmark_kmer_filter(filter_input_t* const filter_input, const int kmer_le
   // Parameters
   kmer_counting_nway_t* const kmer_counting = kmer_counting_new(kmer_length, filter_input->mm_allocator);
   
+  const candidate_packed_record_t* const packed_record = filter_input->packed_record;
+  
   // Allocate
-  // computes the histogram of the pattern
-  kmer_counting_pattern_compute_histogram(kmer_counting, (uint8_t*)filter_input->pattern,filter_input->pattern_length);
+  // computes the histogram of the pattern (packed candidates are read from the mapped file)
+  if (packed_record != NULL)
+  {
+    kmer_counting_pattern_compute_histogram_packed(kmer_counting,candidate_packed_record_pattern(packed_record),
+        packed_record->pattern_length,(const uint32_t*)candidate_packed_record_pattern_runs(packed_record),
+        packed_record->pattern_n_runs);
+  }
+  else
+  {
+    kmer_counting_pattern_compute_histogram(kmer_counting, (uint8_t*)filter_input->pattern,filter_input->pattern_length);
+  }
   
   if (filter_input->verbose) 
   {
@@ -56,15 +67,19 @@ void benchmark_kmer_filter(filter_input_t* const filter_input, const int kmer_le
   
   // Filter
   timer_start(&filter_input->timer);
-  const uint64_t min_error_bound = kmer_counting_min_bound(kmer_counting,(uint8_t*)filter_input->text,
+  const uint64_t min_error_bound = (packed_record != NULL) ?
+      kmer_counting_min_bound_packed(kmer_counting,candidate_packed_record_text(packed_record),
+          packed_record->text_length,filter_input->max_error) :
+      kmer_counting_min_bound(kmer_counting,(uint8_t*)filter_input->text,
           filter_input->text_length,filter_input->max_error);
   
   timer_stop(&filter_input->timer);
+  filter_input->bound = min_error_bound;
+  filter_input->accepted = (min_error_bound <= filter_input->max_error);
   // Check result
   if (filter_input->check) 
   {
-    const bool accepted = (min_error_bound <= filter_input->max_error);
-    benchmark_check(filter_input,accepted);
+    benchmark_check(filter_input,filter_input->accepted);
   }
   // Free
   kmer_counting_destroy(kmer_counting);
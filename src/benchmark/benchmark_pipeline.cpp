@@ -0,0 +1,346 @@
+/*
+ *  Wavefront Alignments Algorithms
+ *  Copyright (c) 2020 by Santiago Marco-Sola  <santiagomsola@gmail.com>
+ *
+ *  This file is part of Wavefront Alignments Algorithms.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * PROJECT: Fast Mapping-Candidates Filtering Algorithms
+ * AUTHOR(S): Santiago Marco-Sola <santiagomsola@gmail.com>
+ * DESCRIPTION: Staged benchmark pipeline (reader, workers, ordered aggregator)
+ */
+
+#include "../benchmark/benchmark_pipeline.h"
+
+#include <pthread.h>
+
+/*
+ * Worker
+ */
+typedef struct {
+  benchmark_pipeline_t* pipeline;
+  filter_input_t* filter_input;
+  // Decoded packed candidates
+  char* pattern;
+  char* text;
+  int sequences_allocated;
+} benchmark_worker_t;
+
+/*
+ * Setup
+ */
+void benchmark_pipeline_init(
+    benchmark_pipeline_t* const pipeline,
+    filter_input_t* const filter_input) {
+  // Batches
+  pipeline->num_batches = BENCHMARK_PIPELINE_BATCHES_WORKER*pipeline->num_workers;
+  pipeline->batches = (benchmark_batch_t*) malloc(pipeline->num_batches*sizeof(benchmark_batch_t));
+  // Rings (the end-of-input markers also travel through them)
+  const int ring_capacity = pipeline->num_batches + pipeline->num_workers;
+  pipeline->free_batches = ring_buffer_new(ring_capacity);
+  pipeline->input_batches = ring_buffer_new(ring_capacity);
+  pipeline->output_batches = ring_buffer_new(ring_capacity);
+  int i;
+  for (i=0;i<pipeline->num_batches;++i) {
+    pipeline->batches[i].cigars = NULL;
+    pipeline->batches[i].cigars_used = 0;
+    pipeline->batches[i].cigars_allocated = 0;
+    pipeline->batches[i].input_end = 0;
+    ring_buffer_push(pipeline->free_batches,pipeline->batches+i);
+  }
+  // Workers
+  pipeline->worker_inputs = (filter_input_t*) malloc(pipeline->num_workers*sizeof(filter_input_t));
+  for (i=0;i<pipeline->num_workers;++i) {
+    filter_input_t* const worker_input = pipeline->worker_inputs + i;
+    filter_input_clear(worker_input);
+    worker_input->check = filter_input->check;
+    worker_input->verbose = filter_input->verbose;
+    worker_input->alignment = filter_input->alignment;
+    worker_input->mm_allocator = mm_allocator_new(BUFFER_SIZE_8M);
+    timer_reset(&worker_input->timer);
+    timer_reset(&worker_input->timer_check);
+  }
+}
+void benchmark_pipeline_destroy(
+    benchmark_pipeline_t* const pipeline,
+    filter_input_t* const filter_input) {
+  // Merge the results of the workers
+  int i;
+  for (i=0;i<pipeline->num_workers;++i) {
+    filter_input_t* const worker_input = pipeline->worker_inputs + i;
+    counter_combine_sum(&filter_input->timer.time_ns,&worker_input->timer.time_ns);
+    counter_combine_sum(&filter_input->timer_check.time_ns,&worker_input->timer_check.time_ns);
+    filter_input->candidates_total += worker_input->candidates_total;
+    filter_input->candidates_tp += worker_input->candidates_tp;
+    filter_input->candidates_fp += worker_input->candidates_fp;
+    filter_input->candidates_tn += worker_input->candidates_tn;
+    filter_input->candidates_fn += worker_input->candidates_fn;
+    filter_input_free_workspace(worker_input);
+    mm_allocator_delete(worker_input->mm_allocator);
+  }
+  // Free
+  free(pipeline->worker_inputs);
+  ring_buffer_delete(pipeline->free_batches);
+  ring_buffer_delete(pipeline->input_batches);
+  ring_buffer_delete(pipeline->output_batches);
+  for (i=0;i<pipeline->num_batches;++i) {
+    free(pipeline->batches[i].cigars);
+  }
+  free(pipeline->batches);
+}
+/*
+ * Reader
+ */
+void* benchmark_pipeline_reader(void* const arg) {
+  benchmark_pipeline_t* const pipeline = (benchmark_pipeline_t*) arg;
+  char *line1, *line2;
+  int line1_length, line2_length;
+  uint64_t batch_id = 0;
+  int sequence_id = 0;
+  bool eof = false;
+  while (!eof) {
+    // Wait for a free batch (backpressure)
+    benchmark_batch_t* const batch = (benchmark_batch_t*) ring_buffer_pop(pipeline->free_batches);
+    // Batches are recycled in input order, so the input below a recycled batch is not in use
+    if (pipeline->input != NULL && batch->input_end > 0) {
+      input_mmap_release(pipeline->input,batch->input_end);
+    }
+    batch->batch_id = batch_id;
+    batch->first_sequence_id = sequence_id;
+    batch->num_candidates = 0;
+    // Parse (views of the mapped file, without the '>'/'<' prefix)
+    while (batch->num_candidates < BENCHMARK_PIPELINE_BATCH_SIZE) {
+      benchmark_candidate_t* const candidate = batch->candidates + batch->num_candidates;
+      if (pipeline->packed_input != NULL) {
+        if ((uint64_t)(sequence_id + batch->num_candidates) >= candidate_packed_get_num_records(pipeline->packed_input)) {
+          eof = true;
+          break;
+        }
+        const candidate_packed_record_t* const record =
+            candidate_packed_get_record(pipeline->packed_input,sequence_id+batch->num_candidates);
+        candidate->packed_record = record;
+        candidate->pattern = NULL;
+        candidate->pattern_length = record->pattern_length;
+        candidate->text = NULL;
+        candidate->text_length = record->text_length;
+        candidate->max_error = record->max_error;
+        candidate->bandwidth = filter_input_bandwidth(pipeline->bandwidth,candidate->pattern_length);
+        ++(batch->num_candidates);
+        continue;
+      }
+      if (!input_mmap_get_line(pipeline->input,&line1,&line1_length) ||
+          !input_mmap_get_line(pipeline->input,&line2,&line2_length)) {
+        eof = true;
+        break;
+      }
+      candidate->packed_record = NULL;
+      candidate->pattern = line1+1;
+      candidate->pattern_length = line1_length-1;
+      candidate->text = line2+1;
+      candidate->text_length = line2_length-1;
+      candidate->max_error = filter_input_max_error(pipeline->max_error,candidate->pattern_length);
+      candidate->bandwidth = filter_input_bandwidth(pipeline->bandwidth,candidate->pattern_length);
+      ++(batch->num_candidates);
+    }
+    batch->input_end = (pipeline->input != NULL) ? input_mmap_offset(pipeline->input) : 0;
+    // Dispatch
+    if (batch->num_candidates == 0) {
+      ring_buffer_push(pipeline->free_batches,batch);
+      break;
+    }
+    ring_buffer_push(pipeline->input_batches,batch);
+    sequence_id += batch->num_candidates;
+    ++batch_id;
+  }
+  // One end-of-input marker per worker
+  int i;
+  for (i=0;i<pipeline->num_workers;++i) {
+    ring_buffer_push(pipeline->input_batches,NULL);
+  }
+  return NULL;
+}
+/*
+ * Worker
+ */
+void benchmark_pipeline_decode(
+    benchmark_worker_t* const worker,
+    const candidate_packed_record_t* const record) {
+  const int max_length = MAX(record->pattern_length,record->text_length);
+  if (worker->sequences_allocated <= max_length) {
+    worker->sequences_allocated = 2*max_length+1;
+    worker->pattern = (char*) realloc(worker->pattern,worker->sequences_allocated);
+    worker->text = (char*) realloc(worker->text,worker->sequences_allocated);
+  }
+  candidate_packed_record_decode_pattern(record,worker->pattern);
+  candidate_packed_record_decode_text(record,worker->text);
+  worker->pattern[record->pattern_length] = '\0';
+  worker->text[record->text_length] = '\0';
+  worker->filter_input->pattern = worker->pattern;
+  worker->filter_input->text = worker->text;
+}
+void benchmark_pipeline_store_alignment(
+    benchmark_batch_t* const batch,
+    benchmark_candidate_t* const candidate,
+    filter_input_t* const filter_input) {
+  const int cigar_length = filter_input->cigar_length;
+  if (batch->cigars_used+cigar_length > batch->cigars_allocated) {
+    batch->cigars_allocated = 2*(batch->cigars_used+cigar_length);
+    batch->cigars = (char*) realloc(batch->cigars,batch->cigars_allocated);
+  }
+  candidate->text_begin = filter_input->text_begin;
+  candidate->text_end = filter_input->text_end;
+  candidate->cigar_offset = batch->cigars_used;
+  candidate->cigar_length = cigar_length;
+  memcpy(batch->cigars+batch->cigars_used,filter_input->cigar,cigar_length);
+  batch->cigars_used += cigar_length;
+}
+void* benchmark_pipeline_worker(void* const arg) {
+  benchmark_worker_t* const worker = (benchmark_worker_t*) arg;
+  benchmark_pipeline_t* const pipeline = worker->pipeline;
+  filter_input_t* const filter_input = worker->filter_input;
+  benchmark_batch_t* batch;
+  while ((batch=(benchmark_batch_t*)ring_buffer_pop(pipeline->input_batches)) != NULL) {
+    int i;
+    batch->cigars_used = 0;
+    for (i=0;i<batch->num_candidates;++i) {
+      benchmark_candidate_t* const candidate = batch->candidates + i;
+      filter_input->sequence_id = batch->first_sequence_id + i;
+      filter_input->packed_record = candidate->packed_record;
+      filter_input->pattern = candidate->pattern;
+      filter_input->pattern_length = candidate->pattern_length;
+      filter_input->text = candidate->text;
+      filter_input->text_length = candidate->text_length;
+      if (candidate->packed_record != NULL && pipeline->decode_packed) {
+        benchmark_pipeline_decode(worker,candidate->packed_record);
+      }
+      filter_input->max_error = candidate->max_error;
+      pipeline->filter(filter_input,candidate->bandwidth,pipeline->filter_arg);
+      candidate->bound = filter_input->bound;
+      candidate->accepted = filter_input->accepted;
+      if (filter_input->alignment) {
+        benchmark_pipeline_store_alignment(batch,candidate,filter_input);
+      }
+    }
+    ring_buffer_push(pipeline->output_batches,batch);
+  }
+  ring_buffer_push(pipeline->output_batches,NULL);
+  return NULL;
+}
+/*
+ * Run
+ *   Reads either the text @input or the @packed_input (if not NULL). Returns
+ *   the number of sequences processed. The timers and counters of the
+ *   workers are added to @filter_input (the filter time is the sum over workers).
+ *   The result of every candidate is written to @result_writer (if not NULL)
+ *   in input order (with the alignment of the best hit, if enabled in @filter_input)
+ */
+int benchmark_pipeline_run(
+    input_mmap_t* const input,
+    candidate_packed_file_t* const packed_input,
+    const float max_error,
+    const float bandwidth,
+    benchmark_filter_f const filter,
+    void* const filter_arg,
+    const bool decode_packed,
+    const int num_workers,
+    const int progress,
+    result_writer_t* const result_writer,
+    filter_input_t* const filter_input) {
+  // Setup
+  benchmark_pipeline_t pipeline;
+  pipeline.input = input;
+  pipeline.packed_input = packed_input;
+  pipeline.max_error = max_error;
+  pipeline.bandwidth = bandwidth;
+  pipeline.filter = filter;
+  pipeline.filter_arg = filter_arg;
+  pipeline.decode_packed = decode_packed;
+  pipeline.num_workers = MAX(num_workers,1);
+  pipeline.progress = progress;
+  pipeline.result_writer = result_writer;
+  benchmark_pipeline_init(&pipeline,filter_input);
+  profiler_timer_t timer;
+  timer_start(&timer);
+  // Launch
+  pthread_t reader_thread;
+  pthread_t* const worker_threads = (pthread_t*) malloc(pipeline.num_workers*sizeof(pthread_t));
+  benchmark_worker_t* const workers = (benchmark_worker_t*) malloc(pipeline.num_workers*sizeof(benchmark_worker_t));
+  pthread_create(&reader_thread,NULL,benchmark_pipeline_reader,&pipeline);
+  int i;
+  for (i=0;i<pipeline.num_workers;++i) {
+    workers[i].pipeline = &pipeline;
+    workers[i].filter_input = pipeline.worker_inputs + i;
+    workers[i].pattern = NULL;
+    workers[i].text = NULL;
+    workers[i].sequences_allocated = 0;
+    pthread_create(worker_threads+i,NULL,benchmark_pipeline_worker,workers+i);
+  }
+  // Aggregate in input order (at most num_batches are in flight, so the
+  // pending slot of a batch is given by its id)
+  benchmark_batch_t** const pending = (benchmark_batch_t**) calloc(pipeline.num_batches,sizeof(benchmark_batch_t*));
+  uint64_t next_batch_id = 0;
+  int finished_workers = 0, seq_processed = 0, next_progress = progress;
+  while (finished_workers < pipeline.num_workers) {
+    benchmark_batch_t* batch = (benchmark_batch_t*) ring_buffer_pop(pipeline.output_batches);
+    if (batch == NULL) {
+      ++finished_workers;
+      continue;
+    }
+    pending[batch->batch_id % pipeline.num_batches] = batch;
+    while ((batch=pending[next_batch_id % pipeline.num_batches]) != NULL && batch->batch_id == next_batch_id) {
+      pending[next_batch_id % pipeline.num_batches] = NULL;
+      // Output
+      if (result_writer != NULL && filter_input->alignment) {
+        for (i=0;i<batch->num_candidates;++i) {
+          const benchmark_candidate_t* const candidate = batch->candidates + i;
+          result_writer_add_alignment(result_writer,batch->first_sequence_id+i,
+              candidate->bound,candidate->accepted,candidate->text_begin,candidate->text_end,
+              batch->cigars+candidate->cigar_offset,candidate->cigar_length);
+        }
+      } else if (result_writer != NULL) {
+        for (i=0;i<batch->num_candidates;++i) {
+          result_writer_add(result_writer,batch->first_sequence_id+i,
+              batch->candidates[i].bound,batch->candidates[i].accepted);
+        }
+      }
+      seq_processed += batch->num_candidates;
+      // Update progress
+      if (progress > 0 && seq_processed >= next_progress) {
+        next_progress += progress;
+        const uint64_t time_elapsed = timer_elapsed_ns(&timer);
+        const float time_filter_rate = (float)seq_processed/(float)TIMER_CONVERT_NS_TO_S(time_elapsed);
+        fprintf(stderr,"...processed %d sequences (filter=%2.3f sequences/s)\n",seq_processed,time_filter_rate);
+      }
+      // Recycle
+      ring_buffer_push(pipeline.free_batches,batch);
+      ++next_batch_id;
+    }
+  }
+  // Join
+  pthread_join(reader_thread,NULL);
+  for (i=0;i<pipeline.num_workers;++i) {
+    pthread_join(worker_threads[i],NULL);
+  }
+  // Free
+  free(pending);
+  for (i=0;i<pipeline.num_workers;++i) {
+    free(workers[i].pattern);
+    free(workers[i].text);
+  }
+  free(workers);
+  free(worker_threads);
+  benchmark_pipeline_destroy(&pipeline,filter_input);
+  return seq_processed;
+}
@@ -0,0 +1,130 @@
+/*
+ *  Wavefront Alignments Algorithms
+ *  Copyright (c) 2020 by Santiago Marco-Sola  <santiagomsola@gmail.com>
+ *
+ *  This file is part of Wavefront Alignments Algorithms.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * PROJECT: Fast Mapping-Candidates Filtering Algorithms
+ * AUTHOR(S): Santiago Marco-Sola <santiagomsola@gmail.com>
+ * DESCRIPTION: Staged benchmark pipeline. A reader thread parses the input
+ *   into batches, N workers filter them, and the aggregator (caller thread)
+ *   collects them back in input order. Batches come from a fixed pool and
+ *   travel through lock-free rings, so memory is bounded and a slow stage
+ *   stalls the previous ones
+ */
+
+#ifndef BENCHMARK_PIPELINE_H_
+#define BENCHMARK_PIPELINE_H_
+
+#include "../utils/commons.h"
+#include "../utils/input_mmap.h"
+#include "../utils/candidate_packed.h"
+#include "../utils/result_writer.h"
+#include "../system/ring_buffer.h"
+#include "../benchmark/benchmark_utils.h"
+
+/*
+ * Configuration
+ */
+#define BENCHMARK_PIPELINE_BATCH_SIZE       256
+#define BENCHMARK_PIPELINE_BATCHES_WORKER     4   // Batches in flight per worker
+
+/*
+ * Filter of a candidate (runs in the workers)
+ */
+typedef void (*benchmark_filter_f)(
+    filter_input_t* const filter_input,
+    const int bandwidth,
+    void* const filter_arg);
+
+/*
+ * Batch of candidates (views of the input)
+ */
+typedef struct {
+  const candidate_packed_record_t* packed_record;
+  char* pattern;
+  int pattern_length;
+  char* text;
+  int text_length;
+  int max_error;
+  int bandwidth;
+  // Result
+  int bound;
+  bool accepted;
+  // Alignment (if enabled)
+  int text_begin;
+  int text_end;
+  uint64_t cigar_offset;         // In the CIGARs of the batch
+  int cigar_length;
+} benchmark_candidate_t;
+typedef struct {
+  uint64_t batch_id;             // Position in the input (in batches)
+  int first_sequence_id;
+  int num_candidates;
+  uint64_t input_end;            // End of the batch in the text input (views below it are
+                                 // not in use once the batch is recycled in order)
+  benchmark_candidate_t candidates[BENCHMARK_PIPELINE_BATCH_SIZE];
+  // CIGARs of the candidates (if the alignment is enabled)
+  char* cigars;
+  uint64_t cigars_used;
+  uint64_t cigars_allocated;
+} benchmark_batch_t;
+
+/*
+ * Pipeline
+ */
+typedef struct {
+  // Input
+  input_mmap_t* input;
+  candidate_packed_file_t* packed_input;
+  float max_error;
+  float bandwidth;
+  // Filter
+  benchmark_filter_f filter;
+  void* filter_arg;
+  bool decode_packed;            // The filter needs the characters of packed candidates
+  int num_workers;
+  // Output
+  result_writer_t* result_writer;  // Per-candidate results (NULL if disabled)
+  // Batches
+  benchmark_batch_t* batches;
+  int num_batches;
+  ring_buffer_t* free_batches;   // Aggregator -> Reader
+  ring_buffer_t* input_batches;  // Reader -> Workers
+  ring_buffer_t* output_batches; // Workers -> Aggregator
+  // Workers
+  filter_input_t* worker_inputs;
+  // Profile
+  int progress;
+} benchmark_pipeline_t;
+
+/*
+ * Run
+ */
+int benchmark_pipeline_run(
+    input_mmap_t* const input,
+    candidate_packed_file_t* const packed_input,
+    const float max_error,
+    const float bandwidth,
+    benchmark_filter_f const filter,
+    void* const filter_arg,
+    const bool decode_packed,
+    const int num_workers,
+    const int progress,
+    result_writer_t* const result_writer,
+    filter_input_t* const filter_input);
+
+#endif /* BENCHMARK_PIPELINE_H_ */
@@ -29,9 +29,59 @@
 void filter_input_clear(
     filter_input_t* const filter_input) {
   filter_input->sequence_id = 0;
+  filter_input->packed_record = NULL;
+  filter_input->bound = 0;
+  filter_input->accepted = false;
+  filter_input->alignment = false;
+  filter_input->text_begin = 0;
+  filter_input->text_end = 0;
+  filter_input->cigar = NULL;
+  filter_input->cigar_length = 0;
   filter_input->candidates_total = 0;
   filter_input->candidates_tp = 0;
   filter_input->candidates_fp = 0;
   filter_input->candidates_tn = 0;
   filter_input->candidates_fn = 0;
+  memset(&filter_input->workspace,0,sizeof(filter_workspace_t));
+}
+void filter_input_free_workspace(
+    filter_input_t* const filter_input) {
+  filter_workspace_t* const workspace = &filter_input->workspace;
+  if (workspace->bpm_pattern_compiled) {
+    edit_bpm_pattern_free(&workspace->bpm_pattern,filter_input->mm_allocator);
+  }
+  if (workspace->bpm_multi_pattern_compiled) {
+    edit_bpm_multi_pattern_free(&workspace->bpm_multi_pattern,filter_input->mm_allocator);
+  }
+  edit_column_free(&workspace->edit_column,filter_input->mm_allocator);
+  free(workspace->bpm_pattern_key);
+  free(workspace->tiles);
+  free(workspace->tile_lengths);
+  free(workspace->tile_distances);
+  free(workspace->text);
+  free(workspace->cigar);
+  memset(workspace,0,sizeof(filter_workspace_t));
+}
+/*
+ * Parameters
+ */
+int filter_input_max_error(
+    const float max_error,
+    const int pattern_length) {
+  if (max_error >= 1.0) {
+    return max_error;
+  } else {
+    return ceil(max_error*pattern_length);
+  }
+}
+int filter_input_bandwidth(
+    const float bandwidth,
+    const int pattern_length) {
+  if (bandwidth >= 1.0) {
+    return bandwidth;
+  } else if (bandwidth >= 0.0) {
+    return ceil(bandwidth*pattern_length);
+  } else {
+    return -1;
+  }
 }
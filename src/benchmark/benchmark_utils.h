@@ -27,6 +27,36 @@
 #include "../utils/commons.h"
 #include "../system/profiler_timer.h"
 #include "../system/mm_allocator.h"
+#include "../utils/candidate_packed.h"
+#include "../alignment/edit_bpm_distance.h"
+#include "../alignment/edit_bpm_multi.h"
+
+/*
+ * Filter Workspace (reused across the candidates filtered by a thread)
+ */
+typedef struct {
+  // BPM pattern (compiled once per read)
+  bpm_pattern_t bpm_pattern;
+  bool bpm_pattern_compiled;
+  uint8_t* bpm_pattern_key;          // Compiled pattern (characters, or packed bases and runs)
+  uint64_t bpm_pattern_key_length;
+  uint64_t bpm_pattern_key_allocated;
+  // BPM multi-pattern (tiles of the pattern; edit-bpm-tiled)
+  bpm_multi_pattern_t bpm_multi_pattern;
+  bool bpm_multi_pattern_compiled;
+  char** tiles;
+  int* tile_lengths;
+  int* tile_distances;
+  int tiles_allocated;
+  // DP columns (edit-dp and the accuracy check)
+  edit_column_t edit_column;
+  // Decoded text (packed texts with uncalled bases)
+  char* text;
+  uint64_t text_allocated;
+  // CIGAR of the best hit (run-length encoded)
+  char* cigar;
+  uint64_t cigar_allocated;
+} filter_workspace_t;
 
 /*
  * Filter Input
@@ -40,15 +70,29 @@ typedef struct {
   // Text
   char* text;
   int text_length;
+  // Packed candidate (NULL if the input is text)
+  const candidate_packed_record_t* packed_record;
   // Error
   int max_error;
+  // Result (of the last candidate filtered)
+  int bound;                         // Edit distance (or lower bound of it)
+  bool accepted;
+  // Alignment of the best hit (of the last candidate; edit-bpm)
+  bool alignment;                    // Enabled
+  int text_begin;
+  int text_end;
+  char* cigar;                       // Run-length encoded (workspace memory)
+  int cigar_length;
   // Profile
   profiler_timer_t timer;
+  profiler_timer_t timer_check;
   int candidates_total;
   int candidates_tp;
   int candidates_fp;
   int candidates_tn;
   int candidates_fn;
+  // Workspace
+  filter_workspace_t workspace;
   // MM
   mm_allocator_t* mm_allocator;
   // DEBUG
@@ -61,5 +105,17 @@ typedef struct {
  */
 void filter_input_clear(
     filter_input_t* const filter_input);
+void filter_input_free_workspace(
+    filter_input_t* const filter_input);
+
+/*
+ * Parameters (absolute if >= 1.0, else relative to the pattern length)
+ */
+int filter_input_max_error(
+    const float max_error,
+    const int pattern_length);
+int filter_input_bandwidth(
+    const float bandwidth,
+    const int pattern_length);
 
 #endif /* BENCHMARK_UTILS_H_ */
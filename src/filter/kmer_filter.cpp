@@ -98,6 +98,11 @@ void kmer_counting_destroy(
   mm_allocator_free(kmer_counting->mm_allocator,kmer_counting->kmer_count_text);
   mm_allocator_free(kmer_counting->mm_allocator,kmer_counting);
 }
+void kmer_counting_clear(
+    kmer_counting_nway_t* const kmer_counting) {
+  // Pattern profile (the text profile is cleared on every bound)
+  memset(kmer_counting->kmer_count_pattern,0,kmer_counting->num_kmers*sizeof(kmer_count_int_t));
+}
 /*
  * Pattern prepare
  * @param kmer_counting
@@ -190,5 +195,76 @@ uint64_t kmer_counting_min_bound(
   const uint64_t kmer_diff = kmer_counting->num_key_kmers - kmer_counting->max_text_kmers;
   return DIV_CEIL(kmer_diff,kmer_length);
 }
-
-
+/*
+ * Packed sequences
+ */
+#define KMER_COUNTING_PACKED_BASE(packed,position) \
+  (((packed)[(position)>>2] >> (6-2*((position)&3))) & 3)
+void kmer_counting_pattern_compute_histogram_packed(
+    kmer_counting_nway_t* const kmer_counting,
+    const uint8_t* const key,
+    const uint64_t key_length,
+    const uint32_t* const n_runs,
+    const uint64_t num_n_runs) {
+  // Parameters
+  kmer_count_int_t* const kmer_count_pattern = kmer_counting->kmer_count_pattern;
+  // Set key parameters
+  kmer_counting->key = (uint8_t*)key;
+  kmer_counting->key_length = key_length;
+  kmer_counting->num_key_kmers = key_length - (kmer_counting->kmer_length-1);
+  // Count until chunk end (the kmers that overlap an uncalled base are skipped)
+  uint64_t pos, kmer_idx = 0, acc = 0, run = 0;
+  for (pos=0;pos<key_length;++pos) {
+    if (run < num_n_runs && pos >= n_runs[2*run]) {
+      if (pos < n_runs[2*run] + n_runs[2*run+1]) {
+        acc = 0;
+        continue;
+      }
+      ++run;
+    }
+    KMER_COUNTING_ADD_INDEX__MASK(kmer_idx,KMER_COUNTING_PACKED_BASE(key,pos)); // Update kmer-index
+    if (acc < kmer_counting->kmer_length-1) {
+      ++acc; // Inc accumulator
+    } else {
+      ++(kmer_count_pattern[kmer_idx]);
+    }
+  }
+}
+uint64_t kmer_counting_min_bound_packed(
+    kmer_counting_nway_t* const kmer_counting,
+    const uint8_t* const text,
+    const uint64_t text_length,
+    const uint64_t max_error) {
+  // Parameters
+  const uint64_t kmer_length = kmer_counting->kmer_length;
+  kmer_count_int_t* const kmer_count_pattern = kmer_counting->kmer_count_pattern;
+  kmer_count_int_t* const kmer_count_text = kmer_counting->kmer_count_text;
+  uint64_t kmer_idx = 0, kmer_end, kmer_begin;
+  // Prepare filter
+  memset(kmer_counting->kmer_count_text,0,kmer_counting->num_kmers*sizeof(kmer_count_int_t));
+  // Prepare text
+  kmer_counting->max_text_kmers = 0;
+  kmer_counting->curr_text_kmers = 0;
+  // Initial fill (kmer). Uncalled bases are packed as A, as the text
+  // characters of kmer_counting_min_bound are filtered
+  for (kmer_end=0;kmer_end<kmer_length-1;++kmer_end) {
+    KMER_COUNTING_ADD_INDEX__MASK(kmer_idx,KMER_COUNTING_PACKED_BASE(text,kmer_end));
+  }
+  // Sliding window
+  for (kmer_begin=0;kmer_end<text_length;++kmer_begin,++kmer_end) {
+    // Fetch counters & store them in window
+    KMER_COUNTING_ADD_INDEX__MASK(kmer_idx,KMER_COUNTING_PACKED_BASE(text,kmer_end));
+    kmer_count_int_t* const text_count_ptr = kmer_count_text + kmer_idx;
+    const kmer_count_int_t text_count = *text_count_ptr;
+    const kmer_count_int_t pattern_count = kmer_count_pattern[kmer_idx];
+    // Increment kmer counts
+    if (pattern_count > 0 && text_count < pattern_count) {
+      ++(kmer_counting->curr_text_kmers);
+      kmer_counting->max_text_kmers = MAX(kmer_counting->max_text_kmers,kmer_counting->curr_text_kmers);
+    }
+    ++(*text_count_ptr);
+  }
+  // Compute min-error bound
+  const uint64_t kmer_diff = kmer_counting->num_key_kmers - kmer_counting->max_text_kmers;
+  return DIV_CEIL(kmer_diff,kmer_length);
+}
@@ -58,6 +58,8 @@ kmer_counting_nway_t* kmer_counting_new(
     mm_allocator_t* const mm_allocator);
 void kmer_counting_destroy(
     kmer_counting_nway_t* const kmer_counting);
+void kmer_counting_clear(
+    kmer_counting_nway_t* const kmer_counting);
 
 /*
  * Compile Pattern
@@ -76,4 +78,20 @@ uint64_t kmer_counting_min_bound(
     const uint64_t text_length,
     const uint64_t max_error);
 
+/*
+ * Packed sequences (2-bit, 4 bases per byte, first base in the MSBs).
+ * Uncalled bases of the pattern are given as (begin,length) runs
+ */
+void kmer_counting_pattern_compute_histogram_packed(
+    kmer_counting_nway_t* const kmer_counting,
+    const uint8_t* const key,
+    const uint64_t key_length,
+    const uint32_t* const n_runs,
+    const uint64_t num_n_runs);
+uint64_t kmer_counting_min_bound_packed(
+    kmer_counting_nway_t* const kmer_counting,
+    const uint8_t* const text,
+    const uint64_t text_length,
+    const uint64_t max_error);
+
 #endif /* KMER_FILTER_NWAY_H_ */
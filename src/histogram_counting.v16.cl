@@ -0,0 +1,73 @@
+/*
+ * Counting histograms (built with -DKMER_COUNTING).
+ * Instead of the presence bit of every kmer we keep a small saturating counter
+ * per bin, and the distance is the min-sum of kmer_counting_min_bound
+ * (the pattern kmers not covered by the text kmers). A saturated counter can
+ * only make the distance smaller, so the filter never rejects a candidate that
+ * the host counting filter accepts, and both accept the same candidates while
+ * no bin goes beyond KMER_COUNTER_MAX occurrences.
+ */
+#include "histogram_fixed.v16.cl"
+#include "kmer_counter.h"
+
+
+/**
+ * Compute the kmer counting histogram of a sequence
+ * @param seq packed sequences
+ * @param seqIdx index of the sequences (offset, length in bases)
+ * @param si index of the sequence
+ * @param h histogram (KMER_BINS counters)
+ */
+void computeCountingHistogram(__global unsigned char* restrict seq, __global unsigned int* restrict seqIdx, unsigned int si,
+        unsigned char* h)
+{
+    unsigned int offset = seqIdx[si*INDEX_SIZE + 0];
+    int len = seqIdx[si*INDEX_SIZE+1];         // length in bases
+
+    #pragma unroll
+    for (int c=0; c < KMER_BINS; c++)
+        h[c] = 0;
+
+    unsigned int v[SEQ_WORDS];
+
+    readBigEndianSequence(&seq[offset], v);
+
+    for (int i=0; i < (SEQ_LEN-KMER_K+1); i++)
+    {
+        unsigned int kmer_index = get_kmer_index(v, i);
+        int valid = (i <= (len - KMER_K));
+
+        if (valid && (h[kmer_index] < KMER_COUNTER_MAX))
+            h[kmer_index]++;
+    }
+}
+
+
+/**
+ * Number of pattern kmers that are not found in the text, divided by K
+ */
+unsigned int minSumDistance(unsigned char* hp, unsigned char* ht)
+{
+    int d = 0;
+
+    #pragma unroll
+    for (int c=0; c < KMER_BINS; c++)
+        d += (hp[c] > ht[c])? (hp[c] - ht[c]) : 0;
+
+    return (d+KMER_K-1)/KMER_K;
+}
+
+
+unsigned int computeCountingTask(__global unsigned char* restrict pattern , __global unsigned int* restrict patternIdx, unsigned int pi ,
+                         __global unsigned char* restrict text, __global unsigned int* restrict textIdx, unsigned int ti)
+{
+    unsigned char hp[KMER_BINS];
+    unsigned char ht[KMER_BINS];
+
+    computeCountingHistogram(pattern, patternIdx, pi, hp);
+    computeCountingHistogram(text, textIdx, ti, ht);
+
+    unsigned int d = minSumDistance(hp, ht);
+
+    return d;
+}
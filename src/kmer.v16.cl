@@ -1,20 +1,38 @@
 //#include "ihc_apint.h"
 
-#define WORKLOAD_TASK_SIZE  3
 #define INDEX_SIZE          2
 #define BASE_SIZE           2
 #define LOAD_BASES_ALIGNMENT_BITS   512
 
+// kmer length, a binary is built for every k in 3..7 (e.g. -DKMER_K=7)
+#ifndef KMER_K
 #define KMER_K          5
+#endif
 #define KMER_K_BITS     (KMER_K*BASE_SIZE)
 #define KMER_BINS       (1 << KMER_K_BITS)
 
-#define PATTERN_LEN      100
-#define TEXT_LEN         140 
+// length class of the kernel (maximum number of bases of pattern and text)
+#ifndef SEQ_LEN
+#define SEQ_LEN          256
+#endif
+
+// kernels are named kmer_k<K>_l<SEQ_LEN>, so that the host can reject a binary built for another k
+#define KMER_KERNEL_CAT(k,l)    kmer_k##k##_l##l
+#define KMER_KERNEL_XCAT(k,l)   KMER_KERNEL_CAT(k,l)
+#define KMER_KERNEL_NAME(l)     KMER_KERNEL_XCAT(KMER_K,l)
+
+#ifndef KMER_KERNEL
+#define KMER_KERNEL      KMER_KERNEL_NAME(SEQ_LEN)
+#endif
 
 unsigned int alignedSequenceSize(int bases);
 
+// presence bitmaps by default, counting histograms with -DKMER_COUNTING
+#ifdef KMER_COUNTING
+#include "histogram_counting.v16.cl"
+#else
 #include "histogram_fixed.v16.cl"
+#endif
 
 /**
  * Compute the number of bytes required to store the number of bases, considering
@@ -31,52 +49,100 @@ unsigned int alignedSequenceSize(int bases)
     return lenAlignedUnitsBytes;
 }
 
+/**
+ * Result modes. In RESULT_BOUNDS the kernel returns the bound of every task
+ * saturated to 8 bits (4 tasks per word, the first one in the lower byte). In
+ * RESULT_ACCEPT it returns one bit per task (32 tasks per word, the first one
+ * in the lower bit), set if the bound is not greater than the max error of the
+ * task
+ */
+#define RESULT_BOUNDS       0
+#define RESULT_ACCEPT       1
+
+// tasks per result word
+#define RESULT_TASKS_PER_WORD(mode)     (((mode) == RESULT_ACCEPT)? 32 : 4)
+
+// work-item slices are aligned to this number of tasks, so that no result word is shared
+#define RESULT_ALIGNMENT    32
+
 /**
  * from version 11 we assume that pattern index, and text index is the same worload index  
  */
-void doWorkloadTask(__global unsigned char* restrict pattern , __global unsigned int* restrict patternIdx, 
+unsigned int doWorkloadTask(__global unsigned char* restrict pattern , __global unsigned int* restrict patternIdx, 
                     __global unsigned char* restrict text, __global unsigned int* restrict textIdx,
-                    /*__global*/ unsigned int* workload, unsigned int wi, unsigned int li)
+                    __global unsigned char* restrict maxError, unsigned int wi, unsigned int resultMode)
 {
     unsigned int pi = wi; // workload[wi*WORKLOAD_TASK_SIZE+0];
     unsigned int ti = wi; // workload[wi*WORKLOAD_TASK_SIZE+1];
 
     
+#ifdef KMER_COUNTING
+    unsigned int d = computeCountingTask(pattern, patternIdx, pi, text, textIdx, ti);
+#else
     unsigned int d = computeTask(pattern, patternIdx, pi, text, textIdx, ti);
+#endif
     
 #ifdef FPGA_DEBUG
     printf("[FPGA] pi=%d  ti=%d ", pi, ti);
     printf(" task %d = %d\n", wi, d);
 #endif
     
-    //workload[wi*WORKLOAD_TASK_SIZE+2] = d;
-    workload[li] = d;
+    if (resultMode == RESULT_ACCEPT)
+        return (d <= maxError[wi])? 1 : 0;
+    
+    return min(d, 255u);
 }
 
 
-__kernel void kmer(__global unsigned char* restrict pattern ,
+/**
+ * From version 18 the workload range is partitioned across the work-items
+ * (work-groups of one item, distributed over the compute units). Every
+ * work-item computes a contiguous slice of [workloadBegin, workloadEnd), so
+ * the host can also enqueue one range per compute unit on separate queues.
+ * 
+ * From version 19 the results are packed in words (see RESULT_BOUNDS and
+ * RESULT_ACCEPT). workloadBegin must be a multiple of RESULT_ALIGNMENT
+ */
+__kernel void KMER_KERNEL(__global unsigned char* restrict pattern ,
 		   __global unsigned int* restrict patternIdx, 
                    __global unsigned char* restrict text,
 		   __global unsigned int* restrict textIdx,
-                   __global unsigned int* workload, 
-		   unsigned int workloadLength)
+                   __global unsigned char* restrict maxError,
+                   __global unsigned int* restrict result, 
+		   unsigned int workloadBegin,
+		   unsigned int workloadEnd,
+		   unsigned int resultMode)
 {
 	#define WORKLOAD_CHUNK 1024*16
-	unsigned int workload_result[WORKLOAD_CHUNK];
+	unsigned int chunk_result[WORKLOAD_CHUNK/4];
+	
+    unsigned int items = get_global_size(0);
+    unsigned int item = get_global_id(0);
+    unsigned int slice = (workloadEnd - workloadBegin + items - 1) / items;
+    slice = ((slice + RESULT_ALIGNMENT - 1) / RESULT_ALIGNMENT) * RESULT_ALIGNMENT;
+    unsigned int sliceBegin = workloadBegin + item * slice;
+    unsigned int sliceEnd = min(sliceBegin + slice, workloadEnd);
+    
+    unsigned int perWord = RESULT_TASKS_PER_WORD(resultMode);
+    unsigned int bitsPerTask = 32 / perWord;
 	
-    for (int i=0; i < workloadLength; /*i++*/)
+    for (unsigned int i=sliceBegin; i < sliceEnd; /*i++*/)
     {
-    	int base_i = i;
+    	unsigned int base_i = i;
         int li;
+        
+        for (int w=0; w < WORKLOAD_CHUNK/4; w++)
+            chunk_result[w] = 0;
 	
     	// compute to local memory
-    	for (li=0; (li < WORKLOAD_CHUNK) && (i < workloadLength); li++, i++)
+    	for (li=0; (li < WORKLOAD_CHUNK) && (i < sliceEnd); li++, i++)
 	{
-	   doWorkloadTask(pattern, patternIdx, text, textIdx, workload_result, i, li);
+	   unsigned int r = doWorkloadTask(pattern, patternIdx, text, textIdx, maxError, i, resultMode);
+	   chunk_result[li / perWord] |= r << ((li % perWord) * bitsPerTask);
 	}
 		
 	// transfer the results back to the main table
-	for (int ti=0; ti < li; ti++)
-		workload[(base_i + ti)*WORKLOAD_TASK_SIZE+2] = workload_result[ti];
+	for (int w=0; w < (li + perWord - 1) / perWord; w++)
+		result[base_i / perWord + w] = chunk_result[w];
      }
 }
@@ -0,0 +1,15 @@
+/*
+ * Width of the saturating kmer counters of the counting histograms.
+ * Shared by the kernels (histogram_counting.v16.cl) and the host model
+ * (tools/KmerKernelModel.cpp), so both must be built with the same
+ * -DKMER_COUNTER_BITS=<n> to change it.
+ */
+#ifndef KMER_COUNTER_H
+#define KMER_COUNTER_H
+
+#ifndef KMER_COUNTER_BITS
+#define KMER_COUNTER_BITS   4
+#endif
+#define KMER_COUNTER_MAX    ((1 << KMER_COUNTER_BITS) - 1)
+
+#endif /* KMER_COUNTER_H */
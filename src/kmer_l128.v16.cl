@@ -0,0 +1,7 @@
+/*
+ * kmer kernel for the sequences of up to 128 bases
+ */
+#define SEQ_LEN          128
+#define KMER_KERNEL      KMER_KERNEL_NAME(128)
+
+#include "kmer.v16.cl"
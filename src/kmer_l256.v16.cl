@@ -0,0 +1,7 @@
+/*
+ * kmer kernel for the sequences of up to 256 bases
+ */
+#define SEQ_LEN          256
+#define KMER_KERNEL      KMER_KERNEL_NAME(256)
+
+#include "kmer.v16.cl"
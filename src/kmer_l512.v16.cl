@@ -0,0 +1,7 @@
+/*
+ * kmer kernel for the sequences of up to 512 bases
+ */
+#define SEQ_LEN          512
+#define KMER_KERNEL      KMER_KERNEL_NAME(512)
+
+#include "kmer.v16.cl"
@@ -0,0 +1,7 @@
+/*
+ * kmer kernel for the sequences of up to 64 bases
+ */
+#define SEQ_LEN          64
+#define KMER_KERNEL      KMER_KERNEL_NAME(64)
+
+#include "kmer.v16.cl"
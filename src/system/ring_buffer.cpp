@@ -0,0 +1,152 @@
+/*
+ *  Wavefront Alignments Algorithms
+ *  Copyright (c) 2020 by Santiago Marco-Sola  <santiagomsola@gmail.com>
+ *
+ *  This file is part of Wavefront Alignments Algorithms.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * PROJECT: Wavefront Alignments Algorithms
+ * AUTHOR(S): Santiago Marco-Sola <santiagomsola@gmail.com>
+ * DESCRIPTION: Bounded lock-free ring buffer of pointers (multiple producers,
+ *   multiple consumers)
+ */
+
+#include "ring_buffer.h"
+
+#include <sched.h>
+#include <time.h>
+
+/*
+ * Backoff of the blocking operations
+ */
+#define RING_BUFFER_SPINS   64
+#define RING_BUFFER_YIELDS  64
+#define RING_BUFFER_SLEEP_NS 50000
+
+/*
+ * Setup
+ */
+ring_buffer_t* ring_buffer_new(
+    const uint64_t min_capacity) {
+  // Round up the capacity to a power of 2
+  uint64_t capacity = 2;
+  while (capacity < min_capacity) capacity <<= 1;
+  // Allocate
+  ring_buffer_t* ring_buffer;
+  if (posix_memalign((void**)&ring_buffer,RING_BUFFER_CACHE_LINE,sizeof(ring_buffer_t)) != 0 ||
+      posix_memalign((void**)&ring_buffer->cells,RING_BUFFER_CACHE_LINE,capacity*sizeof(ring_buffer_cell_t)) != 0) {
+    fprintf(stderr,"Could not create new ring buffer (%" PRIu64 " elements requested)\n",capacity);
+    exit(1);
+  }
+  ring_buffer->mask = capacity-1;
+  // Cell i is free for the producer of position i
+  uint64_t i;
+  for (i=0;i<capacity;++i) {
+    ring_buffer->cells[i].sequence = i;
+    ring_buffer->cells[i].element = NULL;
+  }
+  ring_buffer->enqueue_position = 0;
+  ring_buffer->dequeue_position = 0;
+  return ring_buffer;
+}
+void ring_buffer_delete(
+    ring_buffer_t* const ring_buffer) {
+  free(ring_buffer->cells);
+  free(ring_buffer);
+}
+/*
+ * Non-blocking operations
+ */
+bool ring_buffer_try_push(
+    ring_buffer_t* const ring_buffer,
+    void* const element) {
+  ring_buffer_cell_t* cell;
+  uint64_t position = __atomic_load_n(&ring_buffer->enqueue_position,__ATOMIC_RELAXED);
+  while (true) {
+    cell = ring_buffer->cells + (position & ring_buffer->mask);
+    const uint64_t sequence = __atomic_load_n(&cell->sequence,__ATOMIC_ACQUIRE);
+    const int64_t diff = (int64_t)sequence - (int64_t)position;
+    if (diff == 0) {
+      // The cell is free, claim it
+      if (__atomic_compare_exchange_n(&ring_buffer->enqueue_position,&position,position+1,
+          true,__ATOMIC_RELAXED,__ATOMIC_RELAXED)) break;
+    } else if (diff < 0) {
+      return false; // Full
+    } else {
+      position = __atomic_load_n(&ring_buffer->enqueue_position,__ATOMIC_RELAXED);
+    }
+  }
+  cell->element = element;
+  __atomic_store_n(&cell->sequence,position+1,__ATOMIC_RELEASE);
+  return true;
+}
+bool ring_buffer_try_pop(
+    ring_buffer_t* const ring_buffer,
+    void** const element) {
+  ring_buffer_cell_t* cell;
+  uint64_t position = __atomic_load_n(&ring_buffer->dequeue_position,__ATOMIC_RELAXED);
+  while (true) {
+    cell = ring_buffer->cells + (position & ring_buffer->mask);
+    const uint64_t sequence = __atomic_load_n(&cell->sequence,__ATOMIC_ACQUIRE);
+    const int64_t diff = (int64_t)sequence - (int64_t)(position+1);
+    if (diff == 0) {
+      // The cell is full, claim it
+      if (__atomic_compare_exchange_n(&ring_buffer->dequeue_position,&position,position+1,
+          true,__ATOMIC_RELAXED,__ATOMIC_RELAXED)) break;
+    } else if (diff < 0) {
+      return false; // Empty
+    } else {
+      position = __atomic_load_n(&ring_buffer->dequeue_position,__ATOMIC_RELAXED);
+    }
+  }
+  *element = cell->element;
+  // Free the cell for the producer of the next lap
+  __atomic_store_n(&cell->sequence,position+ring_buffer->mask+1,__ATOMIC_RELEASE);
+  return true;
+}
+/*
+ * Blocking operations
+ */
+void ring_buffer_backoff(
+    uint64_t* const attempts) {
+  const uint64_t attempt = (*attempts)++;
+  if (attempt < RING_BUFFER_SPINS) {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#endif
+  } else if (attempt < RING_BUFFER_SPINS+RING_BUFFER_YIELDS) {
+    sched_yield();
+  } else {
+    struct timespec sleep_time = {0,RING_BUFFER_SLEEP_NS};
+    nanosleep(&sleep_time,NULL);
+  }
+}
+void ring_buffer_push(
+    ring_buffer_t* const ring_buffer,
+    void* const element) {
+  uint64_t attempts = 0;
+  while (!ring_buffer_try_push(ring_buffer,element)) {
+    ring_buffer_backoff(&attempts);
+  }
+}
+void* ring_buffer_pop(
+    ring_buffer_t* const ring_buffer) {
+  uint64_t attempts = 0;
+  void* element;
+  while (!ring_buffer_try_pop(ring_buffer,&element)) {
+    ring_buffer_backoff(&attempts);
+  }
+  return element;
+}
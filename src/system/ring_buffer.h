@@ -0,0 +1,85 @@
+/*
+ *  Wavefront Alignments Algorithms
+ *  Copyright (c) 2020 by Santiago Marco-Sola  <santiagomsola@gmail.com>
+ *
+ *  This file is part of Wavefront Alignments Algorithms.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * PROJECT: Wavefront Alignments Algorithms
+ * AUTHOR(S): Santiago Marco-Sola <santiagomsola@gmail.com>
+ * DESCRIPTION: Bounded lock-free ring buffer of pointers (multiple producers,
+ *   multiple consumers). Every cell carries a sequence number that tells
+ *   producers and consumers whose turn it is (D. Vyukov's bounded MPMC queue),
+ *   so a single CAS on the head/tail claims a cell. Also used for SPSC links
+ */
+
+#ifndef RING_BUFFER_H_
+#define RING_BUFFER_H_
+
+#include "../utils/commons.h"
+
+/*
+ * Cache line (head, tail and cells are kept apart to avoid false sharing)
+ */
+#define RING_BUFFER_CACHE_LINE 64
+
+/*
+ * Ring Buffer
+ */
+typedef struct {
+  uint64_t sequence;
+  void* element;
+  uint8_t padding[RING_BUFFER_CACHE_LINE-sizeof(uint64_t)-sizeof(void*)];
+} ring_buffer_cell_t;
+typedef struct {
+  // Cells
+  ring_buffer_cell_t* cells;
+  uint64_t mask;                   // Capacity-1 (capacity is a power of 2)
+  uint8_t padding0[RING_BUFFER_CACHE_LINE-sizeof(void*)-sizeof(uint64_t)];
+  // Positions
+  uint64_t enqueue_position;
+  uint8_t padding1[RING_BUFFER_CACHE_LINE-sizeof(uint64_t)];
+  uint64_t dequeue_position;
+  uint8_t padding2[RING_BUFFER_CACHE_LINE-sizeof(uint64_t)];
+} ring_buffer_t;
+
+/*
+ * Setup
+ */
+ring_buffer_t* ring_buffer_new(
+    const uint64_t min_capacity);
+void ring_buffer_delete(
+    ring_buffer_t* const ring_buffer);
+
+/*
+ * Non-blocking operations (return false if full/empty)
+ */
+bool ring_buffer_try_push(
+    ring_buffer_t* const ring_buffer,
+    void* const element);
+bool ring_buffer_try_pop(
+    ring_buffer_t* const ring_buffer,
+    void** const element);
+
+/*
+ * Blocking operations (spin, then yield, then sleep)
+ */
+void ring_buffer_push(
+    ring_buffer_t* const ring_buffer,
+    void* const element);
+void* ring_buffer_pop(
+    ring_buffer_t* const ring_buffer);
+
+#endif /* RING_BUFFER_H_ */
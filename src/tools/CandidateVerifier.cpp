@@ -0,0 +1,223 @@
+/*
+ * Copyright (C) 2020 Universitat Autonoma de Barcelona - David Castells-Rufas <david.castells@uab.cat>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+/*
+ * File:   CandidateVerifier.cpp
+ * Author: dcr
+ */
+
+#include "CandidateVerifier.h"
+#include "../alignment/edit_bpm_batch.h"
+#include "../alignment/edit_dp.h"
+#include "../utils/dna_text.h"
+
+#include <thread>
+#include <vector>
+
+#define VERIFIER_CHUNK      256
+#define VERIFIER_SAMPLE_SEED 0x9E3779B97F4A7C15ull
+
+CandidateVerifier::CandidateVerifier(FPGAKmerFilter* inputs, int threads, double rejectSampling)
+{
+    m_inputs = inputs;
+    m_threads = MAX(threads, 1);
+    m_rejectStride = (rejectSampling > 0)? MAX((int) (1.0 / rejectSampling + 0.5), 1) : 0;
+    m_verbose = false;
+}
+
+CandidateVerifier::~CandidateVerifier()
+{
+}
+
+bool CandidateVerifier::nextChunk(int* first, int* count)
+{
+    lock_guard<mutex> lock(m_mutex);
+
+    if (m_next >= m_total)
+        return false;
+
+    *first = m_next;
+    *count = MIN(VERIFIER_CHUNK, m_total - m_next);
+    m_next += *count;
+
+    return true;
+}
+
+/**
+ * Decide if a rejected candidate is verified. The index is hashed (seeded
+ * splitmix64 finalizer) so that the sample does not follow any periodic
+ * layout of the inputs (e.g. candidates grouped by read)
+ */
+bool CandidateVerifier::sampleRejected(int i)
+{
+    if (m_rejectStride == 0)
+        return false;
+
+    uint64_t h = (uint64_t) i + VERIFIER_SAMPLE_SEED;
+    h = (h ^ (h >> 30)) * 0xBF58476D1CE4E5B9ull;
+    h = (h ^ (h >> 27)) * 0x94D049BB133111EBull;
+    h = h ^ (h >> 31);
+
+    return (h % m_rejectStride) == 0;
+}
+
+/**
+ * Decide if the edit distance is within the max error, for the candidates
+ * that are not verified with BPM (see worker). The DP columns of the worker
+ * are reused
+ */
+bool CandidateVerifier::withinMaxError(const string& pattern, const string& text, int maxError,
+        edit_column_t* edit_column, mm_allocator_t* mm_allocator)
+{
+    if (maxError >= pattern.size())
+        return true;
+
+    edit_column_resize(edit_column, pattern.size(), text.size(), mm_allocator);
+    int distance = edit_dp_distance_cutoff(edit_column, pattern.c_str(), pattern.size(),
+            text.c_str(), text.size(), maxError);
+
+    return (distance <= maxError);
+}
+
+void CandidateVerifier::worker(unsigned int* bounds)
+{
+    mm_allocator_t* const mm_allocator = mm_allocator_new(BUFFER_SIZE_8M);
+    edit_column_t edit_column;
+    edit_column_init(&edit_column);
+    int tp = 0, fp = 0, tn = 0, fn = 0;
+    int rejected = 0, rejectedVerified = 0;
+    int first, count;
+
+    // candidates of the chunk verified with BPM (the sequences are kept alive for the batch)
+    vector<string> patterns(VERIFIER_CHUNK), texts(VERIFIER_CHUNK);
+    vector<bpm_batch_candidate_t> batch(VERIFIER_CHUNK);
+    vector<bool> batchAccepted(VERIFIER_CHUNK);
+
+    while (nextChunk(&first, &count))
+    {
+        int batched = 0;
+
+        for (int i=first; i < first+count; i++)
+        {
+            int maxError = m_inputs->getMaxError(i);
+            bool accepted = (bounds[i] <= maxError);
+
+            if (!accepted)
+            {
+                rejected++;
+
+                if (!sampleRejected(i))
+                    continue;
+
+                rejectedVerified++;
+            }
+
+            patterns[batched] = m_inputs->getPattern(i);
+            texts[batched] = m_inputs->getText(i);
+            const string& pattern = patterns[batched];
+
+            // BPM does not match uncalled bases, so patterns with N are
+            // verified with the DP (as benchmark_check does)
+            if (maxError >= pattern.size() || pattern.find(DNA_CHAR_N) != string::npos)
+            {
+                bool within = withinMaxError(pattern, texts[batched], maxError, &edit_column, mm_allocator);
+
+                if (accepted)
+                    (within)? tp++ : fp++;
+                else
+                    (within)? fn++ : tn++;
+
+                continue;
+            }
+
+            bpm_batch_candidate_t& candidate = batch[batched];
+            candidate.pattern = (char*) pattern.c_str();
+            candidate.pattern_length = pattern.size();
+            candidate.text = (char*) texts[batched].c_str();
+            candidate.text_length = texts[batched].size();
+            candidate.max_distance = maxError;
+            batchAccepted[batched] = accepted;
+            batched++;
+        }
+
+        edit_bpm_distance_batch_compute(&batch[0], batched, mm_allocator);
+
+        for (int j=0; j < batched; j++)
+        {
+            bool within = (batch[j].distance <= batch[j].max_distance);
+
+            if (batchAccepted[j])
+                (within)? tp++ : fp++;
+            else
+                (within)? fn++ : tn++;
+        }
+    }
+
+    edit_column_free(&edit_column, mm_allocator);
+    mm_allocator_delete(mm_allocator);
+
+    lock_guard<mutex> lock(m_mutex);
+
+    m_tp += tp;
+    m_fp += fp;
+    m_tn += tn;
+    m_fn += fn;
+    m_rejected += rejected;
+    m_rejectedVerified += rejectedVerified;
+}
+
+/**
+ * Verify the bounds of all the inputs and add the results to the counters
+ * of the filter input. The time is accounted in filter_input->timer_check
+ * @param filter_input
+ * @param bounds the bound of every input
+ */
+void CandidateVerifier::verifyAll(filter_input_t* const filter_input, unsigned int* bounds)
+{
+    m_next = 0;
+    m_total = m_inputs->getInputCount();
+    m_tp = m_fp = m_tn = m_fn = 0;
+    m_rejected = m_rejectedVerified = 0;
+
+    timer_start(&filter_input->timer_check);
+
+    vector<thread> workers;
+
+    for (int i=0; i < m_threads; i++)
+        workers.push_back(thread(&CandidateVerifier::worker, this, bounds));
+
+    for (int i=0; i < workers.size(); i++)
+        workers[i].join();
+
+    timer_stop(&filter_input->timer_check);
+
+    // extrapolate the sampled rejects
+    double scale = (m_rejectedVerified > 0)? (double) m_rejected / m_rejectedVerified : 0;
+    int fn = (int) (m_fn * scale + 0.5);
+    int tn = m_rejected - fn;
+
+    filter_input->candidates_total += m_total;
+    filter_input->candidates_tp += m_tp;
+    filter_input->candidates_fp += m_fp;
+    filter_input->candidates_tn += tn;
+    filter_input->candidates_fn += fn;
+
+    if (m_verbose)
+        printf("[CHECK] %d accepted and %d of %d rejected candidates verified (%d threads, %s BPM)\n",
+                m_tp + m_fp, m_rejectedVerified, m_rejected, m_threads, edit_bpm_batch_instruction_set());
+}
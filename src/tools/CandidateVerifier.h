@@ -0,0 +1,77 @@
+/*
+ * Copyright (C) 2020 Universitat Autonoma de Barcelona - David Castells-Rufas <david.castells@uab.cat>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+/*
+ * File:   CandidateVerifier.h
+ * Author: dcr
+ *
+ * Accuracy check of the bounds computed by the device (or the hybrid filter).
+ * Candidates are verified in parallel host threads with BPM (with cutoff at
+ * the max error), several candidates per vector (see edit_bpm_batch.h).
+ * All the accepted candidates are verified, but only a sampled fraction of
+ * the rejected ones, and the TN/FN counts are extrapolated from the sample.
+ */
+
+#ifndef CANDIDATEVERIFIER_H
+#define CANDIDATEVERIFIER_H
+
+#include "FPGAKmerFilter.h"
+
+#include <mutex>
+
+using namespace std;
+
+class CandidateVerifier
+{
+public:
+    CandidateVerifier(FPGAKmerFilter* inputs, int threads, double rejectSampling);
+    virtual ~CandidateVerifier();
+
+public:
+    void verifyAll(filter_input_t* const filter_input, unsigned int* bounds);
+
+private:
+    bool nextChunk(int* first, int* count);
+    bool sampleRejected(int i);
+    void worker(unsigned int* bounds);
+    bool withinMaxError(const string& pattern, const string& text, int maxError,
+            edit_column_t* edit_column, mm_allocator_t* mm_allocator);
+
+public:
+    bool m_verbose;
+
+private:
+    FPGAKmerFilter* m_inputs;
+    int m_threads;
+    int m_rejectStride;         // about one of every m_rejectStride rejected candidates is verified
+
+    mutex m_mutex;
+    int m_next;
+    int m_total;
+
+    // results of the verified candidates
+    int m_tp;
+    int m_fp;
+    int m_tn;
+    int m_fn;
+    int m_rejected;             // all the rejected candidates
+    int m_rejectedVerified;
+};
+
+#endif /* CANDIDATEVERIFIER_H */
+
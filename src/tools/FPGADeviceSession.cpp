@@ -0,0 +1,357 @@
+/*
+ * Copyright (C) 2020 Universitat Autonoma de Barcelona - David Castells-Rufas <david.castells@uab.cat>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+/*
+ * File:   FPGADeviceSession.cpp
+ * Author: dcr
+ */
+
+#include "FPGADeviceSession.h"
+#include "PerformanceLap.h"
+#include "TextUtils.h"
+#include "../utils/commons.h"
+
+#include <fcntl.h>
+#include <limits.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+const int kmerLengthClass[KMER_LENGTH_CLASSES] = {64, 128, 256, 512};
+
+/**
+ * Directory that contains the running executable
+ */
+static string exeDir()
+{
+    char path[PATH_MAX];
+    ssize_t n = readlink("/proc/self/exe", path, sizeof(path) - 1);
+
+    if (n == -1)
+        return ".";
+
+    path[n] = 0;
+
+    char* slash = strrchr(path, '/');
+
+    if (slash != NULL)
+        *slash = 0;
+
+    return path;
+}
+
+FPGADeviceSession::FPGADeviceSession()
+{
+    m_verbose = false;
+    m_computeUnits = 0;
+    m_cuQueues = false;
+    m_open = false;
+    m_cuQueueCount = 0;
+    m_program = NULL;
+    m_kmerLength = 0;
+    m_counting = false;
+
+    for (int c=0; c < KMER_LENGTH_CLASSES; c++)
+        m_kmerKernel[c] = NULL;
+}
+
+FPGADeviceSession::~FPGADeviceSession()
+{
+    close();
+}
+
+/**
+ * Select the device and create the context and the queues.
+ * Calling it again on an open session has no effect
+ */
+void FPGADeviceSession::open(int platform_id)
+{
+    if (m_open)
+        return;
+
+    if (m_verbose)
+        cout << "[OCLFPGA] initialization (version compiled "  << __DATE__  << " "  << __TIME__ << ")" << endl;
+
+    try
+    {
+        m_platform = selectPlatform(platform_id);
+
+        if (m_verbose)
+            cout << "[*] Platform Selected [OK] " << getPlatformName(m_platform) << endl;
+
+        m_deviceId = selectDevice(m_platform, 0);
+
+        if (m_verbose)
+            cout << "[*] Device Selected [OK] " << endl;
+
+        m_context = createContext(m_platform, m_deviceId);
+
+        if (m_verbose)
+            cout << "[*] Context Created [OK] " << endl;
+
+        m_queue = createQueue(m_deviceId, m_context, 0);
+
+        if (m_verbose)
+            cout << "[*] Queue Created [OK] " << endl;
+
+        if (m_computeUnits <= 0)
+        {
+            cl_uint cus;
+            cl_int err = clGetDeviceInfo(m_deviceId, CL_DEVICE_MAX_COMPUTE_UNITS, sizeof(cus), &cus, NULL);
+            SAMPLE_CHECK_ERRORS(err);
+            m_computeUnits = cus;
+        }
+
+        m_cuQueueCount = 0;
+
+        if (m_cuQueues)
+        {
+            m_computeUnits = MIN(m_computeUnits, KMER_MAX_CU_QUEUES);
+
+            for (; m_cuQueueCount < m_computeUnits; m_cuQueueCount++)
+                m_cuQueue[m_cuQueueCount] = createQueue(m_deviceId, m_context, 0);
+        }
+
+        if (m_verbose)
+            cout << "[*] Compute units: " << m_computeUnits << ((m_cuQueues)? " (one queue each)" : "") << endl;
+    }
+    catch (Error& err)
+    {
+        printf("%s\n", err.what());
+        exit(1);
+    }
+
+    m_open = true;
+}
+
+/**
+ * Find the binary for the kmer length.
+ * A binary is built for every k (kmer.<type>.k<K>.xclbin). If it does not exist
+ * we fall back to kmer.<type>.xclbin, but the kernels must have been compiled
+ * for the same k (kernels are named kmer_k<K>_l<LEN>)
+ * @param binaryDir directory of the binaries, if empty the parent of the
+ * directory of the executable
+ */
+string FPGADeviceSession::findBinary(string binaryDir, string openCLKernelType, int kmerLength)
+{
+    if (binaryDir.empty())
+        binaryDir = exeDir() + "/..";
+
+    string path = binaryDir + format("/kmer.%s.k%d.xclbin", openCLKernelType.c_str(), kmerLength);
+
+    if (access(path.c_str(), R_OK) != 0)
+        path = binaryDir + format("/kmer.%s.xclbin", openCLKernelType.c_str());
+
+    return path;
+}
+
+/**
+ * Load the binary and create the kernels of the length classes for k.
+ * The file is memory-mapped and handed to the runtime without copies. If
+ * the same binary is already loaded for the same k nothing is done
+ * @param counting true if the binary is built with KMER_COUNTING
+ */
+void FPGADeviceSession::loadBinary(string path, int kmerLength, bool counting)
+{
+    if (kmerLength < KMER_K_MIN || kmerLength > KMER_K_MAX)
+    {
+        fprintf(stderr, "[OCLFPGA] Invalid k-mer length %d for the device (supported %d..%d)\n", kmerLength, KMER_K_MIN, KMER_K_MAX);
+        exit(1);
+    }
+
+    if (m_program != NULL && path == m_binaryPath && kmerLength == m_kmerLength)
+        return;
+
+    releaseProgram();
+
+    PerformanceLap lap;
+    lap.start();
+
+    if (m_verbose)
+        printf("[OCLFPGA] Loading %s\n", path.c_str());
+
+    int fd = ::open(path.c_str(), O_RDONLY);
+
+    if (fd < 0)
+        throw Error(format("Failed to open binary file %s", path.c_str()));
+
+    struct stat st;
+
+    if (fstat(fd, &st) != 0 || st.st_size == 0)
+    {
+        ::close(fd);
+        throw Error(format("Failed to stat binary file %s", path.c_str()));
+    }
+
+    size_t binarySize = st.st_size;
+    void* binary = mmap(NULL, binarySize, PROT_READ, MAP_PRIVATE, fd, 0);
+
+    ::close(fd);
+
+    if (binary == MAP_FAILED)
+        throw Error(format("Failed to map binary file %s", path.c_str()));
+
+    cl_int ret;
+    cl_int status;
+    const unsigned char* binaries[1] = { (const unsigned char*) binary };
+
+    m_program = clCreateProgramWithBinary(m_context, 1, &m_deviceId, &binarySize, binaries, &status, &ret);
+
+    munmap(binary, binarySize);
+
+    SAMPLE_CHECK_ERRORS(ret);
+
+    ret = clBuildProgram(m_program, 1, &m_deviceId, NULL, NULL, NULL);
+
+    // the build log is only fetched when it is going to be shown
+    if (ret != CL_SUCCESS || m_verbose)
+    {
+        size_t log_size;
+        clGetProgramBuildInfo(m_program, m_deviceId, CL_PROGRAM_BUILD_LOG, 0, NULL, &log_size);
+
+        char* log = (char*) malloc(log_size);
+        clGetProgramBuildInfo(m_program, m_deviceId, CL_PROGRAM_BUILD_LOG, log_size, log, NULL);
+
+        printf("%s\n", log);
+        free(log);
+    }
+
+    SAMPLE_CHECK_ERRORS(ret);
+
+    // a binary may not contain all the length classes, the missing ones are computed in the host
+    int kernelsFound = 0;
+
+    for (int c=0; c < KMER_LENGTH_CLASSES; c++)
+    {
+        string kernelName = format("kmer_k%d_l%d", kmerLength, kmerLengthClass[c]);
+
+        m_kmerKernel[c] = clCreateKernel(m_program, kernelName.c_str(), &ret);
+
+        if (ret != CL_SUCCESS)
+            m_kmerKernel[c] = NULL;
+        else
+            kernelsFound++;
+
+        if (m_verbose)
+            printf("Kernel %s [%s]\n", kernelName.c_str(), (m_kmerKernel[c] != NULL)? "OK" : "NOT FOUND");
+    }
+
+    if (kernelsFound == 0)
+        throw Error(format("Binary %s has no kernels for k=%d", path.c_str(), kmerLength));
+
+    m_binaryPath = path;
+    m_kmerLength = kmerLength;
+    m_counting = counting;
+
+    lap.stop();
+
+    if (m_verbose)
+        printf("[INFO] Binary Load Time: %f\n", lap.lap());
+}
+
+void FPGADeviceSession::releaseProgram()
+{
+    cl_int ret;
+
+    for (int c=0; c < KMER_LENGTH_CLASSES; c++)
+    {
+        if (m_kmerKernel[c] == NULL)
+            continue;
+
+        ret = clReleaseKernel(m_kmerKernel[c]);
+        SAMPLE_CHECK_ERRORS(ret);
+
+        m_kmerKernel[c] = NULL;
+    }
+
+    if (m_program != NULL)
+    {
+        ret = clReleaseProgram(m_program);
+        SAMPLE_CHECK_ERRORS(ret);
+
+        m_program = NULL;
+    }
+
+    m_binaryPath = "";
+    m_kmerLength = 0;
+    m_counting = false;
+}
+
+void FPGADeviceSession::close()
+{
+    if (!m_open)
+        return;
+
+    cl_int err;
+
+    releaseProgram();
+
+    err = clReleaseCommandQueue(m_queue);
+    SAMPLE_CHECK_ERRORS(err);
+
+    for (int cu=0; cu < m_cuQueueCount; cu++)
+    {
+        err = clReleaseCommandQueue(m_cuQueue[cu]);
+        SAMPLE_CHECK_ERRORS(err);
+    }
+
+    err = clReleaseContext(m_context);
+    SAMPLE_CHECK_ERRORS(err);
+
+    m_cuQueueCount = 0;
+    m_open = false;
+}
+
+bool FPGADeviceSession::isOpen()
+{
+    return m_open;
+}
+
+cl_context FPGADeviceSession::getContext()
+{
+    return m_context;
+}
+
+cl_command_queue FPGADeviceSession::getQueue()
+{
+    return m_queue;
+}
+
+cl_command_queue FPGADeviceSession::getCuQueue(int cu)
+{
+    return m_cuQueue[cu];
+}
+
+cl_kernel FPGADeviceSession::getKernel(int lengthClass)
+{
+    return m_kmerKernel[lengthClass];
+}
+
+int FPGADeviceSession::getKmerLength()
+{
+    return m_kmerLength;
+}
+
+/**
+ * @return true if the kernels of the loaded binary compute the counting
+ * histogram bound (KMER_COUNTING) instead of the presence one
+ */
+bool FPGADeviceSession::isCounting()
+{
+    return m_counting;
+}
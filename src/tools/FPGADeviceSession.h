@@ -0,0 +1,100 @@
+/*
+ * Copyright (C) 2020 Universitat Autonoma de Barcelona - David Castells-Rufas <david.castells@uab.cat>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+/*
+ * File:   FPGADeviceSession.h
+ * Author: dcr
+ *
+ * OpenCL state of the kmer device: context, queues, program and the kernels
+ * of the length classes. The session is opened and the binary loaded once,
+ * and then it can be shared by any number of filters (and filter runs) of the
+ * process. The binary is memory-mapped instead of read, and it is not
+ * reloaded if the same file and k are requested again.
+ */
+
+#ifndef FPGADEVICESESSION_H
+#define FPGADEVICESESSION_H
+
+#include "OpenCLUtils.h"
+
+#include <string>
+
+using namespace std;
+
+/*
+ * Length classes of the kernel family (kmer_l64, kmer_l128, ...).
+ * Candidates are binned by the length of their longest sequence
+ */
+#define KMER_LENGTH_CLASSES     4
+
+extern const int kmerLengthClass[KMER_LENGTH_CLASSES];
+
+/*
+ * Maximum number of command queues when the workload is enqueued per compute unit
+ */
+#define KMER_MAX_CU_QUEUES      16
+
+#define KMER_K_MIN      3
+#define KMER_K_MAX      7
+
+class FPGADeviceSession
+{
+public:
+    FPGADeviceSession();
+    virtual ~FPGADeviceSession();
+
+public:
+    void open(int platform_id);
+    void loadBinary(string path, int kmerLength, bool counting);
+    string findBinary(string binaryDir, string openCLKernelType, int kmerLength);
+    void close();
+
+    bool isOpen();
+    cl_context getContext();
+    cl_command_queue getQueue();
+    cl_command_queue getCuQueue(int cu);
+    cl_kernel getKernel(int lengthClass);
+    int getKmerLength();
+    bool isCounting();
+
+private:
+    void releaseProgram();
+
+public:
+    bool m_verbose;
+    int m_computeUnits;     // number of partitions of the workload (0 = all compute units of the device)
+    bool m_cuQueues;        // enqueue every partition in its own queue instead of a single NDRange
+
+private:
+    bool m_open;
+    cl_platform_id m_platform;
+    cl_device_id m_deviceId;
+    cl_context m_context;
+    cl_command_queue m_queue;
+    cl_command_queue m_cuQueue[KMER_MAX_CU_QUEUES];
+    int m_cuQueueCount;
+
+    cl_program m_program;
+    cl_kernel m_kmerKernel[KMER_LENGTH_CLASSES];
+    string m_binaryPath;    // binary currently loaded
+    int m_kmerLength;
+    bool m_counting;        // the kernels of the binary are built with KMER_COUNTING
+};
+
+#endif /* FPGADEVICESESSION_H */
+
@@ -25,17 +25,11 @@
 
 #include "FPGAKmerFilter.h"
 #include "PerformanceLap.h"
+#include "CandidateVerifier.h"
 #include "TextUtils.h"
 #include "../benchmark/benchmark_edit_alg.h"
-
-#define WORKLOAD_TASK_SIZE  3
-#define INDEX_SIZE          2
-#define BASE_SIZE           2
-#define LOAD_BASES_ALIGNMENT_BITS   512
-
-#define KMER_K          5
-#define KMER_K_BITS     (KMER_K*BASE_SIZE)
-#define KMER_BINS       (1 << KMER_K_BITS)
+#include "../filter/kmer_filter.h"
+#include "../utils/dna_text.h"
 
 /**
  * Compute the number of bytes required to store the number of bases, considering
@@ -53,28 +47,108 @@ unsigned int alignedSequenceSize(int bases)
 }
 
 FPGAKmerFilter::FPGAKmerFilter() {
+    m_verbose = false;
+    m_mmAllocator = NULL;
+    m_kmerCounting = NULL;
+    m_kmerLength = 0;
+    m_counting = false;
+    m_session = NULL;
+    m_resultBitmap = false;
+    m_crossValidate = false;
+    m_verifyThreads = 1;
+    m_rejectSampling = 1.0;
+    m_resultWriter = NULL;
+    m_modelOnly = false;
+    m_diffModel = false;
+    m_diffCompared = 0;
+    m_diffMismatches = 0;
+    
+    for (int c=0; c < KMER_LENGTH_CLASSES; c++)
+        m_model[c] = NULL;
 }
 
 
 
 FPGAKmerFilter::~FPGAKmerFilter() {
+    if (m_kmerCounting != NULL)
+        kmer_counting_destroy(m_kmerCounting);
+    if (m_mmAllocator != NULL)
+        mm_allocator_delete(m_mmAllocator);
+    
+    for (int c=0; c < KMER_LENGTH_CLASSES; c++)
+        delete m_model[c];
+}
+
+/**
+ * Use the kernels of a device session. The session must have a binary loaded,
+ * and it can be shared with other filters
+ */
+void FPGAKmerFilter::setSession(FPGADeviceSession* session)
+{
+    m_session = session;
+    m_kmerLength = session->getKmerLength();
+    m_counting = session->isCounting();
+}
+
+/**
+ * Create the host models of the kernel family (see KmerKernelModel).
+ * With modelOnly the models replace the device (no OpenCL is needed), otherwise
+ * every kernel invocation is checked against them
+ * @param kmerLength
+ * @param counting true if the kernels are built with KMER_COUNTING
+ * @param modelOnly
+ */
+void FPGAKmerFilter::initModel(int kmerLength, bool counting, bool modelOnly)
+{
+    if (kmerLength < KMER_K_MIN || kmerLength > KMER_K_MAX)
+    {
+        fprintf(stderr, "[OCLFPGA] Invalid k-mer length %d for the device (supported %d..%d)\n", kmerLength, KMER_K_MIN, KMER_K_MAX);
+        exit(1);
+    }
+    
+    m_kmerLength = kmerLength;
+    m_counting = counting;
+    m_modelOnly = modelOnly;
+    m_diffModel = !modelOnly;
+    
+    for (int c=0; c < KMER_LENGTH_CLASSES; c++)
+        m_model[c] = new KmerKernelModel(kmerLength, kmerLengthClass[c], counting);
 }
 
 void FPGAKmerFilter::addInput(filter_input_t* const filter_input, const int kmer_length) 
 {
+    if (kmer_length != m_kmerLength)
+    {
+        fprintf(stderr, "[OCLFPGA] Kernels compiled for k=%d cannot compute k=%d\n", m_kmerLength, kmer_length);
+        exit(1);
+    }
+    
     int pl = filter_input->pattern_length;
     int tl = filter_input->text_length;
     
+    // packed candidates are kept in the mapped file, and copied to the device buffers as they are
+    m_packed.push_back(filter_input->packed_record);
     
-    m_basesPattern.push_back(filter_input->pattern);
-    m_basesText.push_back(filter_input->text);
+    if (filter_input->packed_record != NULL)
+    {
+        m_basesPattern.push_back(string());
+        m_basesText.push_back(string());
+    }
+    else
+    {
+        // the sequences are views of the input (not terminated)
+        m_basesPattern.push_back(string(filter_input->pattern, pl));
+        m_basesText.push_back(string(filter_input->text, tl));
+    }
     m_basesPatternLength.push_back(pl);
     m_basesTextLength.push_back(tl);
+    m_maxError.push_back(filter_input->max_error);
 
 	m_original.push_back(filter_input);
 }
 
-#define dna_encode_valid(c)   (((c == 'A') || (c == 'a'))? 0: ((c == 'C') || (c == 'c'))? 1: ((c == 'G') || (c == 'g'))? 2: 3)
+// uncalled bases are encoded as A, like the text of kmer_counting_min_bound
+#define dna_encode_valid(c)   (dna_encode(c) % ENC_DNA_CHAR_N)
 
 void FPGAKmerFilter::encodeSequence(string bases, unsigned int basesLength, unsigned char* pattern, unsigned int offset)
 {
@@ -114,66 +188,288 @@ void FPGAKmerFilter::encodeSequence(string bases, unsigned int basesLength, unsi
 
 }
 
-void my_benchmark_check(filter_input_t* const filter_input,
-	string pattern,
-	string text, 
-const bool accepted);
+/**
+ * Compute the bounds of all the inputs. The time is accounted in
+ * filter_input->timer, and the accuracy check (if enabled) in
+ * filter_input->timer_check
+ */
+void FPGAKmerFilter::computeAll(filter_input_t* const filter_input)
+{
+    unsigned int* bounds = (unsigned int*) alignedMalloc(m_basesPatternLength.size() * sizeof(unsigned int));
+    
+    timer_start(&filter_input->timer);
+    
+    computeBounds(0, m_basesPatternLength.size(), bounds);
+    
+    timer_stop(&filter_input->timer);
+    
+    if (m_crossValidate)
+        crossValidate(bounds);
+    
+    if (m_diffModel)
+        printf("[MODEL] %d inputs compared with the device, %d mismatches\n", m_diffCompared, m_diffMismatches);
+    
+    writeResults(bounds);
+    
+    if (filter_input->check)
+        verifyAll(filter_input, bounds);
+    
+    alignedFree(bounds);
+}
+
+/**
+ * Write the bound and accept decision of every input (in input order) to
+ * the result writer, if any. With the accept bitmap the bounds are 0 for the
+ * accepted inputs and max error + 1 for the rejected ones
+ */
+void FPGAKmerFilter::writeResults(unsigned int* bounds)
+{
+    if (m_resultWriter == NULL)
+        return;
+    
+    for (int i=0; i < m_basesPatternLength.size(); i++)
+        result_writer_add(m_resultWriter, i, bounds[i], bounds[i] <= m_maxError[i]);
+}
+
+/**
+ * Check the bounds against the edit distance of the inputs
+ * (see CandidateVerifier)
+ */
+void FPGAKmerFilter::verifyAll(filter_input_t* const filter_input, unsigned int* bounds)
+{
+    CandidateVerifier verifier(this, m_verifyThreads, m_rejectSampling);
+    verifier.m_verbose = m_verbose;
+    verifier.verifyAll(filter_input, bounds);
+}
+
+/**
+ * Compare the accept decision of every input with the one of the host
+ * counting filter (kmer_counting_min_bound) and report the differences.
+ * With the counting kernels (-DKMER_COUNTING) no differences are expected
+ * @param bounds the bounds computed by computeBounds
+ */
+void FPGAKmerFilter::crossValidate(unsigned int* bounds)
+{
+    int n = m_basesPatternLength.size();
+    int onlyDevice = 0;     // accepted by the device, rejected by the host
+    int onlyHost = 0;       // rejected by the device, accepted by the host
+    
+    for (int i=0; i < n; i++)
+    {
+        bool deviceAccepted = (bounds[i] <= m_maxError[i]);
+        bool hostAccepted = (computeBoundCPU(i) <= m_maxError[i]);
+        
+        if (deviceAccepted && !hostAccepted)
+            onlyDevice++;
+        
+        if (!deviceAccepted && hostAccepted)
+        {
+            onlyHost++;
+            
+            if (m_verbose)
+                printf("[OCLFPGA] Cross-validation: input %d rejected by the device (bound=%u max error=%d)\n", i, bounds[i], m_maxError[i]);
+        }
+    }
+    
+    printf("[OCLFPGA] Cross-validation: %d inputs, %d only accepted by the device, %d only accepted by the host\n", n, onlyDevice, onlyHost);
+}
+
+/**
+ * Select the smallest length class that can hold both sequences of an input.
+ * Patterns with uncalled bases are left to the host, because their kmers
+ * are skipped by the counting filter (but not by the kernel)
+ * @param i index of the input
+ * @return the length class, or -1 if there is no kernel for it
+ */
+int FPGAKmerFilter::selectLengthClass(int i)
+{
+    bool uncalled = (m_packed[i] != NULL)? (m_packed[i]->pattern_n_runs > 0) : (m_basesPattern[i].find(DNA_CHAR_N) != string::npos);
+    
+    if (uncalled)
+        return -1;
+    
+    int len = MAX(m_basesPatternLength[i], m_basesTextLength[i]);
+    
+    for (int c=0; c < KMER_LENGTH_CLASSES; c++)
+        if (len <= kmerLengthClass[c])
+        {
+            bool available = (m_modelOnly)? (m_model[c] != NULL) : (m_session != NULL && m_session->getKernel(c) != NULL);
+            return (available)? c : -1;
+        }
+    
+    return -1;
+}
+
+/**
+ * Compute the kmer distance bound of the inputs [first, first+count).
+ * The inputs are binned by length class and every class is computed by its
+ * kernel. Inputs that do not fit any available class are computed in the host
+ * @param first index of the first input of the batch
+ * @param count number of inputs in the batch
+ * @param bounds output array (count elements) receiving the bound of each input
+ */
+void FPGAKmerFilter::computeBounds(int first, int count, unsigned int* bounds)
+{
+    computeBounds(first, count, bounds, NULL, NULL);
+}
+
+/**
+ * Compute the same bounds as computeBounds, but with host models of the
+ * kernels instead of the device, so that the host threads of the hybrid
+ * filter get the bounds of the loaded kernels (same histograms and result
+ * mode). The models and the counting tables are the ones of the calling
+ * thread (see newModels)
+ * @param first index of the first input of the batch
+ * @param count number of inputs in the batch
+ * @param bounds output array (count elements) receiving the bound of each input
+ * @param models a model per length class
+ * @param kmer_counting counting tables for the inputs computed in the host
+ */
+void FPGAKmerFilter::computeBoundsHost(int first, int count, unsigned int* bounds, KmerKernelModel** models,
+        kmer_counting_nway_t* kmer_counting)
+{
+    computeBounds(first, count, bounds, models, kmer_counting);
+}
+
+/**
+ * Create the models of the kernels of the filter, for a thread calling
+ * computeBoundsHost
+ * @param models a model per length class (to be deleted by the caller)
+ */
+void FPGAKmerFilter::newModels(KmerKernelModel** models)
+{
+    for (int c=0; c < KMER_LENGTH_CLASSES; c++)
+        models[c] = new KmerKernelModel(m_kmerLength, kmerLengthClass[c], m_counting);
+}
 
-void FPGAKmerFilter::computeAll()
+void FPGAKmerFilter::computeBounds(int first, int count, unsigned int* bounds, KmerKernelModel** models,
+        kmer_counting_nway_t* kmer_counting)
 {
+    vector<int> members[KMER_LENGTH_CLASSES];
+    
+    for (int j=0; j < count; j++)
+    {
+        int c = selectLengthClass(first + j);
+        
+        if (c < 0)
+            bounds[j] = (kmer_counting != NULL)? computeBoundCPU(first + j, kmer_counting) : computeBoundCPU(first + j);
+        else
+            members[c].push_back(j);
+    }
+    
+    for (int c=0; c < KMER_LENGTH_CLASSES; c++)
+    {
+        if (members[c].size() == 0)
+            continue;
+        
+        if (m_verbose)
+            printf("Length class %d: %d inputs\n", kmerLengthClass[c], (int) members[c].size());
+        
+        // translate to absolute indices
+        for (int j=0; j < members[c].size(); j++)
+            members[c][j] += first;
+        
+        vector<unsigned int> classBounds(members[c].size());
+        
+        computeBoundsClass(c, members[c], &classBounds[0], (models != NULL)? models[c] : NULL);
+        
+        for (int j=0; j < members[c].size(); j++)
+            bounds[members[c][j] - first] = classBounds[j];
+    }
+}
+
+/**
+ * Compute the bound of the inputs of a length class in the device (or in
+ * the given model of its kernel).
+ * Every sequence gets a slot of the size of the class, so that the kernel can
+ * read it with full width
+ */
+void FPGAKmerFilter::computeBoundsClass(int lengthClass, vector<int>& members, unsigned int* bounds, KmerKernelModel* model)
+{
+    int count = members.size();
+    unsigned int slotSize = alignedSequenceSize(kmerLengthClass[lengthClass]);
+    
     // allocate memory buffers
-    size_t requiredPatternMemory = countRequiredMemory(m_basesPatternLength);    
-    size_t requiredTextMemory = countRequiredMemory(m_basesTextLength);
+    size_t requiredPatternMemory = count * slotSize;
+    size_t requiredTextMemory = count * slotSize;
     
     unsigned char* pattern = (unsigned char*) alignedMalloc(requiredPatternMemory);
     unsigned char* text = (unsigned char*) alignedMalloc(requiredTextMemory);
     
-    unsigned int* patternIdx = (unsigned int*) alignedMalloc(m_basesPatternLength.size() * sizeof(unsigned int) * INDEX_SIZE);
-    unsigned int* textIdx = (unsigned int*) alignedMalloc(m_basesTextLength.size() * sizeof(unsigned int) * INDEX_SIZE);
+    memset(pattern, 0, requiredPatternMemory);
+    memset(text, 0, requiredTextMemory);
     
-    unsigned int* workload = (unsigned int*) alignedMalloc(m_basesTextLength.size() * sizeof(unsigned int) * WORKLOAD_TASK_SIZE);
+    unsigned int* patternIdx = (unsigned int*) alignedMalloc(count * sizeof(unsigned int) * INDEX_SIZE);
+    unsigned int* textIdx = (unsigned int*) alignedMalloc(count * sizeof(unsigned int) * INDEX_SIZE);
     
-    // now fill
-    unsigned int poff = 0;  // pattern offset
-    unsigned int toff = 0;  // text offset
+    // the bitmap mode sends the max error of every task and gets one bit back, otherwise the 8 bit bound is returned
+    unsigned int resultMode = (m_resultBitmap)? RESULT_ACCEPT : RESULT_BOUNDS;
+    unsigned int alignedCount = ((count + RESULT_ALIGNMENT - 1) / RESULT_ALIGNMENT) * RESULT_ALIGNMENT;
+    unsigned int resultSize = (m_resultBitmap)? alignedCount / 8 : alignedCount;
+    unsigned int maxErrorSize = (m_resultBitmap)? count : 0;
     
-    for (int i=0; i < m_basesPatternLength.size(); i++)
+    unsigned char* maxError = (unsigned char*) alignedMalloc(MAX(maxErrorSize, 1));
+    unsigned char* result = (unsigned char*) alignedMalloc(resultSize);
+    
+    for (int j=0; j < count; j++)
     {
-        // fill the workload
-        workload[i*WORKLOAD_TASK_SIZE+0] = i;   // pattern
-        workload[i*WORKLOAD_TASK_SIZE+1] = i;   // text
+        int i = members[j];
+        unsigned int off = j * slotSize;
+        
+        if (m_resultBitmap)
+            maxError[j] = MIN(m_maxError[i], 255);
         
         // fill the pattern
-        patternIdx[i*INDEX_SIZE+0] = poff;   // pattern offset
-        patternIdx[i*INDEX_SIZE+1] = m_basesPatternLength[i];
+        patternIdx[j*INDEX_SIZE+0] = off;   // pattern offset
+        patternIdx[j*INDEX_SIZE+1] = m_basesPatternLength[i];
  
-//printf("Pattern: %s\n", m_basesPattern[i].c_str());       
- //printf("Pattern: %s\n", m_original[i]->pattern);       
-encodeSequence(m_basesPattern[i], m_basesPatternLength[i], pattern, poff);
-        
-        poff += alignedSequenceSize(m_basesPatternLength[i]);
+        if (m_packed[i] != NULL)
+            memcpy(&pattern[off], candidate_packed_record_pattern(m_packed[i]), candidate_packed_size(m_basesPatternLength[i]));
+        else
+            encodeSequence(m_basesPattern[i], m_basesPatternLength[i], pattern, off);
         
         // fill the text
-        textIdx[i*INDEX_SIZE+0] = toff;
-        textIdx[i*INDEX_SIZE+1] = m_basesTextLength[i];
-//     printf("Text: %s\n", m_basesText[i].c_str());   
-        encodeSequence(m_basesText[i], m_basesTextLength[i], text, toff);
-        
-        toff += alignedSequenceSize(m_basesTextLength[i]);
+        textIdx[j*INDEX_SIZE+0] = off;
+        textIdx[j*INDEX_SIZE+1] = m_basesTextLength[i];
+
+        if (m_packed[i] != NULL)
+            memcpy(&text[off], candidate_packed_record_text(m_packed[i]), candidate_packed_size(m_basesTextLength[i]));
+        else
+            encodeSequence(m_basesText[i], m_basesTextLength[i], text, off);
     }
 
 //    printf("Invoke kernel\n");
 
-    invokeKernel(pattern, requiredPatternMemory, patternIdx, text, requiredTextMemory, textIdx, workload, m_basesPatternLength.size());
+    if (model != NULL)
+        model->run(pattern, patternIdx, text, textIdx, maxError, (unsigned int*) result, 0, count, resultMode);
+    else if (m_modelOnly)
+        m_model[lengthClass]->run(pattern, patternIdx, text, textIdx, maxError, (unsigned int*) result, 0, count, resultMode);
+    else
+    {
+        invokeKernel(m_session->getKernel(lengthClass), pattern, requiredPatternMemory, patternIdx, text, requiredTextMemory, textIdx, 
+                maxError, maxErrorSize, result, resultSize, resultMode, count);
+        
+        if (m_diffModel)
+        {
+            unsigned char* expected = (unsigned char*) alignedMalloc(resultSize);
+            
+            m_model[lengthClass]->run(pattern, patternIdx, text, textIdx, maxError, (unsigned int*) expected, 0, count, resultMode);
+            diffResults(members, result, expected, resultMode);
+            
+            alignedFree(expected);
+        }
+    }
     
-    for (int i=0; i < m_basesPatternLength.size(); i++)
+    for (int j=0; j < count; j++)
     {
-        bool accepted;
-        unsigned int d = workload[i*WORKLOAD_TASK_SIZE+2];
-        accepted = (d <= m_original[i]->max_error);
-
-//        printf("[%s] distance=%d max error=%d\n", (accepted)?"OK":"--", d, m_original[i]->max_error);
-        my_benchmark_check(m_original[i], m_basesPattern[i], m_basesText[i], accepted);
+        if (m_resultBitmap)
+        {
+            // the bound is not known, return one that gives the same decision
+            bool accepted = (result[j/8] >> (j%8)) & 0x1;
+            bounds[j] = (accepted)? 0 : m_maxError[members[j]] + 1;
+        }
+        else
+            bounds[j] = result[j];
     }
 
     // free all
@@ -181,65 +477,188 @@ encodeSequence(m_basesPattern[i], m_basesPatternLength[i], pattern, poff);
     alignedFree(textIdx);
     alignedFree(pattern);
     alignedFree(text);
+    alignedFree(maxError);
+    alignedFree(result);
+}
+
+/**
+ * Compare the result of every input of a length class with the one of the
+ * model, and account the mismatches
+ */
+void FPGAKmerFilter::diffResults(vector<int>& members, unsigned char* result, unsigned char* expected, unsigned int resultMode)
+{
+    for (int j=0; j < members.size(); j++)
+    {
+        unsigned int r, e;
+        
+        if (resultMode == RESULT_ACCEPT)
+        {
+            r = (result[j/8] >> (j%8)) & 0x1;
+            e = (expected[j/8] >> (j%8)) & 0x1;
+        }
+        else
+        {
+            r = result[j];
+            e = expected[j];
+        }
+        
+        m_diffCompared++;
+        
+        if (r != e)
+        {
+            m_diffMismatches++;
+            
+            if (m_verbose)
+                printf("[MODEL] input %d: device=%u model=%u\n", members[j], r, e);
+        }
+    }
+}
+
+/**
+ * Compute the bound of an input that does not fit in any kernel
+ */
+unsigned int FPGAKmerFilter::computeBoundCPU(int i)
+{
+    if (m_mmAllocator == NULL)
+    {
+        m_mmAllocator = mm_allocator_new(BUFFER_SIZE_8M);
+        m_kmerCounting = kmer_counting_new(m_kmerLength, m_mmAllocator);
+    }
+    
+    return computeBoundCPU(i, m_kmerCounting);
+}
+
+/**
+ * Compute the bound of an input with the counting tables of the caller
+ * (packed inputs are read as they are)
+ */
+unsigned int FPGAKmerFilter::computeBoundCPU(int i, kmer_counting_nway_t* kmer_counting)
+{
+    unsigned int d;
+    
+    kmer_counting_clear(kmer_counting);
+    
+    if (m_packed[i] != NULL)
+    {
+        const candidate_packed_record_t* record = m_packed[i];
+        kmer_counting_pattern_compute_histogram_packed(kmer_counting, candidate_packed_record_pattern(record), record->pattern_length,
+                (const uint32_t*) candidate_packed_record_pattern_runs(record), record->pattern_n_runs);
+        d = kmer_counting_min_bound_packed(kmer_counting, candidate_packed_record_text(record), record->text_length, m_maxError[i]);
+    }
+    else
+    {
+        kmer_counting_pattern_compute_histogram(kmer_counting, (uint8_t*) m_basesPattern[i].c_str(), m_basesPatternLength[i]);
+        d = kmer_counting_min_bound(kmer_counting, (uint8_t*) m_basesText[i].c_str(), m_basesTextLength[i], m_maxError[i]);
+    }
+    
+    return d;
+}
+
+int FPGAKmerFilter::getInputCount()
+{
+    return m_basesPatternLength.size();
+}
+
+/**
+ * The sequences of the packed inputs are decoded on request
+ */
+string FPGAKmerFilter::getPattern(int i)
+{
+    if (m_packed[i] == NULL)
+        return m_basesPattern[i];
+    
+    string pattern(m_packed[i]->pattern_length, ' ');
+    candidate_packed_record_decode_pattern(m_packed[i], &pattern[0]);
+    
+    return pattern;
+}
+
+string FPGAKmerFilter::getText(int i)
+{
+    if (m_packed[i] == NULL)
+        return m_basesText[i];
+    
+    string text(m_packed[i]->text_length, ' ');
+    candidate_packed_record_decode_text(m_packed[i], &text[0]);
+    
+    return text;
 }
 
-void FPGAKmerFilter::invokeKernel(unsigned char* pattern, unsigned int patternSize, unsigned int* patternIdx,
+int FPGAKmerFilter::getMaxError(int i)
+{
+    return m_maxError[i];
+}
+
+void FPGAKmerFilter::invokeKernel(cl_kernel kernel, unsigned char* pattern, unsigned int patternSize, unsigned int* patternIdx,
                                     unsigned char* text, unsigned int textSize, unsigned int* textIdx,
-                                    unsigned int* workload, unsigned int tasks)
+                                    unsigned char* maxError, unsigned int maxErrorSize,
+                                    unsigned char* result, unsigned int resultSize,
+                                    unsigned int resultMode, unsigned int tasks)
 {
     cl_int ret;
+    cl_context context = m_session->getContext();
+    cl_command_queue queue = m_session->getQueue();
     
     
     PerformanceLap lap;
     lap.start();
     
-    m_memPattern = clCreateBuffer(m_context, CL_MEM_READ_WRITE, patternSize, NULL, &ret);
+    m_memPattern = clCreateBuffer(context, CL_MEM_READ_WRITE, patternSize, NULL, &ret);
     SAMPLE_CHECK_ERRORS(ret);
 
-    m_memPatternIdx = clCreateBuffer(m_context, CL_MEM_READ_WRITE, tasks*INDEX_SIZE*sizeof(unsigned int), NULL, &ret);
+    m_memPatternIdx = clCreateBuffer(context, CL_MEM_READ_WRITE, tasks*INDEX_SIZE*sizeof(unsigned int), NULL, &ret);
     SAMPLE_CHECK_ERRORS(ret);
 
-    m_memText = clCreateBuffer(m_context, CL_MEM_READ_ONLY, textSize, NULL, &ret);
+    m_memText = clCreateBuffer(context, CL_MEM_READ_ONLY, textSize, NULL, &ret);
     SAMPLE_CHECK_ERRORS(ret);
     
-    m_memTextIdx = clCreateBuffer(m_context, CL_MEM_READ_WRITE, tasks*INDEX_SIZE*sizeof(unsigned int), NULL, &ret);
+    m_memTextIdx = clCreateBuffer(context, CL_MEM_READ_WRITE, tasks*INDEX_SIZE*sizeof(unsigned int), NULL, &ret);
+    SAMPLE_CHECK_ERRORS(ret);
+
+    m_memMaxError = clCreateBuffer(context, CL_MEM_READ_ONLY, MAX(maxErrorSize, 1), NULL, &ret);
     SAMPLE_CHECK_ERRORS(ret);
 
-    m_memWorkload = clCreateBuffer(m_context, CL_MEM_READ_WRITE, tasks*WORKLOAD_TASK_SIZE*sizeof(unsigned int), NULL, &ret);
+    m_memResult = clCreateBuffer(context, CL_MEM_WRITE_ONLY, resultSize, NULL, &ret);
     SAMPLE_CHECK_ERRORS(ret);
 
-    ret = clEnqueueWriteBuffer(m_queue, m_memPattern, CL_TRUE, 0, patternSize, pattern, 0, NULL, NULL);
+    ret = clEnqueueWriteBuffer(queue, m_memPattern, CL_TRUE, 0, patternSize, pattern, 0, NULL, NULL);
     SAMPLE_CHECK_ERRORS(ret);
     
-    ret = clEnqueueWriteBuffer(m_queue, m_memPatternIdx, CL_TRUE, 0, tasks*INDEX_SIZE*sizeof(unsigned int), patternIdx, 0, NULL, NULL);
+    ret = clEnqueueWriteBuffer(queue, m_memPatternIdx, CL_TRUE, 0, tasks*INDEX_SIZE*sizeof(unsigned int), patternIdx, 0, NULL, NULL);
     SAMPLE_CHECK_ERRORS(ret);
 
     
-    ret = clEnqueueWriteBuffer(m_queue, m_memText, CL_TRUE, 0, textSize, text, 0, NULL, NULL);
+    ret = clEnqueueWriteBuffer(queue, m_memText, CL_TRUE, 0, textSize, text, 0, NULL, NULL);
     SAMPLE_CHECK_ERRORS(ret);
     
-    ret = clEnqueueWriteBuffer(m_queue, m_memTextIdx, CL_TRUE, 0, tasks*INDEX_SIZE*sizeof(unsigned int), textIdx, 0, NULL, NULL);
+    ret = clEnqueueWriteBuffer(queue, m_memTextIdx, CL_TRUE, 0, tasks*INDEX_SIZE*sizeof(unsigned int), textIdx, 0, NULL, NULL);
     SAMPLE_CHECK_ERRORS(ret);
 
-    ret = clEnqueueWriteBuffer(m_queue, m_memWorkload, CL_TRUE, 0, tasks*WORKLOAD_TASK_SIZE*sizeof(unsigned int), workload, 0, NULL, NULL);
-    SAMPLE_CHECK_ERRORS(ret);
+    if (maxErrorSize > 0)
+    {
+        ret = clEnqueueWriteBuffer(queue, m_memMaxError, CL_TRUE, 0, maxErrorSize, maxError, 0, NULL, NULL);
+        SAMPLE_CHECK_ERRORS(ret);
+    }
 
-    ret = clSetKernelArg(m_kmerKernel, 0, sizeof(cl_mem), (void *)&m_memPattern);
+    ret = clSetKernelArg(kernel, 0, sizeof(cl_mem), (void *)&m_memPattern);
     SAMPLE_CHECK_ERRORS(ret);
     
-    ret = clSetKernelArg(m_kmerKernel, 1, sizeof(cl_mem), (void *)&m_memPatternIdx);
+    ret = clSetKernelArg(kernel, 1, sizeof(cl_mem), (void *)&m_memPatternIdx);
     SAMPLE_CHECK_ERRORS(ret);
     
-    ret = clSetKernelArg(m_kmerKernel, 2, sizeof(cl_mem), (void *)&m_memText);
+    ret = clSetKernelArg(kernel, 2, sizeof(cl_mem), (void *)&m_memText);
     SAMPLE_CHECK_ERRORS(ret);
     
-    ret = clSetKernelArg(m_kmerKernel, 3, sizeof(cl_mem), (void *)&m_memTextIdx);
+    ret = clSetKernelArg(kernel, 3, sizeof(cl_mem), (void *)&m_memTextIdx);
     SAMPLE_CHECK_ERRORS(ret);
     
-    ret = clSetKernelArg(m_kmerKernel, 4, sizeof(cl_mem), (void *)&m_memWorkload);
+    ret = clSetKernelArg(kernel, 4, sizeof(cl_mem), (void *)&m_memMaxError);
+    SAMPLE_CHECK_ERRORS(ret);
+
+    ret = clSetKernelArg(kernel, 5, sizeof(cl_mem), (void *)&m_memResult);
     SAMPLE_CHECK_ERRORS(ret);
 
-    ret = clSetKernelArg(m_kmerKernel, 5, sizeof(cl_int), (void *)&tasks);
+    ret = clSetKernelArg(kernel, 8, sizeof(cl_int), (void *)&resultMode);
     SAMPLE_CHECK_ERRORS(ret);
 
     lap.stop();
@@ -249,14 +668,7 @@ void FPGAKmerFilter::invokeKernel(unsigned char* pattern, unsigned int patternSi
     lap.start();
     
     // send the events to the FPGA
-    size_t wgSize[3] = {1, 1, 1};
-    size_t gSize[3] = {1, 1, 1};
-
-    ret = clEnqueueNDRangeKernel(m_queue, m_kmerKernel, 1, NULL, gSize, wgSize, 0, NULL, NULL);
-    SAMPLE_CHECK_ERRORS(ret);
-    
-    ret = clFinish(m_queue);
-    SAMPLE_CHECK_ERRORS(ret);
+    enqueueKernel(kernel, tasks);
     
     lap.stop();
     
@@ -265,7 +677,7 @@ void FPGAKmerFilter::invokeKernel(unsigned char* pattern, unsigned int patternSi
     
     lap.start();
     
-    ret = clEnqueueReadBuffer(m_queue, m_memWorkload, CL_TRUE, 0, tasks*WORKLOAD_TASK_SIZE*sizeof(unsigned int), workload, 0, NULL, NULL);
+    ret = clEnqueueReadBuffer(queue, m_memResult, CL_TRUE, 0, resultSize, result, 0, NULL, NULL);
     SAMPLE_CHECK_ERRORS(ret);
     
     
@@ -281,7 +693,10 @@ void FPGAKmerFilter::invokeKernel(unsigned char* pattern, unsigned int patternSi
     ret = clReleaseMemObject(m_memTextIdx);
     SAMPLE_CHECK_ERRORS(ret);
     
-    ret = clReleaseMemObject(m_memWorkload);
+    ret = clReleaseMemObject(m_memMaxError);
+    SAMPLE_CHECK_ERRORS(ret);
+    
+    ret = clReleaseMemObject(m_memResult);
     SAMPLE_CHECK_ERRORS(ret);
 
     lap.stop();
@@ -292,207 +707,108 @@ void FPGAKmerFilter::invokeKernel(unsigned char* pattern, unsigned int patternSi
 }
 
 
-size_t FPGAKmerFilter::countRequiredMemory(vector<int>& len)
+/**
+ * Launch the kernel over the workload [0, tasks) partitioned in m_computeUnits
+ * ranges. By default the partitions are the work-items of a single NDRange
+ * (one work-item per work-group, so that the runtime can schedule them in
+ * different compute units). With m_cuQueues every range is enqueued as a
+ * single work-item task in its own queue, so that the compute units overlap
+ * even if the runtime serializes the work-groups of an NDRange
+ * @param kernel the kernel, with the buffer arguments already set
+ * @param tasks number of workload tasks
+ */
+void FPGAKmerFilter::enqueueKernel(cl_kernel kernel, unsigned int tasks)
 {
-    size_t total = 0;
+    cl_int ret;
+    unsigned int parts = MIN((unsigned int) m_session->m_computeUnits, tasks);
     
-    for (int i=0; i  < len.size(); i++)
+    if (parts == 0)
+        parts = 1;
+    
+    size_t wgSize[3] = {1, 1, 1};
+    size_t gSize[3] = {1, 1, 1};
+    
+    if (!m_session->m_cuQueues)
     {
-        int bases = len[i];
+        unsigned int begin = 0;
         
-        total += alignedSequenceSize(bases);
-    }
-    
-    return total;
-}
+        ret = clSetKernelArg(kernel, 6, sizeof(cl_int), (void *)&begin);
+        SAMPLE_CHECK_ERRORS(ret);
 
+        ret = clSetKernelArg(kernel, 7, sizeof(cl_int), (void *)&tasks);
+        SAMPLE_CHECK_ERRORS(ret);
+        
+        gSize[0] = parts;
+        
+        ret = clEnqueueNDRangeKernel(m_session->getQueue(), kernel, 1, NULL, gSize, wgSize, 0, NULL, NULL);
+        SAMPLE_CHECK_ERRORS(ret);
 
-void FPGAKmerFilter::destroy()
-{
+        ret = clFinish(m_session->getQueue());
+        SAMPLE_CHECK_ERRORS(ret);
+        
+        return;
+    }
     
-}
-
-void FPGAKmerFilter::initOpenCL(int platform_id)
-{
-
-    cl_uint spi = platform_id;
-    cl_uint sdi = 0;
-
-    if (m_verbose)
-        cout << "[OCLFPGA] initialization (version compiled "  << __DATE__  << " "  << __TIME__ << ")" << endl;
+    unsigned int slice = (tasks + parts - 1) / parts;
+    slice = ((slice + RESULT_ALIGNMENT - 1) / RESULT_ALIGNMENT) * RESULT_ALIGNMENT;
     
-    try
+    // kernel arguments are captured at enqueue time, so they can be changed between enqueues
+    for (unsigned int cu=0; cu < parts; cu++)
     {
-        if(!setCwdToExeDir()) 
-        {
-            if (m_verbose)
-                cout << "[OCLFPGA] ### ERROR ### Failed to change dir" << endl;
-            return;
-        }
-
-        m_platform = selectPlatform(spi);
-
-        if (m_verbose)
-            cout << "[*] Platform Selected [OK] " << endl;
+        unsigned int begin = cu * slice;
+        unsigned int end = MIN(begin + slice, tasks);
         
-        m_deviceId = selectDevice(m_platform, sdi);
-
-        if (m_verbose)
-            cout << "[*] Device Selected [OK] " << endl;
-
-
-        m_context = createContext(m_platform, m_deviceId);
-
-        if (m_verbose)
-            cout << "[*] Context Created [OK] " << endl;
-
-        m_queue = createQueue(m_deviceId, m_context, 0);
-
-        if (m_verbose)
-            cout << "[*] Queue Created [OK] " << endl;
-
-//        m_queue2 = createQueue(m_deviceId, m_context, 0);
-//
-//        if (m_verbose)
-//            cout << "[*] Queue 2 Created [OK] " << endl;
-
-        m_openCLFilesPath = ".";
-
-        if (m_verbose)
-            cout << "Default Path=  " << m_openCLFilesPath << endl;
-
-
-//        initKernels();
+        if (begin >= end)
+            break;
+        
+        ret = clSetKernelArg(kernel, 6, sizeof(cl_int), (void *)&begin);
+        SAMPLE_CHECK_ERRORS(ret);
 
+        ret = clSetKernelArg(kernel, 7, sizeof(cl_int), (void *)&end);
+        SAMPLE_CHECK_ERRORS(ret);
+        
+        ret = clEnqueueNDRangeKernel(m_session->getCuQueue(cu), kernel, 1, NULL, gSize, wgSize, 0, NULL, NULL);
+        SAMPLE_CHECK_ERRORS(ret);
+        
+        ret = clFlush(m_session->getCuQueue(cu));
+        SAMPLE_CHECK_ERRORS(ret);
     }
-    catch (Error& err)
+    
+    for (unsigned int cu=0; cu < parts; cu++)
     {
-        printf("%s\n", err.what());
-        exit(0);
+        ret = clFinish(m_session->getCuQueue(cu));
+        SAMPLE_CHECK_ERRORS(ret);
     }
 }
 
-void FPGAKmerFilter::finalizeOpenCL()
-{
-    //finalizeKernels();
-    cl_int err;
-    
-    err = clReleaseCommandQueue(m_queue);
-    SAMPLE_CHECK_ERRORS(err);
-
-    err = clReleaseContext(m_context);   
-    SAMPLE_CHECK_ERRORS(err);
-    
-    
-}
-
-void FPGAKmerFilter::initKernels(int version, string openCLKernelType)
+size_t FPGAKmerFilter::countRequiredMemory(vector<int>& len)
 {
-    cl_int ret;
-    
-    m_openCLKernelVersion = version;
+    size_t total = 0;
     
-    if (m_verbose)
+    for (int i=0; i  < len.size(); i++)
     {
-        printf("Reading Kernel files\n");
-    }
-
-    string platformName = getPlatformName(m_platform);
+        int bases = len[i];
         
-    printf("[OCLFPGA] Platform Name = %s\n", platformName.c_str());
-
-    uint64 t0, tf;
-
-    perfCounter(&t0);
-
-    // NVIDIA devices should work with binaries (PTX)
-
-    const unsigned char* pKernels[10]; 
-    size_t pKernelSizes[10];
-    cl_int pStatus[10];
-
-    memset(pKernels, 0, sizeof(pKernels));
-    memset(pKernelSizes, 0, sizeof(pKernelSizes));
-
-    int kernelCount = 0;
-
-//    std::string fullPath  = m_openCLFilesPath.c_str() + format("/fpga/v%d/riscv.%s.aocx", version, openCLKernelType.c_str());
-//    std::string fullPath  = m_openCLFilesPath.c_str() + format("/../fpga/kmer.%s.aocx", openCLKernelType.c_str());
-    std::string fullPath  = m_openCLFilesPath.c_str() + format("/../kmer.%s.xclbin", openCLKernelType.c_str());
-
-
-    printf("Opening %s\n", fullPath.c_str());
-
-    setCwd(m_openCLFilesPath.c_str());
-
-    int sysret = system("pwd");
-
-    printf("Create Program From Binary...\n");
-
-    m_program = createProgramFromBinary(m_context, fullPath.c_str(), &m_deviceId, 1); 
-
-    printf("[OK]\n");
-
-    printf("Compiling...\n");
-    fflush(stdout);
-
-    //ret = clBuildProgram(program, 1, &device, "-g -s", NULL, NULL);   // in Windows
-    ret = clBuildProgram(m_program, 1, &m_deviceId, NULL, NULL, NULL);
-
-    printf("[OK]\n");
-    fflush(stdout);
-
-    perfCounter(&tf);
-
-    printf("[INFO] Kernel Compilation Time: %f\n", (float) secondsBetweenLaps(t0, tf));
-
-    //if (ret == CL_BUILD_PROGRAM_FAILURE) 
-    {
-        // Determine the size of the log
-        size_t log_size;
-        ret = clGetProgramBuildInfo(m_program, m_deviceId, CL_PROGRAM_BUILD_LOG, 0, NULL, &log_size);
-
-        // Allocate memory for the log
-        char *log = (char *) malloc(log_size);
-
-        // Get the log
-        ret = clGetProgramBuildInfo(m_program, m_deviceId, CL_PROGRAM_BUILD_LOG, log_size, log, NULL);
-
-        // Print the log
-        printf("%s\n", log);
-    }
-
-    SAMPLE_CHECK_ERRORS(ret);
-
-    for (int i=0; i < kernelCount; i++)
-    {
-        free((void*)pKernels[i]);
+        total += alignedSequenceSize(bases);
     }
-
-    fflush(stderr);
-    fflush(stdout);
-
-    //string allCode = m_addSourceCode + "\n" + m_mulSourceCode;
-
-    m_kmerKernel = clCreateKernel(m_program, "kmer", &ret);
-    SAMPLE_CHECK_ERRORS(ret);
-
-
-        
-    fflush(stderr);
-    fflush(stdout);
+    
+    return total;
 }
 
-void FPGAKmerFilter::finalizeKernels()
-{
-    cl_int ret;
-    
-    
-    
-    ret = clReleaseKernel(m_kmerKernel);
-    SAMPLE_CHECK_ERRORS(ret);
-    
-    ret = clReleaseProgram(m_program);
-    SAMPLE_CHECK_ERRORS(ret);
 
+/**
+ * Drop the inputs, so that the filter (and its device session) can be used
+ * for another run
+ */
+void FPGAKmerFilter::destroy()
+{
+    m_basesPattern.clear();
+    m_basesText.clear();
+    m_packed.clear();
+    m_basesPatternLength.clear();
+    m_basesTextLength.clear();
+    m_maxError.clear();
+    m_original.clear();
+    m_diffCompared = 0;
+    m_diffMismatches = 0;
 }
@@ -26,8 +26,11 @@
 #ifndef FPGAKMERFILTER_H
 #define FPGAKMERFILTER_H
 
-#include "OpenCLUtils.h"
+#include "FPGADeviceSession.h"
+#include "KmerKernelModel.h"
 #include "../benchmark/benchmark_utils.h"
+#include "../filter/kmer_filter.h"
+#include "../utils/result_writer.h"
 
 #include <string>
 #include <vector>
@@ -41,46 +44,75 @@ public:
     virtual ~FPGAKmerFilter();
     
 public:
-    void initOpenCL(int platform_id);
-    void initKernels(int version, string openCLKernelType);
-    void finalizeOpenCL();
-    void finalizeKernels();
+    void setSession(FPGADeviceSession* session);
+    void initModel(int kmerLength, bool counting, bool modelOnly);
     void addInput(filter_input_t* const filter_input, const int kmer_length);
-    void computeAll();
+    void computeAll(filter_input_t* const filter_input);
+    void computeBounds(int first, int count, unsigned int* bounds);
+    void computeBoundsHost(int first, int count, unsigned int* bounds, KmerKernelModel** models,
+            kmer_counting_nway_t* kmer_counting);
+    void newModels(KmerKernelModel** models);
+    void verifyAll(filter_input_t* const filter_input, unsigned int* bounds);
+    void writeResults(unsigned int* bounds);
+    int getInputCount();
+    string getPattern(int i);
+    string getText(int i);
+    int getMaxError(int i);
+    unsigned int computeBoundCPU(int i, kmer_counting_nway_t* kmer_counting);
     void destroy();
-    void invokeKernel(unsigned char* pattern, unsigned int patternSize, unsigned int* patternIdx,
+    void invokeKernel(cl_kernel kernel, unsigned char* pattern, unsigned int patternSize, unsigned int* patternIdx,
                                     unsigned char* text, unsigned int textSize, unsigned int* textIdx,
-                                    unsigned int* workload, unsigned int tasks);
+                                    unsigned char* maxError, unsigned int maxErrorSize,
+                                    unsigned char* result, unsigned int resultSize,
+                                    unsigned int resultMode, unsigned int tasks);
     
 private:
     size_t countRequiredMemory(vector<int>& len);
+    void enqueueKernel(cl_kernel kernel, unsigned int tasks);
+    void crossValidate(unsigned int* bounds);
+    void diffResults(vector<int>& members, unsigned char* result, unsigned char* expected, unsigned int resultMode);
+    int selectLengthClass(int i);
+    void computeBounds(int first, int count, unsigned int* bounds, KmerKernelModel** models,
+            kmer_counting_nway_t* kmer_counting);
+    void computeBoundsClass(int lengthClass, vector<int>& members, unsigned int* bounds, KmerKernelModel* model);
+    unsigned int computeBoundCPU(int i);
     void encodeSequence(string bases, unsigned int basesLength, unsigned char* pattern, unsigned int offset);
     
 public:
     bool m_verbose;
+    bool m_resultBitmap;    // get an accept bit per input instead of the 8 bit bound
+    bool m_crossValidate;   // compare the accept decisions with the host counting filter
+    int m_verifyThreads;    // threads of the accuracy check
+    double m_rejectSampling;    // fraction of the rejected inputs verified by the accuracy check
+    result_writer_t* m_resultWriter;    // per-input results (NULL if disabled)
 
 private:
     vector<string> m_basesPattern;
     vector<string> m_basesText;
     vector<int> m_basesPatternLength;
     vector<int> m_basesTextLength;
+    vector<int> m_maxError;
+    vector<const candidate_packed_record_t*> m_packed;   // NULL for the text inputs
     vector<filter_input_t*> m_original;   
 
-    cl_platform_id m_platform;
-    cl_context m_context;
-    cl_device_id m_deviceId;
-    cl_program m_program;
-    cl_command_queue m_queue;
-    cl_kernel m_kmerKernel;
-    string m_openCLFilesPath;
+    FPGADeviceSession* m_session;
+    KmerKernelModel* m_model[KMER_LENGTH_CLASSES];
+    bool m_counting;        // the kernels are built with KMER_COUNTING
+    bool m_modelOnly;       // the models replace the device
+    bool m_diffModel;       // the results of the device are compared with the models
+    int m_diffCompared;
+    int m_diffMismatches;
+    mm_allocator_t* m_mmAllocator;  // for the candidates computed in the host
+    kmer_counting_nway_t* m_kmerCounting;
     
     cl_mem m_memPattern;
     cl_mem m_memPatternIdx;
     cl_mem m_memText;
     cl_mem m_memTextIdx;
-    cl_mem m_memWorkload;
+    cl_mem m_memMaxError;
+    cl_mem m_memResult;
     
-    int m_openCLKernelVersion;
+    int m_kmerLength;
 };
 
 #endif /* FPGAKMERFILTER_H */
@@ -0,0 +1,457 @@
+/*
+ * Copyright (C) 2020 Universitat Autonoma de Barcelona - David Castells-Rufas <david.castells@uab.cat>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+/*
+ * File:   FilterServer.cpp
+ * Author: dcr
+ */
+
+#include "FilterServer.h"
+#include "PerformanceLap.h"
+#include "TextUtils.h"
+
+#include <errno.h>
+#include <poll.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+// time between checks of the stop flag while waiting for connections (ms)
+#define ACCEPT_POLL_MS      250
+
+static bool readFully(int fd, void* buffer, size_t size)
+{
+    char* p = (char*) buffer;
+
+    while (size > 0)
+    {
+        ssize_t n = read(fd, p, size);
+
+        if (n < 0 && errno == EINTR)
+            continue;
+
+        if (n <= 0)
+            return false;
+
+        p += n;
+        size -= n;
+    }
+
+    return true;
+}
+
+static bool writeFully(int fd, const void* buffer, size_t size)
+{
+    const char* p = (const char*) buffer;
+
+    while (size > 0)
+    {
+        // MSG_NOSIGNAL: a client that has gone away must not kill the server
+        ssize_t n = send(fd, p, size, MSG_NOSIGNAL);
+
+        if (n < 0 && errno == EINTR)
+            continue;
+
+        if (n <= 0)
+            return false;
+
+        p += n;
+        size -= n;
+    }
+
+    return true;
+}
+
+FilterClient::FilterClient(int fd)
+{
+    m_fd = fd;
+    m_id = 0;
+}
+
+/**
+ * The connection is closed when the last pending batch of the client has
+ * been answered
+ */
+FilterClient::~FilterClient()
+{
+    close(m_fd);
+}
+
+FilterServer::FilterServer(FPGAKmerFilter* filter, int kmerLength, int maxBatch)
+{
+    m_filter = filter;
+    m_kmerLength = kmerLength;
+    m_maxBatch = MAX(maxBatch, 1);
+    m_maxQueued = 4 * m_maxBatch;
+    m_verbose = false;
+
+    m_listenFd = -1;
+    m_stop = false;
+    m_nextClientId = 0;
+    m_activeClients = 0;
+    m_queuedCandidates = 0;
+
+    m_servedBatches = 0;
+    m_servedRequests = 0;
+    m_servedCandidates = 0;
+}
+
+FilterServer::~FilterServer()
+{
+}
+
+/**
+ * Serve the filter on a Unix domain socket until stop() is called.
+ * A stale socket file is replaced
+ * @param socketPath
+ */
+void FilterServer::run(string socketPath)
+{
+    struct sockaddr_un addr;
+
+    if (socketPath.size() >= sizeof(addr.sun_path))
+        throw Error(format("Socket path too long %s", socketPath.c_str()));
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, socketPath.c_str());
+
+    m_listenFd = socket(AF_UNIX, SOCK_STREAM, 0);
+
+    if (m_listenFd < 0)
+        throw Error(format("Failed to create socket (%s)", strerror(errno)));
+
+    unlink(socketPath.c_str());
+
+    if (bind(m_listenFd, (struct sockaddr*) &addr, sizeof(addr)) != 0 || listen(m_listenFd, SOMAXCONN) != 0)
+    {
+        close(m_listenFd);
+        throw Error(format("Failed to listen on %s (%s)", socketPath.c_str(), strerror(errno)));
+    }
+
+    printf("[SERVER] Listening on %s (k=%d, batches of up to %d candidates)\n", socketPath.c_str(), m_kmerLength, m_maxBatch);
+    fflush(stdout);
+
+    thread engine(&FilterServer::engineLoop, this);
+
+    acceptLoop();
+
+    close(m_listenFd);
+    unlink(socketPath.c_str());
+
+    {
+        // unblock the clients waiting for a request, their pending batches are still answered
+        unique_lock<mutex> lock(m_mutex);
+
+        for (size_t i=0; i < m_clients.size(); i++)
+            shutdown(m_clients[i]->m_fd, SHUT_RD);
+
+        m_clientsDone.wait(lock, [this] { return m_activeClients == 0; });
+    }
+
+    m_queueNotEmpty.notify_all();
+    engine.join();
+
+    printf("[SERVER] Served %ld requests (%ld candidates) in %ld batches\n", m_servedRequests, m_servedCandidates, m_servedBatches);
+}
+
+/**
+ * Request the server to finish. It can be called from a signal handler
+ */
+void FilterServer::stop()
+{
+    m_stop = true;
+}
+
+void FilterServer::acceptLoop()
+{
+    while (!m_stop)
+    {
+        struct pollfd pfd;
+        pfd.fd = m_listenFd;
+        pfd.events = POLLIN;
+
+        if (poll(&pfd, 1, ACCEPT_POLL_MS) <= 0)
+            continue;
+
+        int fd = accept(m_listenFd, NULL, NULL);
+
+        if (fd < 0)
+            continue;
+
+        shared_ptr<FilterClient> client(new FilterClient(fd));
+
+        {
+            lock_guard<mutex> lock(m_mutex);
+
+            client->m_id = m_nextClientId++;
+            m_clients.push_back(client);
+            m_activeClients++;
+        }
+
+        if (m_verbose)
+            printf("[SERVER] Client %d connected\n", client->m_id);
+
+        thread(&FilterServer::clientLoop, this, client).detach();
+    }
+}
+
+/**
+ * Read the requests of a client and queue them. The client is throttled
+ * while the queue is full
+ */
+void FilterServer::clientLoop(shared_ptr<FilterClient> client)
+{
+    while (true)
+    {
+        FilterBatch* batch = new FilterBatch();
+        batch->m_client = client;
+
+        if (!readBatch(client.get(), batch))
+        {
+            delete batch;
+            break;
+        }
+
+        int count = batch->m_maxError.size();
+
+        unique_lock<mutex> lock(m_mutex);
+
+        m_queueNotFull.wait(lock, [this] { return m_queuedCandidates < m_maxQueued; });
+
+        m_queue.push_back(batch);
+        m_queuedCandidates += count;
+        m_servedRequests++;
+
+        lock.unlock();
+        m_queueNotEmpty.notify_one();
+    }
+
+    if (m_verbose)
+        printf("[SERVER] Client %d disconnected\n", client->m_id);
+
+    lock_guard<mutex> lock(m_mutex);
+
+    for (size_t i=0; i < m_clients.size(); i++)
+        if (m_clients[i] == client)
+        {
+            m_clients.erase(m_clients.begin() + i);
+            break;
+        }
+
+    m_activeClients--;
+    m_clientsDone.notify_all();
+}
+
+/**
+ * Read a request
+ * @return false if the connection is closed or the request is invalid
+ */
+bool FilterServer::readBatch(FilterClient* client, FilterBatch* batch)
+{
+    unsigned int header[3];
+
+    if (!readFully(client->m_fd, header, sizeof(header)))
+        return false;
+
+    unsigned int count = header[1];
+    unsigned int payloadBytes = header[2];
+
+    if (header[0] != FILTER_SERVER_REQUEST_MAGIC || payloadBytes > FILTER_SERVER_MAX_PAYLOAD)
+    {
+        fprintf(stderr, "[SERVER] Client %d: invalid request header\n", client->m_id);
+        return false;
+    }
+
+    if (count == 0)
+        return false;
+
+    // every candidate takes its 3 fields at least (checked before allocating)
+    if (count > payloadBytes / (3 * sizeof(unsigned int)))
+    {
+        fprintf(stderr, "[SERVER] Client %d: request payload does not match %u candidates\n", client->m_id, count);
+        return false;
+    }
+
+    vector<char> payload(payloadBytes);
+
+    if (payloadBytes > 0 && !readFully(client->m_fd, &payload[0], payloadBytes))
+        return false;
+
+    batch->m_pattern.resize(count);
+    batch->m_text.resize(count);
+    batch->m_maxError.resize(count);
+
+    size_t pos = 0;
+
+    for (unsigned int i=0; i < count; i++)
+    {
+        unsigned int fields[3];
+
+        if (pos + sizeof(fields) > payloadBytes)
+            break;
+
+        memcpy(fields, &payload[pos], sizeof(fields));
+        pos += sizeof(fields);
+
+        if (pos + (size_t) fields[0] + fields[1] > payloadBytes)
+            break;
+
+        batch->m_pattern[i].assign(&payload[pos], fields[0]);
+        pos += fields[0];
+        batch->m_text[i].assign(&payload[pos], fields[1]);
+        pos += fields[1];
+        batch->m_maxError[i] = fields[2];
+
+        if (i == count-1 && pos == payloadBytes)
+            return true;
+    }
+
+    fprintf(stderr, "[SERVER] Client %d: request payload does not match %u candidates\n", client->m_id, count);
+
+    return false;
+}
+
+bool FilterServer::sendBounds(FilterBatch* batch)
+{
+    unsigned int header[2];
+
+    header[0] = FILTER_SERVER_RESPONSE_MAGIC;
+    header[1] = batch->m_bounds.size();
+
+    return writeFully(batch->m_client->m_fd, header, sizeof(header)) &&
+            writeFully(batch->m_client->m_fd, batch->m_bounds.data(), batch->m_bounds.size() * sizeof(unsigned int));
+}
+
+/**
+ * Take all the pending requests (up to the batch size), compute them with a
+ * single call to the filter and answer them. While the filter is busy new
+ * requests accumulate, so the batches grow with the load
+ */
+void FilterServer::engineLoop()
+{
+    while (true)
+    {
+        vector<FilterBatch*> batches;
+        int candidates = 0;
+
+        {
+            unique_lock<mutex> lock(m_mutex);
+
+            m_queueNotEmpty.wait(lock, [this] { return !m_queue.empty() || (m_stop && m_activeClients == 0); });
+
+            if (m_queue.empty())
+                break;
+
+            while (!m_queue.empty())
+            {
+                int count = m_queue.front()->m_maxError.size();
+
+                if (candidates > 0 && candidates + count > m_maxBatch)
+                    break;
+
+                batches.push_back(m_queue.front());
+                m_queue.pop_front();
+                candidates += count;
+            }
+
+            m_queuedCandidates -= candidates;
+        }
+
+        m_queueNotFull.notify_all();
+
+        bool computed = computeBatches(batches);
+
+        for (size_t b=0; b < batches.size(); b++)
+        {
+            // the clients of a failed batch get no response, their connection is closed
+            if (!computed)
+                shutdown(batches[b]->m_client->m_fd, SHUT_RDWR);
+            else if (!sendBounds(batches[b]) && m_verbose)
+                printf("[SERVER] Client %d: the response could not be sent\n", batches[b]->m_client->m_id);
+
+            delete batches[b];
+        }
+    }
+}
+
+/**
+ * Compute the bounds of the batches with a single call to the filter
+ * @return false if the filter failed (the error is reported)
+ */
+bool FilterServer::computeBatches(vector<FilterBatch*>& batches)
+{
+    PerformanceLap lap;
+    lap.start();
+
+    filter_input_t filter_input;
+    filter_input_clear(&filter_input);
+
+    for (size_t b=0; b < batches.size(); b++)
+    {
+        FilterBatch* batch = batches[b];
+
+        for (size_t i=0; i < batch->m_maxError.size(); i++)
+        {
+            filter_input.pattern = (char*) batch->m_pattern[i].c_str();
+            filter_input.pattern_length = batch->m_pattern[i].size();
+            filter_input.text = (char*) batch->m_text[i].c_str();
+            filter_input.text_length = batch->m_text[i].size();
+            filter_input.max_error = batch->m_maxError[i];
+
+            m_filter->addInput(&filter_input, m_kmerLength);
+        }
+    }
+
+    int total = m_filter->getInputCount();
+    vector<unsigned int> bounds(total);
+
+    try
+    {
+        m_filter->computeBounds(0, total, bounds.data());
+    }
+    catch (Error& err)
+    {
+        fprintf(stderr, "[SERVER] Batch of %d candidates failed: %s\n", total, err.what());
+        m_filter->destroy();
+        return false;
+    }
+
+    m_filter->destroy();
+
+    int first = 0;
+
+    for (size_t b=0; b < batches.size(); b++)
+    {
+        int count = batches[b]->m_maxError.size();
+
+        batches[b]->m_bounds.assign(bounds.begin() + first, bounds.begin() + first + count);
+        first += count;
+    }
+
+    lap.stop();
+
+    m_servedBatches++;
+    m_servedCandidates += total;
+
+    if (m_verbose)
+        printf("[SERVER] Batch of %d candidates from %d requests in %f s\n", total, (int) batches.size(), lap.lap());
+
+    return true;
+}
@@ -0,0 +1,134 @@
+/*
+ * Copyright (C) 2020 Universitat Autonoma de Barcelona - David Castells-Rufas <david.castells@uab.cat>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+/*
+ * File:   FilterServer.h
+ * Author: dcr
+ *
+ * Long-running filter process. Clients (the mappers of the host) connect to
+ * a Unix domain socket and send batches of candidates. The batches of all the
+ * clients are queued, and the engine thread coalesces the pending ones into a
+ * single computeBounds of the filter, so the device (or the host model) is
+ * initialized once and works with large batches. The bounds of every batch
+ * are sent back to its client as soon as they are computed.
+ *
+ * Protocol (all words are 32 bit unsigned in host byte order):
+ *
+ *  request:  FILTER_SERVER_REQUEST_MAGIC, count, payloadBytes
+ *            count x { patternLength, textLength, maxError, pattern, text }
+ *  response: FILTER_SERVER_RESPONSE_MAGIC, count
+ *            count x bound
+ *
+ * Sequences are plain ACGTN bases without terminators. The responses of a
+ * client come in the order of its requests. A request with count 0 closes
+ * the connection.
+ */
+
+#ifndef FILTERSERVER_H
+#define FILTERSERVER_H
+
+#include "FPGAKmerFilter.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+#define FILTER_SERVER_REQUEST_MAGIC     0x514d524b  // "KRMQ"
+#define FILTER_SERVER_RESPONSE_MAGIC    0x534d524b  // "KRMS"
+
+#define FILTER_SERVER_MAX_PAYLOAD       (1u << 30)
+
+class FilterClient
+{
+public:
+    FilterClient(int fd);
+    virtual ~FilterClient();
+
+public:
+    int m_fd;
+    int m_id;
+};
+
+/*
+ * A request of a client, and then its response
+ */
+class FilterBatch
+{
+public:
+    shared_ptr<FilterClient> m_client;
+    vector<string> m_pattern;
+    vector<string> m_text;
+    vector<int> m_maxError;
+    vector<unsigned int> m_bounds;
+};
+
+class FilterServer
+{
+public:
+    FilterServer(FPGAKmerFilter* filter, int kmerLength, int maxBatch);
+    virtual ~FilterServer();
+
+public:
+    void run(string socketPath);
+    void stop();
+
+private:
+    void acceptLoop();
+    void clientLoop(shared_ptr<FilterClient> client);
+    void engineLoop();
+    bool readBatch(FilterClient* client, FilterBatch* batch);
+    bool sendBounds(FilterBatch* batch);
+    bool computeBatches(vector<FilterBatch*>& batches);
+
+public:
+    bool m_verbose;
+
+private:
+    FPGAKmerFilter* m_filter;
+    int m_kmerLength;
+    int m_maxBatch;             // candidates of a coalesced batch
+    int m_maxQueued;            // candidates waiting in the queue before the clients are throttled
+
+    int m_listenFd;
+    atomic<bool> m_stop;        // set by stop() (from a signal handler)
+    int m_nextClientId;
+
+    mutex m_mutex;
+    condition_variable m_queueNotEmpty;
+    condition_variable m_queueNotFull;
+    deque<FilterBatch*> m_queue;
+    int m_queuedCandidates;
+
+    vector<shared_ptr<FilterClient> > m_clients;
+    int m_activeClients;
+    condition_variable m_clientsDone;
+
+    long m_servedBatches;
+    long m_servedRequests;
+    long m_servedCandidates;
+};
+
+#endif /* FILTERSERVER_H */
+
@@ -0,0 +1,221 @@
+/*
+ * Copyright (C) 2020 Universitat Autonoma de Barcelona - David Castells-Rufas <david.castells@uab.cat>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+/*
+ * File:   HybridKmerFilter.cpp
+ * Author: dcr
+ */
+
+#include "HybridKmerFilter.h"
+#include "PerformanceLap.h"
+#include "../filter/kmer_filter.h"
+
+#include <thread>
+
+#define HYBRID_CPU_BATCH_INIT       256
+#define HYBRID_CPU_BATCH_MIN        64
+#define HYBRID_DEVICE_BATCH_INIT    (16*1024)
+#define HYBRID_DEVICE_BATCH_MIN     1024
+#define HYBRID_DEVICE_BATCH_MAX     (1024*1024)
+
+HybridKmerFilter::HybridKmerFilter(FPGAKmerFilter* fpga, int cpuThreads, int kmerLength)
+{
+    m_fpga = fpga;
+    m_cpuThreads = cpuThreads;
+    m_kmerLength = kmerLength;
+    m_verbose = false;
+}
+
+HybridKmerFilter::~HybridKmerFilter()
+{
+}
+
+void HybridKmerFilter::addInput(filter_input_t* const filter_input)
+{
+    // the candidates are kept by the device filter, CPU workers read them from there
+    m_fpga->addInput(filter_input, m_kmerLength);
+}
+
+/**
+ * Get the next batch of candidates from the shared work queue.
+ * Once the throughput of both sides is known, each request takes half of its
+ * share of the remaining work (guided self-scheduling weighted by throughput),
+ * so that both sides tend to finish at the same time.
+ *
+ * @param device true if the request comes from the device worker
+ * @param first index of the first candidate of the batch
+ * @param count number of candidates of the batch
+ * @return false if there is no more work
+ */
+bool HybridKmerFilter::nextBatch(bool device, int* first, int* count)
+{
+    lock_guard<mutex> lock(m_queueMutex);
+
+    int remaining = m_total - m_next;
+
+    if (remaining <= 0)
+        return false;
+
+    double totalRate = m_deviceRate + m_cpuThreads * m_cpuRate;
+    int batch;
+
+    if (device)
+    {
+        if (m_deviceRate == 0 || totalRate == 0)
+            batch = HYBRID_DEVICE_BATCH_INIT;
+        else
+            batch = remaining * (m_deviceRate / totalRate) / 2;
+
+        batch = MAX(batch, HYBRID_DEVICE_BATCH_MIN);
+        batch = MIN(batch, HYBRID_DEVICE_BATCH_MAX);
+    }
+    else
+    {
+        if (m_cpuRate == 0 || totalRate == 0)
+            batch = HYBRID_CPU_BATCH_INIT;
+        else
+            batch = remaining * (m_cpuRate / totalRate) / 2;
+
+        batch = MAX(batch, HYBRID_CPU_BATCH_MIN);
+    }
+
+    batch = MIN(batch, remaining);
+
+    *first = m_next;
+    *count = batch;
+    m_next += batch;
+
+    if (device)
+    {
+        m_deviceCandidates += batch;
+        m_deviceBatches++;
+    }
+    else
+    {
+        m_cpuCandidates += batch;
+        m_cpuBatches++;
+    }
+
+    return true;
+}
+
+/**
+ * Update the measured throughput of one side (exponential moving average)
+ */
+void HybridKmerFilter::updateRate(bool device, int count, double seconds)
+{
+    if (seconds <= 0)
+        return;
+
+    lock_guard<mutex> lock(m_queueMutex);
+
+    double rate = count / seconds;
+    double* avg = (device)? &m_deviceRate : &m_cpuRate;
+
+    *avg = (*avg == 0)? rate : (*avg + rate) / 2;
+}
+
+/**
+ * The CPU workers run the host models of the loaded kernels, so every input
+ * gets the same bound (and result mode) whichever side computes it
+ */
+void HybridKmerFilter::cpuWorker()
+{
+    // models and counting tables of the thread (the latter for the inputs the kernels leave to the host)
+    KmerKernelModel* models[KMER_LENGTH_CLASSES];
+    m_fpga->newModels(models);
+    mm_allocator_t* const mm_allocator = mm_allocator_new(BUFFER_SIZE_8M);
+    kmer_counting_nway_t* const kmer_counting = kmer_counting_new(m_kmerLength, mm_allocator);
+    int first, count;
+
+    while (nextBatch(false, &first, &count))
+    {
+        PerformanceLap lap;
+        lap.start();
+
+        m_fpga->computeBoundsHost(first, count, &m_bounds[first], models, kmer_counting);
+
+        lap.stop();
+        updateRate(false, count, lap.lap());
+    }
+
+    kmer_counting_destroy(kmer_counting);
+    mm_allocator_delete(mm_allocator);
+
+    for (int c=0; c < KMER_LENGTH_CLASSES; c++)
+        delete models[c];
+}
+
+void HybridKmerFilter::deviceWorker()
+{
+    int first, count;
+
+    while (nextBatch(true, &first, &count))
+    {
+        PerformanceLap lap;
+        lap.start();
+
+        m_fpga->computeBounds(first, count, &m_bounds[first]);
+
+        lap.stop();
+        updateRate(true, count, lap.lap());
+    }
+}
+
+void HybridKmerFilter::computeAll(filter_input_t* const filter_input)
+{
+    m_total = m_fpga->getInputCount();
+    m_next = 0;
+    m_cpuRate = 0;
+    m_deviceRate = 0;
+    m_cpuCandidates = 0;
+    m_deviceCandidates = 0;
+    m_cpuBatches = 0;
+    m_deviceBatches = 0;
+    m_bounds.resize(m_total);
+
+    if (m_total == 0)
+        return;
+
+    timer_start(&filter_input->timer);
+
+    vector<thread> workers;
+
+    for (int i=0; i < m_cpuThreads; i++)
+        workers.push_back(thread(&HybridKmerFilter::cpuWorker, this));
+
+    // OpenCL calls are kept in the calling thread
+    deviceWorker();
+
+    for (size_t i=0; i < workers.size(); i++)
+        workers[i].join();
+
+    timer_stop(&filter_input->timer);
+
+    if (m_verbose)
+    {
+        printf("[HYBRID] CPU: %d candidates in %d batches (%f candidates/s per thread)\n", m_cpuCandidates, m_cpuBatches, m_cpuRate);
+        printf("[HYBRID] Device: %d candidates in %d batches (%f candidates/s)\n", m_deviceCandidates, m_deviceBatches, m_deviceRate);
+    }
+
+    // the bounds are already in input order
+    m_fpga->writeResults(m_bounds.data());
+
+    if (filter_input->check)
+        m_fpga->verifyAll(filter_input, m_bounds.data());
+}
@@ -0,0 +1,82 @@
+/*
+ * Copyright (C) 2020 Universitat Autonoma de Barcelona - David Castells-Rufas <david.castells@uab.cat>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+/*
+ * File:   HybridKmerFilter.h
+ * Author: dcr
+ *
+ * Hybrid CPU+FPGA kmer filter. CPU worker threads (running the host models of
+ * the loaded kernels, see KmerKernelModel) and the device queue pull batches of
+ * candidates from a shared work queue.
+ * Batch sizes adapt to the measured throughput of each side, and the bounds
+ * are merged back in input order.
+ */
+
+#ifndef HYBRIDKMERFILTER_H
+#define HYBRIDKMERFILTER_H
+
+#include "FPGAKmerFilter.h"
+
+#include <mutex>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+class HybridKmerFilter
+{
+public:
+    HybridKmerFilter(FPGAKmerFilter* fpga, int cpuThreads, int kmerLength);
+    virtual ~HybridKmerFilter();
+
+public:
+    void addInput(filter_input_t* const filter_input);
+    void computeAll(filter_input_t* const filter_input);
+
+private:
+    bool nextBatch(bool device, int* first, int* count);
+    void updateRate(bool device, int count, double seconds);
+    void cpuWorker();
+    void deviceWorker();
+
+public:
+    bool m_verbose;
+
+private:
+    FPGAKmerFilter* m_fpga;
+    int m_cpuThreads;
+    int m_kmerLength;
+
+    // shared work queue
+    mutex m_queueMutex;
+    int m_next;
+    int m_total;
+    double m_cpuRate;           // candidates/s of a single CPU thread
+    double m_deviceRate;        // candidates/s of the device
+
+    // statistics
+    int m_cpuCandidates;
+    int m_deviceCandidates;
+    int m_cpuBatches;
+    int m_deviceBatches;
+
+    vector<unsigned int> m_bounds;
+};
+
+#endif /* HYBRIDKMERFILTER_H */
+
@@ -0,0 +1,192 @@
+/*
+ * Copyright (C) 2020 Universitat Autonoma de Barcelona - David Castells-Rufas <david.castells@uab.cat>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+/*
+ * File:   KmerKernelModel.cpp
+ * Author: dcr
+ */
+
+#include "KmerKernelModel.h"
+#include "../kmer_counter.h"
+
+KmerKernelModel::KmerKernelModel(int kmerLength, int seqLen, bool counting)
+{
+    m_kmerLength = kmerLength;
+    m_seqLen = seqLen;
+    m_seqBits = ((seqLen * BASE_SIZE + (LOAD_BASES_ALIGNMENT_BITS-1)) / LOAD_BASES_ALIGNMENT_BITS) * LOAD_BASES_ALIGNMENT_BITS;
+    m_seqWords = m_seqBits / 32;
+    m_bins = 1 << (kmerLength * BASE_SIZE);
+    m_chunks = m_bins / 32;
+    m_counting = counting;
+    m_counterMax = KMER_COUNTER_MAX;
+
+    m_v.resize(m_seqWords);
+    m_hp.resize(m_chunks);
+    m_ht.resize(m_chunks);
+    m_cp.resize(m_bins);
+    m_ct.resize(m_bins);
+}
+
+KmerKernelModel::~KmerKernelModel()
+{
+}
+
+/**
+ * Read the sequence in big endian. v[SEQ_WORDS-1] holds the first bases
+ */
+void KmerKernelModel::readBigEndianSequence(const unsigned char* p, unsigned int* v)
+{
+    for (int w=0; w < m_seqWords; w++)
+    {
+        int b = (m_seqWords-1-w)*4;
+        v[w] = ((unsigned int) p[b] << 24) | (p[b+1] << 16) | (p[b+2] << 8) | p[b+3];
+    }
+}
+
+/**
+ * Extract the i-th kmer of the sequence (get_kmer_index)
+ */
+unsigned int KmerKernelModel::getKmerIndex(const unsigned int* v, int i)
+{
+    unsigned int ret;
+    int kmerBits = m_kmerLength * BASE_SIZE;
+    int b0 = m_seqBits - (i)*2 -1 ;
+    int b1 = m_seqBits - (m_kmerLength+i)*2;
+    int wb0 = b0 % 32;
+    int wb1 = b1 % 32;
+    int k0 = b0 / 32;
+    int k1 = b1 / 32;
+    unsigned int r0 = v[k0];
+    unsigned int r1 = v[k1];
+
+    if (k1 == k0)
+        ret = (r1 >> wb1);
+    else
+        ret = (r1 >> wb1) | (r0 << (kmerBits-1 - wb0));
+
+    return ret & ((1 << kmerBits) - 1);
+}
+
+void KmerKernelModel::computeHistogram(const unsigned char* seq, const unsigned int* seqIdx, unsigned int si, unsigned int* h)
+{
+    unsigned int offset = seqIdx[si*INDEX_SIZE + 0];
+    int len = seqIdx[si*INDEX_SIZE+1];
+
+    for (int c=0; c < m_chunks; c++)
+        h[c] = 0;
+
+    readBigEndianSequence(&seq[offset], &m_v[0]);
+
+    for (int i=0; i <= (len - m_kmerLength) && i < (m_seqLen-m_kmerLength+1); i++)
+    {
+        unsigned int kmer_index = getKmerIndex(&m_v[0], i);
+        h[kmer_index / 32] |= (1u << (kmer_index % 32));
+    }
+}
+
+void KmerKernelModel::computeCountingHistogram(const unsigned char* seq, const unsigned int* seqIdx, unsigned int si, unsigned char* h)
+{
+    unsigned int offset = seqIdx[si*INDEX_SIZE + 0];
+    int len = seqIdx[si*INDEX_SIZE+1];
+
+    for (int c=0; c < m_bins; c++)
+        h[c] = 0;
+
+    readBigEndianSequence(&seq[offset], &m_v[0]);
+
+    for (int i=0; i <= (len - m_kmerLength) && i < (m_seqLen-m_kmerLength+1); i++)
+    {
+        unsigned int kmer_index = getKmerIndex(&m_v[0], i);
+
+        if (h[kmer_index] < m_counterMax)
+            h[kmer_index]++;
+    }
+}
+
+unsigned int KmerKernelModel::manhattanDistance(const unsigned int* hp, const unsigned int* ht)
+{
+    int d = 0;
+
+    for (int c=0; c < m_chunks; c++)
+        d += __builtin_popcount(hp[c] & ~ht[c]);
+
+    return (d+m_kmerLength-1)/m_kmerLength;
+}
+
+unsigned int KmerKernelModel::minSumDistance(const unsigned char* hp, const unsigned char* ht)
+{
+    int d = 0;
+
+    for (int c=0; c < m_bins; c++)
+        d += (hp[c] > ht[c])? (hp[c] - ht[c]) : 0;
+
+    return (d+m_kmerLength-1)/m_kmerLength;
+}
+
+/**
+ * Compute the distance of a task (computeTask / computeCountingTask)
+ */
+unsigned int KmerKernelModel::computeTask(const unsigned char* pattern, const unsigned int* patternIdx, unsigned int pi,
+            const unsigned char* text, const unsigned int* textIdx, unsigned int ti)
+{
+    if (m_counting)
+    {
+        computeCountingHistogram(pattern, patternIdx, pi, &m_cp[0]);
+        computeCountingHistogram(text, textIdx, ti, &m_ct[0]);
+
+        return minSumDistance(&m_cp[0], &m_ct[0]);
+    }
+
+    computeHistogram(pattern, patternIdx, pi, &m_hp[0]);
+    computeHistogram(text, textIdx, ti, &m_ht[0]);
+
+    return manhattanDistance(&m_hp[0], &m_ht[0]);
+}
+
+/**
+ * Run the workload [workloadBegin, workloadEnd) as the kernel does, writing
+ * the packed result words. workloadBegin must be a multiple of RESULT_ALIGNMENT
+ */
+void KmerKernelModel::run(const unsigned char* pattern, const unsigned int* patternIdx,
+            const unsigned char* text, const unsigned int* textIdx,
+            const unsigned char* maxError, unsigned int* result,
+            unsigned int workloadBegin, unsigned int workloadEnd, unsigned int resultMode)
+{
+    unsigned int perWord = (resultMode == RESULT_ACCEPT)? 32 : 4;
+    unsigned int bitsPerTask = 32 / perWord;
+
+    for (unsigned int i=workloadBegin; i < workloadEnd; i += perWord)
+    {
+        unsigned int word = 0;
+
+        for (unsigned int li=0; (li < perWord) && (i+li < workloadEnd); li++)
+        {
+            unsigned int d = computeTask(pattern, patternIdx, i+li, text, textIdx, i+li);
+            unsigned int r;
+
+            if (resultMode == RESULT_ACCEPT)
+                r = (d <= maxError[i+li])? 1 : 0;
+            else
+                r = (d < 255)? d : 255;
+
+            word |= r << (li * bitsPerTask);
+        }
+
+        result[i / perWord] = word;
+    }
+}
@@ -0,0 +1,90 @@
+/*
+ * Copyright (C) 2020 Universitat Autonoma de Barcelona - David Castells-Rufas <david.castells@uab.cat>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+/*
+ * File:   KmerKernelModel.h
+ * Author: dcr
+ *
+ * Bit-exact host model of the kmer kernel (kmer.v16.cl, histogram_fixed.v16.cl
+ * and histogram_counting.v16.cl). It reads the same packed buffers and writes
+ * the same result words as a kernel of the family (kmer_k<K>_l<SEQ_LEN>), so
+ * it can be compared with the device, or used as a CPU filter when there is
+ * no device.
+ */
+
+#ifndef KMERKERNELMODEL_H
+#define KMERKERNELMODEL_H
+
+#include <vector>
+
+using namespace std;
+
+/*
+ * Layout of the kernel buffers (must match kmer.v16.cl)
+ */
+#define INDEX_SIZE          2
+#define BASE_SIZE           2
+#define LOAD_BASES_ALIGNMENT_BITS   512
+
+// result modes of the kernel
+#define RESULT_BOUNDS       0
+#define RESULT_ACCEPT       1
+#define RESULT_ALIGNMENT    32      // tasks, the kernel partitions are aligned to whole result words
+
+class KmerKernelModel
+{
+public:
+    KmerKernelModel(int kmerLength, int seqLen, bool counting);
+    virtual ~KmerKernelModel();
+
+public:
+    void run(const unsigned char* pattern, const unsigned int* patternIdx,
+            const unsigned char* text, const unsigned int* textIdx,
+            const unsigned char* maxError, unsigned int* result,
+            unsigned int workloadBegin, unsigned int workloadEnd, unsigned int resultMode);
+    unsigned int computeTask(const unsigned char* pattern, const unsigned int* patternIdx, unsigned int pi,
+            const unsigned char* text, const unsigned int* textIdx, unsigned int ti);
+
+private:
+    void readBigEndianSequence(const unsigned char* p, unsigned int* v);
+    unsigned int getKmerIndex(const unsigned int* v, int i);
+    void computeHistogram(const unsigned char* seq, const unsigned int* seqIdx, unsigned int si, unsigned int* h);
+    void computeCountingHistogram(const unsigned char* seq, const unsigned int* seqIdx, unsigned int si, unsigned char* h);
+    unsigned int manhattanDistance(const unsigned int* hp, const unsigned int* ht);
+    unsigned int minSumDistance(const unsigned char* hp, const unsigned char* ht);
+
+private:
+    int m_kmerLength;           // KMER_K
+    int m_seqLen;               // SEQ_LEN
+    int m_seqBits;              // SEQ_BITS
+    int m_seqWords;             // SEQ_WORDS
+    int m_bins;                 // KMER_BINS
+    int m_chunks;               // KMER_CHUNKS
+    bool m_counting;            // KMER_COUNTING
+    int m_counterMax;           // KMER_COUNTER_MAX
+
+    // working storage (the private arrays of the kernel)
+    vector<unsigned int> m_v;
+    vector<unsigned int> m_hp;
+    vector<unsigned int> m_ht;
+    vector<unsigned char> m_cp;
+    vector<unsigned char> m_ct;
+};
+
+#endif /* KMERKERNELMODEL_H */
+
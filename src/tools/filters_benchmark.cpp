@@ -24,11 +24,18 @@
 
 #include "../utils/commons.h"
 #include "../utils/input_text.h"
+#include "../utils/input_mmap.h"
+#include "../utils/result_writer.h"
 #include "../system/profiler_timer.h"
 #include "../benchmark/benchmark_utils.h"
 #include "../benchmark/benchmark_edit_alg.h"
 #include "../benchmark/benchmark_kmer_filter.h"
+#include "../benchmark/benchmark_pipeline.h"
 #include "FPGAKmerFilter.h"
+#include "HybridKmerFilter.h"
+#include "FilterServer.h"
+
+#include <signal.h>
 
 /*
  * Algorithms
@@ -36,8 +43,13 @@
 typedef enum {
   filter_edit_dp,
   filter_edit_bpm,
+  filter_edit_wfa,
+  filter_edit_bpm_tiled,
   filter_kmer_nway,
   filter_kmer_fpga,
+  filter_kmer_hybrid,
+  filter_kmer_fpga_diff,
+  filter_kmer_model,
 } filter_type;
 
 /*
@@ -47,10 +59,26 @@ typedef struct {
   // Input
   char *algorithm;
   char *input;
+  char *output;
+  result_format_t output_format;
   float max_error;
   // Specifics
   float bandwidth;
   int kmer_length;
+  bool alignment;
+  // System
+  int num_threads;
+  int decompression_threads;
+  int platform;
+  int compute_units;
+  bool cu_queues;
+  bool accept_bitmap;
+  bool device_counting;
+  bool cross_validate;
+  float reject_sampling;
+  char* xclbin_dir;
+  char* server_socket;
+  int server_batch;
   // Profile
   profiler_timer_t timer_global;
   int progress;
@@ -61,6 +89,8 @@ typedef struct {
 
 benchmark_args parameters;
 
+FPGADeviceSession device_session;
+
 
 
 int init_parameters()
@@ -68,10 +98,26 @@ int init_parameters()
   // Input
   parameters.algorithm=NULL;
   parameters.input=NULL;
+  parameters.output=NULL;
+  parameters.output_format=result_format_tsv;
   parameters.max_error=0.05;
   // Specifics
   parameters.bandwidth = -1.0;
   parameters.kmer_length = 5;
+  parameters.alignment = false;
+  // System
+  parameters.num_threads = 1;
+  parameters.decompression_threads = 2;
+  parameters.platform = 0;
+  parameters.compute_units = 0;
+  parameters.cu_queues = false;
+  parameters.accept_bitmap = false;
+  parameters.device_counting = false;
+  parameters.cross_validate = false;
+  parameters.reject_sampling = 1.0;
+  parameters.xclbin_dir = NULL;
+  parameters.server_socket = NULL;
+  parameters.server_batch = 65536;
   // Profile
   parameters.progress = 100000;
   // Misc
@@ -97,87 +143,174 @@ void filter_test() {
 //  // Free
 //  mm_allocator_delete(mm_allocator);
 }
+/*
+ * Device (or host model) setup of the kmer filters based on FPGAKmerFilter
+ */
+void filter_kmer_fpga_setup(const filter_type filter,FPGAKmerFilter* const fpga) {
+  const bool use_device = (filter == filter_kmer_fpga || filter == filter_kmer_hybrid || filter == filter_kmer_fpga_diff);
+  const bool use_fpga = (use_device || filter == filter_kmer_model);
+  if (use_fpga) {
+    fpga->m_resultBitmap = parameters.accept_bitmap;
+    fpga->m_crossValidate = parameters.cross_validate;
+    fpga->m_verifyThreads = parameters.num_threads;
+    fpga->m_rejectSampling = parameters.reject_sampling;
+  }
+  if (filter == filter_kmer_model) {
+    fpga->initModel(parameters.kmer_length, parameters.device_counting, true);
+  }
+  if (use_device) {
+    // the session is kept open (and the binary loaded) for the next benchmarks
+    device_session.m_verbose = parameters.verbose;
+    device_session.m_computeUnits = parameters.compute_units;
+    device_session.m_cuQueues = parameters.cu_queues;
+    try {
+      device_session.open(parameters.platform);
+      const char* const binary_type = (parameters.device_counting) ? "fpga.counting" : "fpga";
+      device_session.loadBinary(device_session.findBinary(
+          (parameters.xclbin_dir!=NULL) ? parameters.xclbin_dir : "",
+          binary_type,parameters.kmer_length),parameters.kmer_length,parameters.device_counting);
+    } catch (Error& err) {
+      fprintf(stderr,"%s\n",err.what());
+      exit(1);
+    }
+    fpga->setSession(&device_session);
+  }
+  if (filter == filter_kmer_fpga_diff) {
+    fpga->initModel(parameters.kmer_length, parameters.device_counting, false);
+  }
+}
+/*
+ * Filter of a single candidate (pipeline workers)
+ */
+void filter_candidate(filter_input_t* const filter_input,const int bandwidth,void* const filter_arg) {
+  switch (*(const filter_type*)filter_arg) {
+    case filter_edit_dp:
+      benchmark_edit_dp(filter_input,bandwidth);
+      break;
+    case filter_edit_bpm:
+      benchmark_edit_bpm(filter_input,bandwidth);
+      break;
+    case filter_edit_wfa:
+      benchmark_edit_wfa(filter_input);
+      break;
+    case filter_edit_bpm_tiled:
+      benchmark_edit_bpm_tiled(filter_input);
+      break;
+    case filter_kmer_nway:
+      benchmark_kmer_filter(filter_input,parameters.kmer_length);
+      break;
+    default:
+      fprintf(stderr,"Algorithm unknown or not implemented\n");
+      exit(1);
+      break;
+  }
+}
 /*
  * Benchmark
  */
 void filter_benchmark(const filter_type filter) 
 {
   // Parameters
-  FILE *input_file = NULL;
+  input_mmap_t *input_file = NULL;
+  candidate_packed_file_t *packed_file = NULL;
   char *line1 = NULL, *line2 = NULL;
   int line1_length=0, line2_length=0;
-  size_t line1_allocated=0, line2_allocated=0;
   filter_input_t filter_input;
+  result_writer_t *result_writer = NULL;
   // Init
   timer_restart(&(parameters.timer_global));
-  input_file = fopen(parameters.input, "r");
+  if (candidate_packed_check(parameters.input)) {
+    packed_file = candidate_packed_open(parameters.input);
+    if (packed_file==NULL) exit(1);
+  } else {
+    input_file = input_mmap_open(parameters.input,parameters.decompression_threads);
+  }
   
-  if (input_file==NULL)
+  if (input_file==NULL && packed_file==NULL)
   {
     fprintf(stderr,"Input file '%s' couldn't be opened\n",parameters.input);
     exit(1);
   }
+  if (parameters.alignment && (filter != filter_edit_bpm || parameters.output_format != result_format_tsv)) {
+    fprintf(stderr,"Alignment output is only served by edit-bpm (with tsv output)\n");
+    exit(1);
+  }
+  if (parameters.output != NULL) {
+    result_writer = result_writer_new(parameters.output,parameters.output_format,parameters.alignment);
+    if (result_writer==NULL) {
+      fprintf(stderr,"Output file '%s' couldn't be opened\n",parameters.output);
+      exit(1);
+    }
+  }
   filter_input_clear(&filter_input);
   filter_input.check = parameters.check;
   filter_input.verbose = parameters.verbose;
+  filter_input.alignment = parameters.alignment;
   filter_input.mm_allocator = mm_allocator_new(BUFFER_SIZE_8M);
   // Read-filter loop
   int seq_processed = 0, progress = 0;
   
   FPGAKmerFilter fpga;
-        fpga.initOpenCL(0);
-      fpga.initKernels(1, "fpga" );
+  HybridKmerFilter hybrid(&fpga,parameters.num_threads,parameters.kmer_length);
+  filter_kmer_fpga_setup(filter,&fpga);
+  fpga.m_resultWriter = result_writer;
 
   timer_reset(&filter_input.timer);
+  timer_reset(&filter_input.timer_check);
 
+  const bool per_candidate = (filter == filter_edit_dp || filter == filter_edit_bpm ||
+                               filter == filter_edit_wfa || filter == filter_edit_bpm_tiled ||
+                               filter == filter_kmer_nway);
+  if (per_candidate) {
+    // Parse, filter and aggregate in parallel stages
+    // (the kmer-filter and BPM read packed candidates as they are)
+    const bool decode_packed = ((filter != filter_kmer_nway && filter != filter_edit_bpm) || parameters.check);
+    seq_processed = benchmark_pipeline_run(input_file,packed_file,parameters.max_error,parameters.bandwidth,
+        filter_candidate,(void*)&filter,decode_packed,parameters.num_threads,parameters.progress,
+        result_writer,&filter_input);
+  }
   
-  while (true) 
+  while (!per_candidate) 
   {
-    // Read queries
-    line1_length = getline(&line1,&line1_allocated,input_file);
-    if (line1_length==-1) break;
-    line2_length = getline(&line2,&line2_allocated,input_file);
-    if (line1_length==-1) break;
-    // Configure input
     filter_input.sequence_id = seq_processed;
-    filter_input.pattern = line1+1;
-    filter_input.pattern_length = line1_length-2;
-    filter_input.pattern[filter_input.pattern_length] = '\0';
-    filter_input.text = line2+1;
-    filter_input.text_length = line2_length-2;
-    filter_input.text[filter_input.text_length] = '\0';
-    if (parameters.max_error >= 1.0) {
-      filter_input.max_error = parameters.max_error;
-    } else {
-      filter_input.max_error = ceil(parameters.max_error*filter_input.pattern_length);
-    }
-    int bandwidth;
-    if (parameters.bandwidth >= 1.0) {
-      bandwidth = parameters.bandwidth;
-    } else if (parameters.bandwidth >= 0.0) {
-      bandwidth = ceil(parameters.bandwidth*filter_input.pattern_length);
+    if (packed_file != NULL) {
+      // Packed candidate (the filters read it from the mapped file)
+      if ((uint64_t)seq_processed >= candidate_packed_get_num_records(packed_file)) break;
+      const candidate_packed_record_t* const record = candidate_packed_get_record(packed_file,seq_processed);
+      filter_input.packed_record = record;
+      filter_input.pattern = NULL;
+      filter_input.pattern_length = record->pattern_length;
+      filter_input.text = NULL;
+      filter_input.text_length = record->text_length;
+      filter_input.max_error = record->max_error;
     } else {
-      bandwidth = -1;
+      // Read queries (views of the mapped file, without the '>'/'<' prefix)
+      if (!input_mmap_get_line(input_file,&line1,&line1_length)) break;
+      if (!input_mmap_get_line(input_file,&line2,&line2_length)) break;
+      // Configure input
+      filter_input.pattern = line1+1;
+      filter_input.pattern_length = line1_length-1;
+      filter_input.text = line2+1;
+      filter_input.text_length = line2_length-1;
+      filter_input.max_error = filter_input_max_error(parameters.max_error,filter_input.pattern_length);
     }
-    // Filter
+    // Filter (batch filters, the candidates are computed after the loop)
     switch (filter) {
-      case filter_edit_dp:
-        benchmark_edit_dp(&filter_input,bandwidth);
-        break;
-      case filter_edit_bpm:
-        benchmark_edit_bpm(&filter_input,bandwidth);
-        break;
-      case filter_kmer_nway:
-        benchmark_kmer_filter(&filter_input,parameters.kmer_length);
-        break;
       case filter_kmer_fpga:
+      case filter_kmer_fpga_diff:
+      case filter_kmer_model:
         fpga.addInput(&filter_input,parameters.kmer_length);
         break;
+      case filter_kmer_hybrid:
+        hybrid.addInput(&filter_input);
+        break;
       default:
         fprintf(stderr,"Algorithm unknown or not implemented\n");
         exit(1);
         break;
     }
+    // The batch filters copy the text candidates (no view is kept)
+    if (input_file != NULL) input_mmap_release(input_file,input_mmap_offset(input_file));
     // Update progress
     ++seq_processed;
     // DEBUG mm_allocator_print(stderr,filter_input.mm_allocator,true);
@@ -191,17 +324,25 @@ void filter_benchmark(const filter_type filter)
     }
   }
   
-  if (filter == filter_kmer_fpga)
+  if (filter == filter_kmer_fpga || filter == filter_kmer_fpga_diff)
   {
       //fpga.initKernels(1, "emulator");
 	fpga.m_verbose = true;
-      fpga.computeAll();
+      fpga.computeAll(&filter_input);
       //fpga.destroy();
-      
-      fpga.finalizeKernels();
-      fpga.finalizeOpenCL();
+  }
+  if (filter == filter_kmer_model)
+  {
+      fpga.m_verbose = parameters.verbose;
+      fpga.computeAll(&filter_input);
+  }
+  if (filter == filter_kmer_hybrid)
+  {
+      hybrid.m_verbose = parameters.verbose;
+      hybrid.computeAll(&filter_input);
   }
   
+  if (result_writer != NULL) result_writer_close(result_writer);
   timer_stop(&(parameters.timer_global));
   // Print benchmark results
   fprintf(stderr,"[Benchmark]\n");
@@ -210,6 +351,10 @@ void filter_benchmark(const filter_type filter)
   timer_print(stderr,&parameters.timer_global,NULL);
   fprintf(stderr,"  => Time.Filter       ");
   timer_print(stderr,&filter_input.timer,&parameters.timer_global);
+  if (parameters.check) {
+    fprintf(stderr,"  => Time.Check        ");
+    timer_print(stderr,&filter_input.timer_check,&parameters.timer_global);
+  }
   if (parameters.check) {
     fprintf(stderr,"=> Check\n");
     fprintf(stderr,"  => TP.Hit       %d (%2.3f)\n",(filter_input.candidates_tp+filter_input.candidates_tn),
@@ -224,10 +369,67 @@ void filter_benchmark(const filter_type filter)
         100.0f*(float)filter_input.candidates_fn/(float)filter_input.candidates_total);
   }
   // Free
-  fclose(input_file);
+  if (input_file != NULL) input_mmap_close(input_file);
+  if (packed_file != NULL) candidate_packed_close(packed_file);
+  filter_input_free_workspace(&filter_input);
   mm_allocator_delete(filter_input.mm_allocator);
-  free(line1);
-  free(line2);
+}
+/*
+ * Convert (text input to packed candidates)
+ */
+void filter_convert() {
+  if (parameters.output == NULL) {
+    fprintf(stderr,"Conversion requires an output file (--output)\n");
+    exit(1);
+  }
+  input_mmap_t* const input_file = input_mmap_open(parameters.input,parameters.decompression_threads);
+  if (input_file==NULL) {
+    fprintf(stderr,"Input file '%s' couldn't be opened\n",parameters.input);
+    exit(1);
+  }
+  candidate_packed_writer_t* const writer = candidate_packed_writer_new(parameters.output);
+  if (writer==NULL) {
+    fprintf(stderr,"Output file '%s' couldn't be opened\n",parameters.output);
+    exit(1);
+  }
+  char *line1, *line2;
+  int line1_length, line2_length;
+  uint64_t seq_processed = 0;
+  while (input_mmap_get_line(input_file,&line1,&line1_length) &&
+         input_mmap_get_line(input_file,&line2,&line2_length)) {
+    const int pattern_length = line1_length-1;
+    candidate_packed_writer_add(writer,seq_processed,line1+1,pattern_length,line2+1,line2_length-1,
+        filter_input_max_error(parameters.max_error,pattern_length));
+    input_mmap_release(input_file,input_mmap_offset(input_file)); // Copied by the writer
+    ++seq_processed;
+  }
+  candidate_packed_writer_close(writer);
+  input_mmap_close(input_file);
+  fprintf(stderr,"=> Converted %" PRIu64 " candidates to '%s'\n",seq_processed,parameters.output);
+}
+/*
+ * Server
+ */
+FilterServer* filter_server_instance = NULL;
+void filter_server_signal(int) {
+  if (filter_server_instance != NULL) filter_server_instance->stop();
+}
+void filter_server(const filter_type filter) {
+  FPGAKmerFilter fpga;
+  filter_kmer_fpga_setup(filter,&fpga);
+  fpga.m_verbose = false;
+  FilterServer server(&fpga,parameters.kmer_length,parameters.server_batch);
+  server.m_verbose = parameters.verbose;
+  filter_server_instance = &server;
+  signal(SIGINT,filter_server_signal);
+  signal(SIGTERM,filter_server_signal);
+  try {
+    server.run(parameters.server_socket);
+  } catch (Error& err) {
+    fprintf(stderr,"%s\n",err.what());
+    exit(1);
+  }
+  filter_server_instance = NULL;
 }
 /*
  * Generic Menu
@@ -241,15 +443,40 @@ void usage() {
       "            [edit-filters]                                           \n"
       "              edit-dp                                                \n"
       "              edit-bpm                                               \n"
+      "              edit-wfa                                               \n"
+      "              edit-bpm-tiled                                         \n"
       "            [kmer-filters]                                           \n"
       "              kmer-filter                                            \n"
-      "          --input|-i <FILE>                                          \n"
+      "              kmer-fpga                                              \n"
+      "              kmer-hybrid                                            \n"
+      "              kmer-fpga-diff                                         \n"
+      "              kmer-model                                             \n"
+      "            [tools]                                                  \n"
+      "              convert            (text input to packed candidates)   \n"
+      "          --input|-i <FILE>                  (text[.gz|.zst] or packed)\n"
+      "          --output|-o <FILE>                 (results, or packed)    \n"
+      "          --output-format|-O tsv|binary      (default=tsv)           \n"
       "          --max-error|-e <INT>|<FLOAT>       (default=0.05)          \n"
       "        [Specifics]                                                  \n"
       "          --bandwidth|-b <INT>|<FLOAT>       (default=disabled)      \n"
       "          --kmer-length|-k [3..7]            (default=5)             \n"
+      "          --alignment|-L                     (edit-bpm; best hit to -o)\n"
+      "          --device-counting|-C               (default=disabled)      \n"
+      "          --cross-validate|-X                (default=disabled)      \n"
+      "        [System]                                                     \n"
+      "          --threads|-t <INT>                 (default=1)             \n"
+      "          --decompression-threads|-D <INT>   (default=2)             \n"
+      "          --platform|-p <INT>                (default=0)             \n"
+      "          --compute-units|-u <INT>           (default=all)           \n"
+      "          --cu-queues|-Q                     (default=disabled)      \n"
+      "          --accept-bitmap|-A                 (default=disabled)      \n"
+      "          --xclbin-dir|-x <DIR>              (default=<exe dir>/..)  \n"
+      "          --server|-s <SOCKET>               (default=disabled)      \n"
+      "          --server-batch|-B <INT>            (default=65536)         \n"
       "        [Misc]                                                       \n"
       "          --progress|-P <INT>                                        \n"
+      "          --check|-c                                                 \n"
+      "          --reject-sampling|-S <FLOAT>       (default=1.0)           \n"
       "          --help|-h                                                  \n");
 }
 void parse_arguments(int argc,char** argv) {
@@ -257,13 +484,29 @@ void parse_arguments(int argc,char** argv) {
     /* Input */
     { "algorithm", required_argument, 0, 'a' },
     { "input", required_argument, 0, 'i' },
+    { "output", required_argument, 0, 'o' },
+    { "output-format", required_argument, 0, 'O' },
     { "max-error", required_argument, 0, 'e' },
     /* Specifics */
     { "bandwidth", required_argument, 0, 'b' },
     { "kmer-length", required_argument, 0, 'k' },
+    { "alignment", no_argument, 0, 'L' },
+    { "device-counting", no_argument, 0, 'C' },
+    { "cross-validate", no_argument, 0, 'X' },
+    /* System */
+    { "threads", required_argument, 0, 't' },
+    { "decompression-threads", required_argument, 0, 'D' },
+    { "platform", required_argument, 0, 'p' },
+    { "compute-units", required_argument, 0, 'u' },
+    { "cu-queues", no_argument, 0, 'Q' },
+    { "accept-bitmap", no_argument, 0, 'A' },
+    { "xclbin-dir", required_argument, 0, 'x' },
+    { "server", required_argument, 0, 's' },
+    { "server-batch", required_argument, 0, 'B' },
     /* Misc */
     { "progress", required_argument, 0, 'P' },
     { "check", no_argument, 0, 'c' },
+    { "reject-sampling", required_argument, 0, 'S' },
     { "verbose", no_argument, 0, 'v' },
     { "help", no_argument, 0, 'h' },
     { 0, 0, 0, 0 } };
@@ -273,7 +516,7 @@ void parse_arguments(int argc,char** argv) {
     exit(0);
   }
   while (1) {
-    c=getopt_long(argc,argv,"a:i:e:b:k:P:cvh",long_options,&option_index);
+    c=getopt_long(argc,argv,"a:i:o:O:e:b:k:LCXt:D:p:u:QAx:s:B:P:cS:vh",long_options,&option_index);
     if (c==-1) break;
     switch (c) {
     /*
@@ -285,6 +528,19 @@ void parse_arguments(int argc,char** argv) {
     case 'i':
       parameters.input = optarg;
       break;
+    case 'o':
+      parameters.output = optarg;
+      break;
+    case 'O': // --output-format
+      if (strcmp(optarg,"tsv")==0) {
+        parameters.output_format = result_format_tsv;
+      } else if (strcmp(optarg,"binary")==0) {
+        parameters.output_format = result_format_binary;
+      } else {
+        fprintf(stderr,"Output format '%s' not recognized (tsv|binary)\n",optarg);
+        exit(1);
+      }
+      break;
     case 'e':
       parameters.max_error = atof(optarg);
       break;
@@ -297,6 +553,45 @@ void parse_arguments(int argc,char** argv) {
     case 'k': // --kmer-length
       parameters.kmer_length = atoi(optarg);
       break;
+    case 'L': // --alignment
+      parameters.alignment = true;
+      break;
+    case 'C': // --device-counting
+      parameters.device_counting = true;
+      break;
+    case 'X': // --cross-validate
+      parameters.cross_validate = true;
+      break;
+    /*
+     * System
+     */
+    case 't': // --threads
+      parameters.num_threads = atoi(optarg);
+      break;
+    case 'D': // --decompression-threads
+      parameters.decompression_threads = MAX(atoi(optarg),1);
+      break;
+    case 'p': // --platform
+      parameters.platform = atoi(optarg);
+      break;
+    case 'u': // --compute-units
+      parameters.compute_units = atoi(optarg);
+      break;
+    case 'Q': // --cu-queues
+      parameters.cu_queues = true;
+      break;
+    case 'A': // --accept-bitmap
+      parameters.accept_bitmap = true;
+      break;
+    case 'x': // --xclbin-dir
+      parameters.xclbin_dir = optarg;
+      break;
+    case 's': // --server
+      parameters.server_socket = optarg;
+      break;
+    case 'B': // --server-batch
+      parameters.server_batch = atoi(optarg);
+      break;
     /*
      * Misc
      */
@@ -306,6 +601,9 @@ void parse_arguments(int argc,char** argv) {
     case 'c':
       parameters.check = true;
       break;
+    case 'S': // --reject-sampling
+      parameters.reject_sampling = atof(optarg);
+      break;
     case 'v':
       parameters.verbose = true;
       break;
@@ -323,21 +621,43 @@ int main(int argc,char* argv[]) {
   // Parsing command-line options
   parse_arguments(argc,argv);
   // Select option
-  if (strcmp(parameters.algorithm,"test")==0) {
+  if (parameters.server_socket != NULL) {
+    if (strcmp(parameters.algorithm,"kmer-fpga")==0) {
+      filter_server(filter_kmer_fpga);
+    } else if (strcmp(parameters.algorithm,"kmer-model")==0) {
+      filter_server(filter_kmer_model);
+    } else {
+      fprintf(stderr,"Algorithm '%s' cannot be served (use kmer-fpga or kmer-model)\n",parameters.algorithm);
+      exit(1);
+    }
+  } else if (strcmp(parameters.algorithm,"test")==0) {
     filter_test();
+  } else if (strcmp(parameters.algorithm,"convert")==0) {
+    filter_convert();
   /* Edit */
   } else if (strcmp(parameters.algorithm,"edit-dp")==0) {
     filter_benchmark(filter_edit_dp);
   } else if (strcmp(parameters.algorithm,"edit-bpm")==0) {
     filter_benchmark(filter_edit_bpm);
+  } else if (strcmp(parameters.algorithm,"edit-wfa")==0) {
+    filter_benchmark(filter_edit_wfa);
+  } else if (strcmp(parameters.algorithm,"edit-bpm-tiled")==0) {
+    filter_benchmark(filter_edit_bpm_tiled);
   } else if (strcmp(parameters.algorithm,"kmer-filter")==0) {
     filter_benchmark(filter_kmer_nway);
   } else if (strcmp(parameters.algorithm,"kmer-fpga")==0) {
     filter_benchmark(filter_kmer_fpga);
+  } else if (strcmp(parameters.algorithm,"kmer-hybrid")==0) {
+    filter_benchmark(filter_kmer_hybrid);
+  } else if (strcmp(parameters.algorithm,"kmer-fpga-diff")==0) {
+    filter_benchmark(filter_kmer_fpga_diff);
+  } else if (strcmp(parameters.algorithm,"kmer-model")==0) {
+    filter_benchmark(filter_kmer_model);
   } else {
     fprintf(stderr,"Algorithm '%s' not recognized\n",parameters.algorithm);
     exit(1);
   }
+  device_session.close();
 }
 
 
@@ -0,0 +1,251 @@
+/*
+ *  Wavefront Alignments Algorithms
+ *  Copyright (c) 2020 by Santiago Marco-Sola  <santiagomsola@gmail.com>
+ *
+ *  This file is part of Wavefront Alignments Algorithms.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * PROJECT: Wavefront Alignments Algorithms
+ * AUTHOR(S): Santiago Marco-Sola <santiagomsola@gmail.com>
+ * DESCRIPTION: Binary packed candidates file
+ */
+
+#include "candidate_packed.h"
+#include "dna_text.h"
+
+/*
+ * Utils
+ */
+#define candidate_packed_align(offset) \
+  (DIV_CEIL(offset,CANDIDATE_PACKED_ALIGNMENT)*CANDIDATE_PACKED_ALIGNMENT)
+
+/*
+ * Reader
+ */
+bool candidate_packed_check(
+    char* const file_name) {
+  FILE* const file = fopen(file_name,"r");
+  if (file == NULL) return false;
+  char magic[8];
+  const bool packed = (fread(magic,1,sizeof(magic),file) == sizeof(magic) &&
+                       memcmp(magic,CANDIDATE_PACKED_MAGIC,sizeof(magic)) == 0);
+  fclose(file);
+  return packed;
+}
+candidate_packed_file_t* candidate_packed_open(
+    char* const file_name) {
+  // Map
+  input_mmap_t* const input_mmap = input_mmap_open(file_name,0);
+  if (input_mmap == NULL) return NULL;
+  // Check header
+  candidate_packed_header_t* const header = (candidate_packed_header_t*) input_mmap->memory;
+  if (input_mmap->file_size < sizeof(candidate_packed_header_t) ||
+      memcmp(header->magic,CANDIDATE_PACKED_MAGIC,sizeof(header->magic)) != 0 ||
+      header->version != CANDIDATE_PACKED_VERSION ||
+      header->index_offset + header->num_records*sizeof(uint64_t) > input_mmap->file_size) {
+    fprintf(stderr,"Packed candidates file '%s' is not valid\n",file_name);
+    input_mmap_close(input_mmap);
+    return NULL;
+  }
+  // Allocate
+  candidate_packed_file_t* const packed_file = (candidate_packed_file_t*) malloc(sizeof(candidate_packed_file_t));
+  packed_file->input_mmap = input_mmap;
+  packed_file->header = header;
+  packed_file->index = (uint64_t*)(input_mmap->memory + header->index_offset);
+  return packed_file;
+}
+void candidate_packed_close(
+    candidate_packed_file_t* const packed_file) {
+  input_mmap_close(packed_file->input_mmap);
+  free(packed_file);
+}
+uint64_t candidate_packed_get_num_records(
+    candidate_packed_file_t* const packed_file) {
+  return packed_file->header->num_records;
+}
+const candidate_packed_record_t* candidate_packed_get_record(
+    candidate_packed_file_t* const packed_file,
+    const uint64_t record_position) {
+  return (candidate_packed_record_t*)(packed_file->input_mmap->memory + packed_file->index[record_position]);
+}
+/*
+ * Record accessors
+ */
+const uint8_t* candidate_packed_record_pattern(
+    const candidate_packed_record_t* const record) {
+  return (const uint8_t*)record + record->pattern_offset;
+}
+const uint8_t* candidate_packed_record_text(
+    const candidate_packed_record_t* const record) {
+  return (const uint8_t*)record + record->text_offset;
+}
+const candidate_packed_run_t* candidate_packed_record_pattern_runs(
+    const candidate_packed_record_t* const record) {
+  return (const candidate_packed_run_t*)(record+1);
+}
+const candidate_packed_run_t* candidate_packed_record_text_runs(
+    const candidate_packed_record_t* const record) {
+  return candidate_packed_record_pattern_runs(record) + record->pattern_n_runs;
+}
+void candidate_packed_decode(
+    const uint8_t* const packed,
+    const uint32_t length,
+    const candidate_packed_run_t* const n_runs,
+    const uint32_t num_n_runs,
+    char* const sequence) {
+  uint32_t i, j;
+  for (i=0;i<length;++i) {
+    sequence[i] = dna_decode(candidate_packed_get_base(packed,i));
+  }
+  for (i=0;i<num_n_runs;++i) {
+    for (j=0;j<n_runs[i].length;++j) {
+      sequence[n_runs[i].begin+j] = DNA_CHAR_N;
+    }
+  }
+}
+void candidate_packed_record_decode_pattern(
+    const candidate_packed_record_t* const record,
+    char* const pattern) {
+  candidate_packed_decode(
+      candidate_packed_record_pattern(record),record->pattern_length,
+      candidate_packed_record_pattern_runs(record),record->pattern_n_runs,pattern);
+}
+void candidate_packed_record_decode_text(
+    const candidate_packed_record_t* const record,
+    char* const text) {
+  candidate_packed_decode(
+      candidate_packed_record_text(record),record->text_length,
+      candidate_packed_record_text_runs(record),record->text_n_runs,text);
+}
+/*
+ * Writer
+ */
+candidate_packed_writer_t* candidate_packed_writer_new(
+    char* const file_name) {
+  FILE* const file = fopen(file_name,"w");
+  if (file == NULL) return NULL;
+  // Allocate
+  candidate_packed_writer_t* const writer = (candidate_packed_writer_t*) malloc(sizeof(candidate_packed_writer_t));
+  writer->file = file;
+  writer->num_records = 0;
+  writer->index_allocated = BUFFER_SIZE_64K;
+  writer->index = (uint64_t*) malloc(writer->index_allocated*sizeof(uint64_t));
+  writer->buffer_allocated = BUFFER_SIZE_4K;
+  writer->buffer = (uint8_t*) malloc(writer->buffer_allocated);
+  // Reserve the header (written on close)
+  candidate_packed_header_t header;
+  memset(&header,0,sizeof(header));
+  fwrite(&header,sizeof(header),1,file);
+  writer->offset = sizeof(header);
+  return writer;
+}
+uint32_t candidate_packed_count_n_runs(
+    const char* const sequence,
+    const int length) {
+  uint32_t num_n_runs = 0;
+  int i;
+  for (i=0;i<length;++i) {
+    if (dna_encode(sequence[i]) == ENC_DNA_CHAR_N &&
+        (i == 0 || dna_encode(sequence[i-1]) != ENC_DNA_CHAR_N)) ++num_n_runs;
+  }
+  return num_n_runs;
+}
+candidate_packed_run_t* candidate_packed_encode(
+    const char* const sequence,
+    const int length,
+    uint8_t* const packed,
+    candidate_packed_run_t* n_runs) {
+  int i;
+  for (i=0;i<length;++i) {
+    const uint8_t enc_char = dna_encode(sequence[i]);
+    if (enc_char == ENC_DNA_CHAR_N) {
+      // Uncalled bases are packed as A
+      if (i == 0 || dna_encode(sequence[i-1]) != ENC_DNA_CHAR_N) {
+        n_runs->begin = i;
+        n_runs->length = 0;
+        ++n_runs;
+      }
+      ++(n_runs[-1].length);
+    } else {
+      packed[i>>2] |= enc_char << (6-2*(i&3));
+    }
+  }
+  return n_runs;
+}
+void candidate_packed_writer_add(
+    candidate_packed_writer_t* const writer,
+    const uint64_t read_id,
+    const char* const pattern,
+    const int pattern_length,
+    const char* const text,
+    const int text_length,
+    const int max_error) {
+  // Layout
+  const uint32_t pattern_n_runs = candidate_packed_count_n_runs(pattern,pattern_length);
+  const uint32_t text_n_runs = candidate_packed_count_n_runs(text,text_length);
+  const uint32_t pattern_offset = candidate_packed_align(
+      sizeof(candidate_packed_record_t)+(pattern_n_runs+text_n_runs)*sizeof(candidate_packed_run_t));
+  const uint32_t text_offset = candidate_packed_align(pattern_offset+candidate_packed_size(pattern_length));
+  const uint32_t record_size = candidate_packed_align(text_offset+candidate_packed_size(text_length));
+  // Prepare buffer
+  if (writer->buffer_allocated < record_size) {
+    writer->buffer_allocated = record_size;
+    writer->buffer = (uint8_t*) realloc(writer->buffer,writer->buffer_allocated);
+  }
+  memset(writer->buffer,0,record_size);
+  // Record
+  candidate_packed_record_t* const record = (candidate_packed_record_t*) writer->buffer;
+  record->read_id = read_id;
+  record->pattern_length = pattern_length;
+  record->text_length = text_length;
+  record->max_error = max_error;
+  record->pattern_n_runs = pattern_n_runs;
+  record->text_n_runs = text_n_runs;
+  record->record_size = record_size;
+  record->pattern_offset = pattern_offset;
+  record->text_offset = text_offset;
+  candidate_packed_run_t* const n_runs = (candidate_packed_run_t*)(record+1);
+  candidate_packed_run_t* const text_runs =
+      candidate_packed_encode(pattern,pattern_length,writer->buffer+pattern_offset,n_runs);
+  candidate_packed_encode(text,text_length,writer->buffer+text_offset,text_runs);
+  // Write
+  if (writer->num_records == writer->index_allocated) {
+    writer->index_allocated *= 2;
+    writer->index = (uint64_t*) realloc(writer->index,writer->index_allocated*sizeof(uint64_t));
+  }
+  writer->index[writer->num_records++] = writer->offset;
+  fwrite(writer->buffer,record_size,1,writer->file);
+  writer->offset += record_size;
+}
+void candidate_packed_writer_close(
+    candidate_packed_writer_t* const writer) {
+  // Index
+  fwrite(writer->index,sizeof(uint64_t),writer->num_records,writer->file);
+  // Header
+  candidate_packed_header_t header;
+  memset(&header,0,sizeof(header));
+  memcpy(header.magic,CANDIDATE_PACKED_MAGIC,sizeof(header.magic));
+  header.version = CANDIDATE_PACKED_VERSION;
+  header.alignment = CANDIDATE_PACKED_ALIGNMENT;
+  header.num_records = writer->num_records;
+  header.index_offset = writer->offset;
+  fseek(writer->file,0,SEEK_SET);
+  fwrite(&header,sizeof(header),1,writer->file);
+  // Free
+  fclose(writer->file);
+  free(writer->index);
+  free(writer->buffer);
+  free(writer);
+}
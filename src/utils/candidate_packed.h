@@ -0,0 +1,157 @@
+/*
+ *  Wavefront Alignments Algorithms
+ *  Copyright (c) 2020 by Santiago Marco-Sola  <santiagomsola@gmail.com>
+ *
+ *  This file is part of Wavefront Alignments Algorithms.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * PROJECT: Wavefront Alignments Algorithms
+ * AUTHOR(S): Santiago Marco-Sola <santiagomsola@gmail.com>
+ * DESCRIPTION: Binary packed candidates file
+ *
+ *   [Header (64B)][Record 0][Record 1]...[Index (8B per record)]
+ *
+ *   Record (64B aligned)
+ *     [Record header (64B)][N-runs (8B each)]<pad>[Pattern]<pad>[Text]<pad>
+ *
+ *   Sequences are 2-bit packed, 4 bases per byte with the first base in the
+ *   most significant bits (the layout of the device sequence slots) and zero
+ *   padded up to 64B. Uncalled bases are packed as A, and their positions kept
+ *   as runs (pattern runs first, then text runs). The index holds the offset
+ *   of every record (random access, sharding)
+ */
+
+#ifndef CANDIDATE_PACKED_H_
+#define CANDIDATE_PACKED_H_
+
+#include "commons.h"
+#include "input_mmap.h"
+
+/*
+ * Constants
+ */
+#define CANDIDATE_PACKED_MAGIC      "CANDPK01"
+#define CANDIDATE_PACKED_VERSION    1
+#define CANDIDATE_PACKED_ALIGNMENT  64
+
+/*
+ * Packed bases
+ */
+#define CANDIDATE_PACKED_BASES_PER_BYTE 4
+#define candidate_packed_size(length) \
+  (DIV_CEIL(length,CANDIDATE_PACKED_BASES_PER_BYTE))
+#define candidate_packed_get_base(packed,position) \
+  (((packed)[(position)>>2] >> (6-2*((position)&3))) & 3)
+
+/*
+ * File Layout
+ */
+typedef struct {
+  char magic[8];
+  uint32_t version;
+  uint32_t alignment;
+  uint64_t num_records;
+  uint64_t index_offset;            // Offset of the record index
+  uint8_t reserved[32];
+} candidate_packed_header_t;
+typedef struct {
+  uint32_t begin;
+  uint32_t length;
+} candidate_packed_run_t;
+typedef struct {
+  uint64_t read_id;                 // Position in the source file
+  uint32_t pattern_length;
+  uint32_t text_length;
+  uint32_t max_error;
+  uint32_t pattern_n_runs;
+  uint32_t text_n_runs;
+  uint32_t record_size;             // Including padding
+  uint32_t pattern_offset;          // From the beginning of the record
+  uint32_t text_offset;             // From the beginning of the record
+  uint8_t reserved[24];
+} candidate_packed_record_t;
+
+/*
+ * Packed File (Reader)
+ */
+typedef struct {
+  input_mmap_t* input_mmap;
+  candidate_packed_header_t* header;
+  uint64_t* index;
+} candidate_packed_file_t;
+
+/*
+ * Packed File (Writer)
+ */
+typedef struct {
+  FILE* file;
+  uint64_t offset;
+  uint64_t num_records;
+  uint64_t* index;
+  uint64_t index_allocated;
+  uint8_t* buffer;
+  uint64_t buffer_allocated;
+} candidate_packed_writer_t;
+
+/*
+ * Reader
+ */
+bool candidate_packed_check(
+    char* const file_name);
+candidate_packed_file_t* candidate_packed_open(
+    char* const file_name);
+void candidate_packed_close(
+    candidate_packed_file_t* const packed_file);
+uint64_t candidate_packed_get_num_records(
+    candidate_packed_file_t* const packed_file);
+const candidate_packed_record_t* candidate_packed_get_record(
+    candidate_packed_file_t* const packed_file,
+    const uint64_t record_position);
+
+/*
+ * Record accessors
+ */
+const uint8_t* candidate_packed_record_pattern(
+    const candidate_packed_record_t* const record);
+const uint8_t* candidate_packed_record_text(
+    const candidate_packed_record_t* const record);
+const candidate_packed_run_t* candidate_packed_record_pattern_runs(
+    const candidate_packed_record_t* const record);
+const candidate_packed_run_t* candidate_packed_record_text_runs(
+    const candidate_packed_record_t* const record);
+void candidate_packed_record_decode_pattern(
+    const candidate_packed_record_t* const record,
+    char* const pattern);
+void candidate_packed_record_decode_text(
+    const candidate_packed_record_t* const record,
+    char* const text);
+
+/*
+ * Writer
+ */
+candidate_packed_writer_t* candidate_packed_writer_new(
+    char* const file_name);
+void candidate_packed_writer_add(
+    candidate_packed_writer_t* const writer,
+    const uint64_t read_id,
+    const char* const pattern,
+    const int pattern_length,
+    const char* const text,
+    const int text_length,
+    const int max_error);
+void candidate_packed_writer_close(
+    candidate_packed_writer_t* const writer);
+
+#endif /* CANDIDATE_PACKED_H_ */
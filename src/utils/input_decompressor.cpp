@@ -0,0 +1,450 @@
+/*
+ *  Wavefront Alignments Algorithms
+ *  Copyright (c) 2020 by Santiago Marco-Sola  <santiagomsola@gmail.com>
+ *
+ *  This file is part of Wavefront Alignments Algorithms.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * PROJECT: Wavefront Alignments Algorithms
+ * AUTHOR(S): Santiago Marco-Sola <santiagomsola@gmail.com>
+ * DESCRIPTION: Streaming decompression of a mapped input (gzip, BGZF, zstd)
+ */
+
+#include "input_decompressor.h"
+
+#include <sys/mman.h>
+#include <unistd.h>
+#include <zlib.h>
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+/*
+ * Formats
+ */
+#define GZIP_HEADER_SIZE        12  // Up to XLEN
+#define GZIP_FLAG_EXTRA         0x04
+#define BGZF_FOOTER_SIZE         8  // CRC32 + ISIZE
+#define ZLIB_MAX_AVAIL_IN       BUFFER_SIZE_1G
+uint32_t input_decompressor_le32(const uint8_t* const data) {
+  return data[0] | (data[1]<<8) | (data[2]<<16) | ((uint32_t)data[3]<<24);
+}
+uint16_t input_decompressor_le16(const uint8_t* const data) {
+  return data[0] | (data[1]<<8);
+}
+bool input_decompressor_is_gzip(
+    const uint8_t* const data,
+    const uint64_t size) {
+  return size >= 2 && data[0] == 0x1f && data[1] == 0x8b;
+}
+bool input_decompressor_is_zstd(
+    const uint8_t* const data,
+    const uint64_t size) {
+  return size >= 4 && input_decompressor_le32(data) == 0xFD2FB528;
+}
+/*
+ * BGZF block size (0 if not a BGZF block)
+ */
+uint64_t input_decompressor_bgzf_block_size(
+    const uint8_t* const data,
+    const uint64_t size) {
+  if (size < GZIP_HEADER_SIZE || !input_decompressor_is_gzip(data,size)) return 0;
+  if (!(data[3] & GZIP_FLAG_EXTRA)) return 0;
+  const uint64_t xlen = input_decompressor_le16(data+10);
+  if (GZIP_HEADER_SIZE + xlen > size) return 0;
+  // Find the BC subfield
+  const uint8_t* subfield = data + GZIP_HEADER_SIZE;
+  const uint8_t* const extra_end = subfield + xlen;
+  while (subfield + 4 <= extra_end) {
+    const uint16_t slen = input_decompressor_le16(subfield+2);
+    if (subfield[0]=='B' && subfield[1]=='C' && slen==2 && subfield+6 <= extra_end) {
+      return (uint64_t)input_decompressor_le16(subfield+4) + 1;
+    }
+    subfield += 4 + slen;
+  }
+  return 0;
+}
+input_format_t input_decompressor_detect(
+    const uint8_t* const data,
+    const uint64_t size) {
+  if (input_decompressor_is_gzip(data,size)) {
+    return (input_decompressor_bgzf_block_size(data,size) > 0) ? input_format_bgzf : input_format_gzip;
+  }
+  if (input_decompressor_is_zstd(data,size)) return input_format_zstd;
+  return input_format_plain;
+}
+/*
+ * Next block (parallel formats). Returns false at the end of the input
+ */
+bool input_decompressor_scan_block(
+    input_decompressor_t* const decompressor,
+    input_block_t* const block) {
+  const uint8_t* const data = decompressor->input + decompressor->scan_input_offset;
+  const uint64_t remaining = decompressor->input_size - decompressor->scan_input_offset;
+  uint64_t input_size = 0, output_size = 0;
+  if (decompressor->format == input_format_bgzf) {
+    input_size = input_decompressor_bgzf_block_size(data,remaining);
+    if (input_size < GZIP_HEADER_SIZE+BGZF_FOOTER_SIZE || input_size > remaining) {
+      decompressor->error = "Invalid BGZF block";
+      return false;
+    }
+    output_size = input_decompressor_le32(data+input_size-4);
+  } else {
+#ifdef HAVE_ZSTD
+    const size_t frame_size = ZSTD_findFrameCompressedSize(data,remaining);
+    const unsigned long long content_size = ZSTD_getFrameContentSize(data,remaining);
+    if (ZSTD_isError(frame_size) || content_size == ZSTD_CONTENTSIZE_ERROR) {
+      decompressor->error = "Invalid zstd frame";
+      return false;
+    }
+    if (content_size == ZSTD_CONTENTSIZE_UNKNOWN || content_size > INPUT_DECOMPRESSOR_MAX_FRAME) {
+      decompressor->error = "zstd frame without (or with too large) content size";
+      return false;
+    }
+    input_size = frame_size;
+    output_size = content_size;
+#endif
+  }
+  if (decompressor->scan_output_offset + output_size > decompressor->reserved) {
+    decompressor->error = "Decompressed input exceeds the reserved address space";
+    return false;
+  }
+  // Setup
+  block->input_offset = decompressor->scan_input_offset;
+  block->input_size = input_size;
+  block->output_offset = decompressor->scan_output_offset;
+  block->output_size = output_size;
+  block->done = false;
+  decompressor->scan_input_offset += input_size;
+  decompressor->scan_output_offset += output_size;
+  return true;
+}
+/*
+ * Parallel decompression (BGZF blocks, sized zstd frames)
+ */
+bool input_decompressor_block_inflate(
+    input_decompressor_t* const decompressor,
+    input_block_t* const block,
+    void* const context) {
+  const uint8_t* const input = decompressor->input + block->input_offset;
+  char* const output = decompressor->memory + block->output_offset;
+  if (decompressor->format == input_format_bgzf) {
+    z_stream* const stream = (z_stream*) context;
+    inflateReset(stream);
+    stream->next_in = (Bytef*) input;
+    stream->avail_in = block->input_size;
+    stream->next_out = (Bytef*) output;
+    stream->avail_out = block->output_size;
+    return inflate(stream,Z_FINISH) == Z_STREAM_END && stream->total_out == block->output_size;
+  } else {
+#ifdef HAVE_ZSTD
+    const size_t size = ZSTD_decompressDCtx(
+        (ZSTD_DCtx*)context,output,block->output_size,input,block->input_size);
+    return !ZSTD_isError(size) && size == block->output_size;
+#else
+    return false;
+#endif
+  }
+}
+void input_decompressor_parallel(
+    input_decompressor_t* const decompressor) {
+  // Per-thread context
+  z_stream stream;
+  void* context = NULL;
+  if (decompressor->format == input_format_bgzf) {
+    memset(&stream,0,sizeof(stream));
+    inflateInit2(&stream,15+16);
+    context = &stream;
+  }
+#ifdef HAVE_ZSTD
+  if (decompressor->format == input_format_zstd) context = ZSTD_createDCtx();
+#endif
+  // Claim blocks in input order
+  pthread_mutex_lock(&decompressor->mutex);
+  while (!decompressor->stop && decompressor->error == NULL) {
+    if (decompressor->scan_input_offset >= decompressor->input_size) break;
+    // Bound the blocks in flight and the read-ahead
+    if (decompressor->blocks_end-decompressor->blocks_begin == INPUT_DECOMPRESSOR_MAX_BLOCKS ||
+        decompressor->scan_output_offset > decompressor->consumed+INPUT_DECOMPRESSOR_AHEAD) {
+      pthread_cond_wait(&decompressor->cond_consumed,&decompressor->mutex);
+      continue;
+    }
+    input_block_t* const block =
+        decompressor->blocks + (decompressor->blocks_end % INPUT_DECOMPRESSOR_MAX_BLOCKS);
+    if (!input_decompressor_scan_block(decompressor,block)) break;
+    ++(decompressor->blocks_end);
+    // Decompress in place
+    pthread_mutex_unlock(&decompressor->mutex);
+    const bool success = input_decompressor_block_inflate(decompressor,block,context);
+    pthread_mutex_lock(&decompressor->mutex);
+    if (!success) {
+      decompressor->error = "Corrupted compressed input";
+      break;
+    }
+    // Publish the completed prefix
+    block->done = true;
+    while (decompressor->blocks_begin < decompressor->blocks_end) {
+      input_block_t* const first =
+          decompressor->blocks + (decompressor->blocks_begin % INPUT_DECOMPRESSOR_MAX_BLOCKS);
+      if (!first->done) break;
+      decompressor->produced = first->output_offset + first->output_size;
+      ++(decompressor->blocks_begin);
+    }
+    pthread_cond_broadcast(&decompressor->cond_produced);
+    pthread_cond_broadcast(&decompressor->cond_consumed); // Free slots
+  }
+  // Finished (input scanned and all blocks published)
+  if (decompressor->error != NULL ||
+      (decompressor->scan_input_offset >= decompressor->input_size &&
+       decompressor->blocks_begin == decompressor->blocks_end)) {
+    decompressor->finished = true;
+  }
+  pthread_cond_broadcast(&decompressor->cond_produced);
+  pthread_cond_broadcast(&decompressor->cond_consumed);
+  pthread_mutex_unlock(&decompressor->mutex);
+  // Free
+  if (decompressor->format == input_format_bgzf) inflateEnd(&stream);
+#ifdef HAVE_ZSTD
+  if (decompressor->format == input_format_zstd) ZSTD_freeDCtx((ZSTD_DCtx*)context);
+#endif
+}
+/*
+ * Streaming decompression (gzip, zstd)
+ */
+uint64_t input_decompressor_streaming_wait(
+    input_decompressor_t* const decompressor) {
+  // Wait for room ahead of the reader (returns the writable bytes)
+  pthread_mutex_lock(&decompressor->mutex);
+  while (!decompressor->stop &&
+         decompressor->produced > decompressor->consumed+INPUT_DECOMPRESSOR_AHEAD) {
+    pthread_cond_wait(&decompressor->cond_consumed,&decompressor->mutex);
+  }
+  const bool stop = decompressor->stop;
+  pthread_mutex_unlock(&decompressor->mutex);
+  if (stop) return 0;
+  const uint64_t available = decompressor->reserved - decompressor->produced;
+  if (available == 0) decompressor->error = "Decompressed input exceeds the reserved address space";
+  return MIN(available,INPUT_DECOMPRESSOR_CHUNK);
+}
+void input_decompressor_streaming_publish(
+    input_decompressor_t* const decompressor,
+    const uint64_t output_size) {
+  pthread_mutex_lock(&decompressor->mutex);
+  decompressor->produced += output_size;
+  pthread_cond_broadcast(&decompressor->cond_produced);
+  pthread_mutex_unlock(&decompressor->mutex);
+}
+void input_decompressor_streaming_gzip(
+    input_decompressor_t* const decompressor) {
+  z_stream stream;
+  memset(&stream,0,sizeof(stream));
+  inflateInit2(&stream,15+16);
+  uint64_t input_offset = 0;
+  while (decompressor->error == NULL) {
+    const uint64_t output_available = input_decompressor_streaming_wait(decompressor);
+    if (output_available == 0) break;
+    // Inflate (zlib counters are 32-bit)
+    if (stream.avail_in == 0) {
+      stream.next_in = (Bytef*)(decompressor->input + input_offset);
+      stream.avail_in = MIN(decompressor->input_size-input_offset,ZLIB_MAX_AVAIL_IN);
+      input_offset += stream.avail_in;
+    }
+    stream.next_out = (Bytef*)(decompressor->memory + decompressor->produced);
+    stream.avail_out = output_available;
+    const int status = inflate(&stream,Z_NO_FLUSH);
+    input_decompressor_streaming_publish(decompressor,output_available-stream.avail_out);
+    if (status == Z_STREAM_END) {
+      const bool input_end = (stream.avail_in == 0 && input_offset >= decompressor->input_size);
+      if (input_end) break;
+      inflateReset(&stream); // Concatenated members
+    } else if (status != Z_OK) {
+      const bool input_end = (stream.avail_in == 0 && input_offset >= decompressor->input_size);
+      decompressor->error = (status==Z_BUF_ERROR && input_end) ?
+          "Truncated gzip input" : "Corrupted compressed input";
+    }
+  }
+  inflateEnd(&stream);
+}
+#ifdef HAVE_ZSTD
+void input_decompressor_streaming_zstd(
+    input_decompressor_t* const decompressor) {
+  ZSTD_DStream* const stream = ZSTD_createDStream();
+  ZSTD_initDStream(stream);
+  ZSTD_inBuffer input = { decompressor->input, decompressor->input_size, 0 };
+  size_t status = 0;
+  while (decompressor->error == NULL) {
+    const uint64_t output_available = input_decompressor_streaming_wait(decompressor);
+    if (output_available == 0) break;
+    ZSTD_outBuffer output = { decompressor->memory+decompressor->produced, output_available, 0 };
+    status = ZSTD_decompressStream(stream,&output,&input);
+    input_decompressor_streaming_publish(decompressor,output.pos);
+    if (ZSTD_isError(status)) {
+      decompressor->error = "Corrupted compressed input";
+    } else if (input.pos == input.size && output.pos < output.size) {
+      if (status != 0) decompressor->error = "Truncated zstd input";
+      break;
+    }
+  }
+  ZSTD_freeDStream(stream);
+}
+#endif
+/*
+ * Decompression thread
+ */
+void* input_decompressor_thread(void* const arg) {
+  input_decompressor_t* const decompressor = (input_decompressor_t*) arg;
+  if (decompressor->parallel) {
+    input_decompressor_parallel(decompressor);
+    return NULL;
+  }
+  if (decompressor->format == input_format_gzip) {
+    input_decompressor_streaming_gzip(decompressor);
+  }
+#ifdef HAVE_ZSTD
+  if (decompressor->format == input_format_zstd) {
+    input_decompressor_streaming_zstd(decompressor);
+  }
+#endif
+  pthread_mutex_lock(&decompressor->mutex);
+  decompressor->finished = true;
+  pthread_cond_broadcast(&decompressor->cond_produced);
+  pthread_mutex_unlock(&decompressor->mutex);
+  return NULL;
+}
+/*
+ * Setup
+ */
+input_decompressor_t* input_decompressor_new(
+    const uint8_t* const input,
+    const uint64_t input_size,
+    const input_format_t format,
+    const int num_threads) {
+#ifndef HAVE_ZSTD
+  if (format == input_format_zstd) {
+    fprintf(stderr,"zstd input not supported (compile with HAVE_ZSTD)\n");
+    return NULL;
+  }
+#endif
+  // Reserve the output address space (pages are committed on write)
+  uint64_t reserved = INPUT_DECOMPRESSOR_RESERVE;
+  void* memory = MAP_FAILED;
+  while (memory == MAP_FAILED && reserved >= BUFFER_SIZE_1G) {
+    memory = mmap(NULL,reserved,PROT_READ|PROT_WRITE,MAP_PRIVATE|MAP_ANONYMOUS|MAP_NORESERVE,-1,0);
+    if (memory == MAP_FAILED) reserved /= 2;
+  }
+  if (memory == MAP_FAILED) return NULL;
+  // Allocate
+  input_decompressor_t* const decompressor = (input_decompressor_t*) malloc(sizeof(input_decompressor_t));
+  decompressor->input = input;
+  decompressor->input_size = input_size;
+  decompressor->format = format;
+  decompressor->memory = (char*) memory;
+  decompressor->reserved = reserved;
+  decompressor->produced = 0;
+  decompressor->consumed = 0;
+  decompressor->released = 0;
+  decompressor->finished = false;
+  decompressor->error = NULL;
+  decompressor->blocks = NULL;
+  decompressor->blocks_begin = 0;
+  decompressor->blocks_end = 0;
+  decompressor->scan_input_offset = 0;
+  decompressor->scan_output_offset = 0;
+  decompressor->stop = false;
+  pthread_mutex_init(&decompressor->mutex,NULL);
+  pthread_cond_init(&decompressor->cond_produced,NULL);
+  pthread_cond_init(&decompressor->cond_consumed,NULL);
+  // Block-parallel (BGZF, or zstd whose first frame has a known content size)
+  decompressor->parallel = (format == input_format_bgzf);
+#ifdef HAVE_ZSTD
+  if (format == input_format_zstd) {
+    const unsigned long long content_size = ZSTD_getFrameContentSize(input,input_size);
+    decompressor->parallel =
+        content_size != ZSTD_CONTENTSIZE_UNKNOWN &&
+        content_size != ZSTD_CONTENTSIZE_ERROR &&
+        content_size <= INPUT_DECOMPRESSOR_MAX_FRAME;
+  }
+#endif
+  if (decompressor->parallel) {
+    decompressor->blocks = (input_block_t*) malloc(INPUT_DECOMPRESSOR_MAX_BLOCKS*sizeof(input_block_t));
+  }
+  // Launch threads
+  decompressor->num_threads = (decompressor->parallel) ? MAX(num_threads,1) : 1;
+  decompressor->threads = (pthread_t*) malloc(decompressor->num_threads*sizeof(pthread_t));
+  int i;
+  for (i=0;i<decompressor->num_threads;++i) {
+    pthread_create(decompressor->threads+i,NULL,input_decompressor_thread,decompressor);
+  }
+  return decompressor;
+}
+void input_decompressor_delete(
+    input_decompressor_t* const decompressor) {
+  // Join threads
+  pthread_mutex_lock(&decompressor->mutex);
+  decompressor->stop = true;
+  pthread_cond_broadcast(&decompressor->cond_consumed);
+  pthread_mutex_unlock(&decompressor->mutex);
+  int i;
+  for (i=0;i<decompressor->num_threads;++i) {
+    pthread_join(decompressor->threads[i],NULL);
+  }
+  // Free
+  munmap(decompressor->memory,decompressor->reserved);
+  pthread_mutex_destroy(&decompressor->mutex);
+  pthread_cond_destroy(&decompressor->cond_produced);
+  pthread_cond_destroy(&decompressor->cond_consumed);
+  free(decompressor->threads);
+  if (decompressor->blocks != NULL) free(decompressor->blocks);
+  free(decompressor);
+}
+/*
+ * Reader
+ */
+uint64_t input_decompressor_wait(
+    input_decompressor_t* const decompressor,
+    const uint64_t available) {
+  // Wait for more than @available decompressed bytes (or the end)
+  pthread_mutex_lock(&decompressor->mutex);
+  while (!decompressor->finished && decompressor->produced <= available) {
+    pthread_cond_wait(&decompressor->cond_produced,&decompressor->mutex);
+  }
+  const uint64_t produced = decompressor->produced;
+  const char* const error = decompressor->error;
+  pthread_mutex_unlock(&decompressor->mutex);
+  if (error != NULL) {
+    fprintf(stderr,"Input decompression failed (%s)\n",error);
+    exit(1);
+  }
+  return produced;
+}
+void input_decompressor_consume(
+    input_decompressor_t* const decompressor,
+    const uint64_t offset) {
+  pthread_mutex_lock(&decompressor->mutex);
+  decompressor->consumed = offset;
+  pthread_cond_broadcast(&decompressor->cond_consumed);
+  pthread_mutex_unlock(&decompressor->mutex);
+}
+void input_decompressor_release(
+    input_decompressor_t* const decompressor,
+    const uint64_t offset) {
+  // Release the pages below @offset (no view of them is in use), a chunk at least
+  if (offset < decompressor->released + INPUT_DECOMPRESSOR_CHUNK) return;
+  const uint64_t page_size = sysconf(_SC_PAGESIZE);
+  const uint64_t release_end = offset & ~(page_size-1);
+  madvise(decompressor->memory+decompressor->released,
+      release_end-decompressor->released,MADV_DONTNEED);
+  decompressor->released = release_end;
+}
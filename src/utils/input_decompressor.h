@@ -0,0 +1,129 @@
+/*
+ *  Wavefront Alignments Algorithms
+ *  Copyright (c) 2020 by Santiago Marco-Sola  <santiagomsola@gmail.com>
+ *
+ *  This file is part of Wavefront Alignments Algorithms.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * PROJECT: Wavefront Alignments Algorithms
+ * AUTHOR(S): Santiago Marco-Sola <santiagomsola@gmail.com>
+ * DESCRIPTION: Streaming decompression of a mapped input (gzip, BGZF, zstd)
+ *   into a contiguous region of reserved address space, so the decompressed
+ *   lines can be handed out as views. Pages are committed as they are written,
+ *   and released when the reader reports that no view below an offset is in
+ *   use anymore (memory is bounded by the read-ahead window and the views in use).
+ *   BGZF blocks and zstd frames with known content size are decompressed in
+ *   parallel (every thread inflates whole blocks in place); plain gzip and
+ *   other zstd streams are decompressed by a single thread. zstd requires
+ *   HAVE_ZSTD (and linking with libzstd)
+ */
+
+#ifndef INPUT_DECOMPRESSOR_H_
+#define INPUT_DECOMPRESSOR_H_
+
+#include "commons.h"
+
+#include <pthread.h>
+
+/*
+ * Configuration
+ */
+#define INPUT_DECOMPRESSOR_RESERVE       (1ull<<40)        // Address space (not memory)
+#define INPUT_DECOMPRESSOR_AHEAD         BUFFER_SIZE_256M  // Decompressed ahead of the reader
+#define INPUT_DECOMPRESSOR_CHUNK         BUFFER_SIZE_4M    // Output step of the streaming formats
+#define INPUT_DECOMPRESSOR_MAX_BLOCKS    8192              // Parallel blocks in flight
+#define INPUT_DECOMPRESSOR_MAX_FRAME     BUFFER_SIZE_64M   // Largest zstd frame decompressed in parallel
+
+/*
+ * Formats
+ */
+typedef enum {
+  input_format_plain,
+  input_format_gzip,
+  input_format_bgzf,
+  input_format_zstd,
+} input_format_t;
+
+/*
+ * Block (parallel formats)
+ */
+typedef struct {
+  uint64_t input_offset;
+  uint64_t input_size;
+  uint64_t output_offset;
+  uint64_t output_size;
+  bool done;
+} input_block_t;
+
+/*
+ * Decompressor
+ */
+typedef struct {
+  // Compressed input
+  const uint8_t* input;
+  uint64_t input_size;
+  input_format_t format;
+  bool parallel;
+  // Output
+  char* memory;                  // Reserved address space
+  uint64_t reserved;
+  uint64_t produced;             // Decompressed (contiguous)
+  uint64_t consumed;             // Reader position
+  uint64_t released;             // Pages given back below this offset
+  bool finished;
+  const char* error;
+  // Blocks
+  input_block_t* blocks;         // Pending blocks (circular)
+  uint64_t blocks_begin;
+  uint64_t blocks_end;
+  uint64_t scan_input_offset;    // Next block
+  uint64_t scan_output_offset;
+  // Threads
+  pthread_t* threads;
+  int num_threads;
+  pthread_mutex_t mutex;
+  pthread_cond_t cond_produced;
+  pthread_cond_t cond_consumed;
+  bool stop;
+} input_decompressor_t;
+
+/*
+ * Setup
+ */
+input_format_t input_decompressor_detect(
+    const uint8_t* const data,
+    const uint64_t size);
+input_decompressor_t* input_decompressor_new(
+    const uint8_t* const input,
+    const uint64_t input_size,
+    const input_format_t format,
+    const int num_threads);
+void input_decompressor_delete(
+    input_decompressor_t* const decompressor);
+
+/*
+ * Reader
+ */
+uint64_t input_decompressor_wait(
+    input_decompressor_t* const decompressor,
+    const uint64_t available);
+void input_decompressor_consume(
+    input_decompressor_t* const decompressor,
+    const uint64_t offset);
+void input_decompressor_release(
+    input_decompressor_t* const decompressor,
+    const uint64_t offset);
+
+#endif /* INPUT_DECOMPRESSOR_H_ */
@@ -0,0 +1,180 @@
+/*
+ *  Wavefront Alignments Algorithms
+ *  Copyright (c) 2020 by Santiago Marco-Sola  <santiagomsola@gmail.com>
+ *
+ *  This file is part of Wavefront Alignments Algorithms.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * PROJECT: Wavefront Alignments Algorithms
+ * AUTHOR(S): Santiago Marco-Sola <santiagomsola@gmail.com>
+ * DESCRIPTION: Memory-mapped input file. Lines are returned as (pointer,length)
+ *   views of the mapping (no copies, no terminators, read-only). Compressed
+ *   files (gzip, BGZF, zstd) are decompressed while parsing, and the views
+ *   point to the decompressed stream instead
+ */
+
+#include "input_mmap.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/*
+ * Setup
+ */
+input_mmap_t* input_mmap_open(
+    char* const file_name,
+    const int decompression_threads) {
+  // Open
+  const int fd = open(file_name,O_RDONLY);
+  if (fd < 0) return NULL;
+  struct stat file_stat;
+  if (fstat(fd,&file_stat) != 0) {
+    close(fd);
+    return NULL;
+  }
+  // Allocate
+  input_mmap_t* const input_mmap = (input_mmap_t*) malloc(sizeof(input_mmap_t));
+  input_mmap->file_name = file_name;
+  input_mmap->fd = fd;
+  input_mmap->file_size = file_stat.st_size;
+  input_mmap->file_memory = NULL;
+  input_mmap->memory = NULL;
+  input_mmap->memory_size = 0;
+  input_mmap->offset = 0;
+  input_mmap->readahead_offset = 0;
+  input_mmap->decompressor = NULL;
+  input_mmap->consumed_offset = 0;
+  // Map (empty files cannot be mapped)
+  if (input_mmap->file_size > 0) {
+    void* const memory = mmap(NULL,input_mmap->file_size,PROT_READ,MAP_PRIVATE,fd,0);
+    if (memory == MAP_FAILED) {
+      close(fd);
+      free(input_mmap);
+      return NULL;
+    }
+    input_mmap->file_memory = (char*) memory;
+    input_mmap->memory = input_mmap->file_memory;
+    input_mmap->memory_size = input_mmap->file_size;
+    madvise(input_mmap->file_memory,input_mmap->file_size,MADV_SEQUENTIAL);
+  }
+  // Compressed input
+  if (decompression_threads > 0) {
+    const input_format_t format = input_decompressor_detect(
+        (uint8_t*)input_mmap->file_memory,input_mmap->file_size);
+    if (format != input_format_plain) {
+      input_mmap->decompressor = input_decompressor_new(
+          (uint8_t*)input_mmap->file_memory,input_mmap->file_size,format,decompression_threads);
+      if (input_mmap->decompressor == NULL) {
+        input_mmap_close(input_mmap);
+        return NULL;
+      }
+      input_mmap->memory = input_mmap->decompressor->memory;
+      input_mmap->memory_size = 0;
+    }
+  }
+  return input_mmap;
+}
+void input_mmap_close(
+    input_mmap_t* const input_mmap) {
+  if (input_mmap->decompressor != NULL) {
+    input_decompressor_delete(input_mmap->decompressor);
+  }
+  if (input_mmap->file_memory != NULL) {
+    munmap(input_mmap->file_memory,input_mmap->file_size);
+  }
+  close(input_mmap->fd);
+  free(input_mmap);
+}
+/*
+ * Read-ahead
+ */
+void input_mmap_readahead(
+    input_mmap_t* const input_mmap) {
+  // Request the next window once half of the current one has been parsed
+  if (input_mmap->decompressor != NULL) return; // Compressed file (read by the decompressor)
+  if (input_mmap->offset + INPUT_MMAP_READAHEAD/2 < input_mmap->readahead_offset) return;
+  if (input_mmap->readahead_offset >= input_mmap->file_size) return;
+  const uint64_t page_size = sysconf(_SC_PAGESIZE);
+  const uint64_t begin = input_mmap->readahead_offset & ~(page_size-1);
+  const uint64_t end = MIN(input_mmap->readahead_offset+INPUT_MMAP_READAHEAD,input_mmap->file_size);
+  madvise(input_mmap->file_memory+begin,end-begin,MADV_WILLNEED);
+  input_mmap->readahead_offset = end;
+}
+/*
+ * Accessors
+ */
+bool input_mmap_get_line(
+    input_mmap_t* const input_mmap,
+    char** const line,
+    int* const line_length) {
+  input_decompressor_t* const decompressor = input_mmap->decompressor;
+  if (decompressor != NULL) {
+    // Report progress (lets the decompressor run ahead)
+    if (input_mmap->offset >= input_mmap->consumed_offset+INPUT_DECOMPRESSOR_CHUNK) {
+      input_decompressor_consume(decompressor,input_mmap->offset);
+      input_mmap->consumed_offset = input_mmap->offset;
+    }
+    if (input_mmap->offset >= input_mmap->memory_size) {
+      input_mmap->memory_size = input_decompressor_wait(decompressor,input_mmap->memory_size);
+    }
+  }
+  // Check EOF
+  if (input_mmap->offset >= input_mmap->memory_size) return false;
+  input_mmap_readahead(input_mmap);
+  // Find the end of the line
+  char* const begin = input_mmap->memory + input_mmap->offset;
+  uint64_t searched = 0;
+  char* newline = (char*) memchr(begin,'\n',input_mmap->memory_size-input_mmap->offset);
+  while (newline == NULL && decompressor != NULL) {
+    // Line not fully decompressed yet
+    searched = input_mmap->memory_size - input_mmap->offset;
+    const uint64_t memory_size = input_decompressor_wait(decompressor,input_mmap->memory_size);
+    if (memory_size == input_mmap->memory_size) break; // End of the input
+    input_mmap->memory_size = memory_size;
+    newline = (char*) memchr(begin+searched,'\n',memory_size-input_mmap->offset-searched);
+  }
+  const uint64_t remaining = input_mmap->memory_size - input_mmap->offset;
+  uint64_t length = (newline!=NULL) ? newline-begin : remaining;
+  input_mmap->offset += (newline!=NULL) ? length+1 : length;
+  // Strip DOS line endings
+  if (length > 0 && begin[length-1]=='\r') --length;
+  // Return
+  *line = begin;
+  *line_length = length;
+  return true;
+}
+bool input_mmap_eof(
+    input_mmap_t* const input_mmap) {
+  if (input_mmap->decompressor != NULL && input_mmap->offset >= input_mmap->memory_size) {
+    input_mmap->memory_size = input_decompressor_wait(input_mmap->decompressor,input_mmap->memory_size);
+  }
+  return input_mmap->offset >= input_mmap->memory_size;
+}
+uint64_t input_mmap_offset(
+    input_mmap_t* const input_mmap) {
+  return input_mmap->offset;
+}
+/*
+ * Release
+ */
+void input_mmap_release(
+    input_mmap_t* const input_mmap,
+    const uint64_t offset) {
+  // Only the decompressed memory is given back (the file pages are the page cache's)
+  if (input_mmap->decompressor == NULL) return;
+  input_decompressor_release(input_mmap->decompressor,MIN(offset,input_mmap->offset));
+}
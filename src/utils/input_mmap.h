@@ -0,0 +1,86 @@
+/*
+ *  Wavefront Alignments Algorithms
+ *  Copyright (c) 2020 by Santiago Marco-Sola  <santiagomsola@gmail.com>
+ *
+ *  This file is part of Wavefront Alignments Algorithms.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * PROJECT: Wavefront Alignments Algorithms
+ * AUTHOR(S): Santiago Marco-Sola <santiagomsola@gmail.com>
+ * DESCRIPTION: Memory-mapped input file. Lines are returned as (pointer,length)
+ *   views of the mapping (no copies, no terminators, read-only). Compressed
+ *   files (gzip, BGZF, zstd) are decompressed while parsing, and the views
+ *   point to the decompressed stream instead
+ */
+
+#ifndef INPUT_MMAP_H_
+#define INPUT_MMAP_H_
+
+#include "commons.h"
+#include "input_decompressor.h"
+
+/*
+ * Read-ahead window (requested to the kernel in advance of the parsing)
+ */
+#define INPUT_MMAP_READAHEAD BUFFER_SIZE_64M
+
+/*
+ * Memory-mapped File
+ */
+typedef struct {
+  // File
+  char* file_name;
+  int fd;
+  uint64_t file_size;
+  char* file_memory;            // Mapping of the file
+  // Lines
+  char* memory;                 // Mapping (or decompressed input)
+  uint64_t memory_size;         // Available bytes (grows while decompressing)
+  uint64_t offset;              // Next line
+  uint64_t readahead_offset;    // End of the requested read-ahead
+  // Decompression
+  input_decompressor_t* decompressor;
+  uint64_t consumed_offset;     // Last position reported to the decompressor
+} input_mmap_t;
+
+/*
+ * Setup (no decompression if @decompression_threads is 0)
+ */
+input_mmap_t* input_mmap_open(
+    char* const file_name,
+    const int decompression_threads);
+void input_mmap_close(
+    input_mmap_t* const input_mmap);
+
+/*
+ * Accessors
+ */
+bool input_mmap_get_line(
+    input_mmap_t* const input_mmap,
+    char** const line,
+    int* const line_length);
+bool input_mmap_eof(
+    input_mmap_t* const input_mmap);
+uint64_t input_mmap_offset(
+    input_mmap_t* const input_mmap);
+
+/*
+ * Release (the views below @offset are not in use anymore)
+ */
+void input_mmap_release(
+    input_mmap_t* const input_mmap,
+    const uint64_t offset);
+
+#endif /* INPUT_MMAP_H_ */
@@ -0,0 +1,211 @@
+/*
+ *  Wavefront Alignments Algorithms
+ *  Copyright (c) 2020 by Santiago Marco-Sola  <santiagomsola@gmail.com>
+ *
+ *  This file is part of Wavefront Alignments Algorithms.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * PROJECT: Fast Mapping-Candidates Filtering Algorithms
+ * AUTHOR(S): Santiago Marco-Sola <santiagomsola@gmail.com>
+ * DESCRIPTION: Per-candidate results output (TSV or binary)
+ */
+
+#include "result_writer.h"
+
+/*
+ * Max size of a formatted record
+ */
+#define RESULT_WRITER_RECORD_MAX 32
+
+/*
+ * Writer thread
+ */
+void* result_writer_thread(void* const arg) {
+  result_writer_t* const result_writer = (result_writer_t*) arg;
+  result_buffer_t* buffer;
+  while ((buffer=(result_buffer_t*)ring_buffer_pop(result_writer->full_buffers)) != NULL) {
+    if (fwrite(buffer->memory,1,buffer->used,result_writer->file) != buffer->used) {
+      result_writer->write_error = true;
+    }
+    buffer->used = 0;
+    ring_buffer_push(result_writer->free_buffers,buffer);
+  }
+  return NULL;
+}
+/*
+ * Setup
+ */
+result_writer_t* result_writer_new(
+    char* const file_name,
+    const result_format_t format,
+    const bool alignment) {
+  FILE* const file = fopen(file_name,"w");
+  if (file == NULL) return NULL;
+  // Allocate
+  result_writer_t* const result_writer = (result_writer_t*) malloc(sizeof(result_writer_t));
+  result_writer->file_name = file_name;
+  result_writer->file = file;
+  result_writer->format = format;
+  result_writer->alignment = alignment;
+  result_writer->write_error = false;
+  result_writer->num_records = 0;
+  // Buffers
+  result_writer->buffers = (result_buffer_t*) malloc(RESULT_WRITER_NUM_BUFFERS*sizeof(result_buffer_t));
+  result_writer->free_buffers = ring_buffer_new(RESULT_WRITER_NUM_BUFFERS);
+  result_writer->full_buffers = ring_buffer_new(RESULT_WRITER_NUM_BUFFERS+1); // +End marker
+  int i;
+  for (i=0;i<RESULT_WRITER_NUM_BUFFERS;++i) {
+    result_writer->buffers[i].memory = (char*) malloc(RESULT_WRITER_BUFFER_SIZE);
+    result_writer->buffers[i].used = 0;
+    if (i > 0) ring_buffer_push(result_writer->free_buffers,result_writer->buffers+i);
+  }
+  result_writer->current = result_writer->buffers;
+  // Header
+  if (format == result_format_binary) {
+    result_header_t header;
+    memset(&header,0,sizeof(header));
+    memcpy(header.magic,RESULT_WRITER_MAGIC,sizeof(header.magic));
+    header.version = RESULT_WRITER_VERSION;
+    header.record_size = sizeof(result_record_t);
+    memcpy(result_writer->current->memory,&header,sizeof(header));
+    result_writer->current->used = sizeof(header);
+  } else {
+    const char* const header = (alignment) ?
+        "#sequence_id\tbound\taccepted\ttext_begin\ttext_end\tcigar\n" :
+        "#sequence_id\tbound\taccepted\n";
+    strcpy(result_writer->current->memory,header);
+    result_writer->current->used = strlen(header);
+  }
+  // Launch
+  pthread_create(&result_writer->thread,NULL,result_writer_thread,result_writer);
+  return result_writer;
+}
+void result_writer_close(
+    result_writer_t* const result_writer) {
+  // Flush and join
+  if (result_writer->current->used > 0) {
+    ring_buffer_push(result_writer->full_buffers,result_writer->current);
+  }
+  ring_buffer_push(result_writer->full_buffers,NULL);
+  pthread_join(result_writer->thread,NULL);
+  if (fclose(result_writer->file) != 0) result_writer->write_error = true;
+  if (result_writer->write_error) {
+    fprintf(stderr,"Output file '%s' couldn't be written\n",result_writer->file_name);
+    exit(1);
+  }
+  // Free
+  int i;
+  for (i=0;i<RESULT_WRITER_NUM_BUFFERS;++i) {
+    free(result_writer->buffers[i].memory);
+  }
+  free(result_writer->buffers);
+  ring_buffer_delete(result_writer->free_buffers);
+  ring_buffer_delete(result_writer->full_buffers);
+  free(result_writer);
+}
+/*
+ * Add
+ */
+char* result_writer_print_uint(
+    char* const destination,
+    uint32_t value) {
+  char digits[10];
+  int num_digits = 0;
+  do {
+    digits[num_digits++] = '0' + (value % 10);
+    value /= 10;
+  } while (value > 0);
+  int i;
+  for (i=0;i<num_digits;++i) {
+    destination[i] = digits[num_digits-1-i];
+  }
+  return destination + num_digits;
+}
+result_buffer_t* result_writer_reserve(
+    result_writer_t* const result_writer,
+    const uint64_t record_size) {
+  // Hand the buffer over once full
+  result_buffer_t* buffer = result_writer->current;
+  if (buffer->used + record_size > RESULT_WRITER_BUFFER_SIZE) {
+    ring_buffer_push(result_writer->full_buffers,buffer);
+    buffer = (result_buffer_t*) ring_buffer_pop(result_writer->free_buffers);
+    result_writer->current = buffer;
+  }
+  return buffer;
+}
+void result_writer_add(
+    result_writer_t* const result_writer,
+    const uint32_t sequence_id,
+    const uint32_t bound,
+    const bool accepted) {
+  result_buffer_t* const buffer = result_writer_reserve(result_writer,RESULT_WRITER_RECORD_MAX);
+  // Format
+  char* const begin = buffer->memory + buffer->used;
+  if (result_writer->format == result_format_binary) {
+    result_record_t record;
+    record.sequence_id = sequence_id;
+    record.bound = bound;
+    record.accepted = accepted;
+    memcpy(begin,&record,sizeof(record));
+    buffer->used += sizeof(record);
+  } else {
+    char* end = result_writer_print_uint(begin,sequence_id);
+    *(end++) = '\t';
+    end = result_writer_print_uint(end,bound);
+    *(end++) = '\t';
+    *(end++) = (accepted) ? '1' : '0';
+    *(end++) = '\n';
+    buffer->used += end-begin;
+  }
+  ++(result_writer->num_records);
+}
+void result_writer_add_alignment(
+    result_writer_t* const result_writer,
+    const uint32_t sequence_id,
+    const uint32_t bound,
+    const bool accepted,
+    const uint32_t text_begin,
+    const uint32_t text_end,
+    const char* const cigar,
+    const int cigar_length) {
+  // Check size (a record never spans buffers)
+  const uint64_t record_size = 2*RESULT_WRITER_RECORD_MAX + cigar_length;
+  if (record_size > RESULT_WRITER_BUFFER_SIZE) {
+    fprintf(stderr,"Output record of sequence %u is too long (CIGAR of %d characters)\n",sequence_id,cigar_length);
+    exit(1);
+  }
+  result_buffer_t* const buffer = result_writer_reserve(result_writer,record_size);
+  // Format
+  char* const begin = buffer->memory + buffer->used;
+  char* end = result_writer_print_uint(begin,sequence_id);
+  *(end++) = '\t';
+  end = result_writer_print_uint(end,bound);
+  *(end++) = '\t';
+  *(end++) = (accepted) ? '1' : '0';
+  *(end++) = '\t';
+  end = result_writer_print_uint(end,text_begin);
+  *(end++) = '\t';
+  end = result_writer_print_uint(end,text_end);
+  *(end++) = '\t';
+  if (cigar_length > 0) {
+    memcpy(end,cigar,cigar_length);
+    end += cigar_length;
+  } else {
+    *(end++) = '*';
+  }
+  *(end++) = '\n';
+  buffer->used += end-begin;
+  ++(result_writer->num_records);
+}
@@ -0,0 +1,124 @@
+/*
+ *  Wavefront Alignments Algorithms
+ *  Copyright (c) 2020 by Santiago Marco-Sola  <santiagomsola@gmail.com>
+ *
+ *  This file is part of Wavefront Alignments Algorithms.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * PROJECT: Fast Mapping-Candidates Filtering Algorithms
+ * AUTHOR(S): Santiago Marco-Sola <santiagomsola@gmail.com>
+ * DESCRIPTION: Per-candidate results output (TSV or binary). Records are
+ *   formatted into buffers that a dedicated thread writes to the file, so the
+ *   filter never waits for I/O (unless all the buffers are waiting for it)
+ *
+ *   TSV     One line per candidate: sequence_id<TAB>bound<TAB>accepted
+ *           (preceded by a '#' header line). With alignments, followed by
+ *           <TAB>text_begin<TAB>text_end<TAB>CIGAR of the best hit ('*' if none)
+ *   Binary  [Header (16B)][Record 0][Record 1]... (little-endian records of
+ *           result_record_t)
+ */
+
+#ifndef RESULT_WRITER_H_
+#define RESULT_WRITER_H_
+
+#include "commons.h"
+#include "../system/ring_buffer.h"
+
+#include <pthread.h>
+
+/*
+ * Configuration
+ */
+#define RESULT_WRITER_BUFFER_SIZE  BUFFER_SIZE_1M
+#define RESULT_WRITER_NUM_BUFFERS  8
+#define RESULT_WRITER_MAGIC        "FRESLT01"
+#define RESULT_WRITER_VERSION      1
+
+/*
+ * Formats
+ */
+typedef enum {
+  result_format_tsv,
+  result_format_binary,
+} result_format_t;
+
+/*
+ * Binary Layout
+ */
+typedef struct {
+  char magic[8];
+  uint32_t version;
+  uint32_t record_size;
+} result_header_t;
+typedef struct {
+  uint32_t sequence_id;              // Position in the input
+  uint32_t bound;                    // Edit distance (or lower bound of it)
+  uint32_t accepted;
+} result_record_t;
+
+/*
+ * Writer
+ */
+typedef struct {
+  char* memory;
+  uint64_t used;
+} result_buffer_t;
+typedef struct {
+  // Output
+  char* file_name;
+  FILE* file;
+  result_format_t format;
+  bool alignment;                    // TSV records carry the alignment
+  bool write_error;
+  // Buffers
+  result_buffer_t* buffers;
+  result_buffer_t* current;          // Being filled
+  ring_buffer_t* free_buffers;       // Writer thread -> Filter
+  ring_buffer_t* full_buffers;       // Filter -> Writer thread
+  // Thread
+  pthread_t thread;
+  // Stats
+  uint64_t num_records;
+} result_writer_t;
+
+/*
+ * Setup
+ */
+result_writer_t* result_writer_new(
+    char* const file_name,
+    const result_format_t format,
+    const bool alignment);
+void result_writer_close(
+    result_writer_t* const result_writer);
+
+/*
+ * Add (in input order, from a single thread)
+ */
+void result_writer_add(
+    result_writer_t* const result_writer,
+    const uint32_t sequence_id,
+    const uint32_t bound,
+    const bool accepted);
+void result_writer_add_alignment(
+    result_writer_t* const result_writer,
+    const uint32_t sequence_id,
+    const uint32_t bound,
+    const bool accepted,
+    const uint32_t text_begin,
+    const uint32_t text_end,
+    const char* const cigar,
+    const int cigar_length);
+
+#endif /* RESULT_WRITER_H_ */